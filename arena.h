@@ -0,0 +1,98 @@
+/* SPDX-License-Identifier: MIT */
+/**
+ * @file   arena.h
+ * @author Marc-Alexandre Espiaut <ma.dev@espiaut.fr>
+ * @date   2026-03-10
+ * @brief  Fixed-capacity bump allocator, reset instead of freed.
+ *
+ * @copyright Copyright (c) 2026 Marc-Alexandre Espiaut
+ */
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "errorcodes.h"
+#include "types.h"
+
+enum
+{
+  e_arena_align = 16
+};
+
+typedef struct Arena Arena;
+struct Arena
+{
+  u8* data;
+  usize size;
+  usize capacity;
+};
+
+/* Empties the arena and makes sure it can hold n bytes. The block is only
+ * reallocated when it is too small, so a reused arena stops touching the
+ * heap once it has seen its largest input. Every pointer handed out
+ * before is invalidated. */
+static INLINE void
+arena_reserve(Arena* arena, usize n)
+{
+  arena->size = 0;
+
+  if (arena->capacity >= n && arena->data)
+  {
+    return;
+  }
+
+  free(arena->data);
+  arena->data = malloc(n ? n : 1);
+  if (!arena->data)
+  {
+    perror("malloc");
+    exit(e_error_malloc);
+  }
+  arena->capacity = n;
+}
+
+/* Returns n bytes aligned on e_arena_align. Running out of the reserved
+ * capacity is a programming error: size the arena with arena_reserve()
+ * first. */
+static INLINE void*
+arena_alloc(Arena* arena, usize n)
+{
+  usize offset = (arena->size + (e_arena_align - 1)) & ~(usize)(e_arena_align - 1);
+
+  if (offset > arena->capacity || n > arena->capacity - offset)
+  {
+    fprintf(stderr, "arena_alloc(): %lu bytes requested, %lu left!\n", (unsigned long)n, (unsigned long)(arena->capacity - arena->size));
+    exit(e_error_malloc);
+  }
+
+  arena->size = offset + n;
+
+  return arena->data + offset;
+}
+
+/* Rounds n up so that consecutive arena_alloc() calls fit in a reserve. */
+static INLINE usize
+arena_size_align(usize n)
+{
+  return (n + (e_arena_align - 1)) & ~(usize)(e_arena_align - 1);
+}
+
+static INLINE void
+arena_reset(Arena* arena)
+{
+  arena->size = 0;
+}
+
+static INLINE void
+arena_free(Arena* arena)
+{
+  free(arena->data);
+  arena->data = NULL;
+  arena->size = 0;
+  arena->capacity = 0;
+}
+
+#endif /* ARENA_H */
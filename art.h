@@ -0,0 +1,200 @@
+/* SPDX-License-Identifier: MIT */
+/**
+ * @file   art.h
+ * @author Marc-Alexandre Espiaut <ma.dev@espiaut.fr>
+ * @date   2026-03-24
+ * @brief  Random access to the tiles of a Build engine ART file.
+ *
+ * An ART file is a 16 bytes header giving the range of tile numbers it
+ * holds, three tables over that range (widths, heights and picanm
+ * words), then the pixels of every tile back to back: one palette index
+ * per pixel, column by column. The file is mapped and only the tables are
+ * read when it is opened; the pixels of a tile are first touched when it
+ * is decoded, so pulling a few tiles out of a large file costs a few
+ * pages, not a full read.
+ *
+ * @copyright Copyright (c) 2026 Marc-Alexandre Espiaut
+ */
+
+#ifndef ART_H
+#define ART_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "errorcodes.h"
+#include "memorystream.h"
+#include "types.h"
+
+enum
+{
+  e_art_header_len = 16,
+  e_art_version = 1,
+  e_art_palette_len = 768, /* 256 RGB triplets, 6 bits per component */
+  e_art_transparent = 255 /* the palette index drawn see-through */
+};
+
+/* One array per field rather than one struct per tile: a lookup by
+ * number, a size scan or an offset sum each read only what they need. */
+typedef struct ArtFile ArtFile;
+struct ArtFile
+{
+  MemoryStream ms;
+  i32 tile_start; /* number of the first tile */
+  i32 tile_end; /* and of the last */
+  u32 count;
+  u16* width;
+  u16* height;
+  u32* picanm; /* animation and centering, as stored */
+  i64* offset; /* of the pixels, from the start of the file */
+};
+
+/* 6 bits to 8, white staying white. */
+static INLINE u8
+art_palette_component(u8 c)
+{
+  c &= 0x3F;
+  return (u8)((c << 2) | (c >> 4));
+}
+
+/* Reads the first 768 bytes of PALETTE.DAT, widened to 8 bits. The
+ * transparent index is the only one with a zero alpha. */
+static INLINE void
+art_palette_load(rgba_u8_t* palette, char* path)
+{
+  MemoryStream ms = {0};
+  const u8* src = NULL;
+  usize i = 0;
+
+  memorystream_init(&ms, path);
+  src = memorystream_view(&ms, e_art_palette_len);
+  if (!src)
+  {
+    fprintf(stderr, "ERROR: %s: not a palette!\n", path);
+    exit(e_error_format);
+  }
+
+  for (; i < 256; ++i)
+  {
+    palette[i].r = art_palette_component(src[3 * i + 0]);
+    palette[i].g = art_palette_component(src[3 * i + 1]);
+    palette[i].b = art_palette_component(src[3 * i + 2]);
+    palette[i].a = i == e_art_transparent ? 0 : 255;
+  }
+
+  memorystream_free(&ms);
+}
+
+static INLINE void
+art_fail(ArtFile* art, const char* path, const char* reason)
+{
+  fprintf(stderr, "ERROR: %s: %s!\n", path, reason);
+  memorystream_free(&art->ms);
+  exit(e_error_format);
+}
+
+/* Maps the file and loads its tables; no pixel is read. */
+static INLINE void
+art_open(ArtFile* art, char* path)
+{
+  const u8* header = NULL;
+  const u8* width = NULL;
+  const u8* height = NULL;
+  const u8* picanm = NULL;
+  i64 offset = 0;
+  u32 i = 0;
+
+  memset(art, 0, sizeof(*art));
+  memorystream_init(&art->ms, path);
+
+  header = memorystream_view(&art->ms, e_art_header_len);
+  if (!header || i32_le_get(header) != e_art_version)
+  {
+    art_fail(art, path, "not an ART file");
+  }
+
+  art->tile_start = i32_le_get(header + 8);
+  art->tile_end = i32_le_get(header + 12);
+  if (art->tile_start < 0 || art->tile_start > 0x7FFFFFFF - 65536 || art->tile_end < art->tile_start - 1 || art->tile_end - art->tile_start >= 65536)
+  {
+    art_fail(art, path, "bad tile range");
+  }
+  art->count = (u32)(art->tile_end - art->tile_start + 1);
+
+  width = memorystream_view(&art->ms, (i64)art->count * 2);
+  height = memorystream_view(&art->ms, (i64)art->count * 2);
+  picanm = memorystream_view(&art->ms, (i64)art->count * 4);
+  if (!width || !height || !picanm)
+  {
+    art_fail(art, path, "truncated tile tables");
+  }
+
+  art->width = malloc(sizeof(*art->width) * (art->count ? art->count : 1));
+  art->height = malloc(sizeof(*art->height) * (art->count ? art->count : 1));
+  art->picanm = malloc(sizeof(*art->picanm) * (art->count ? art->count : 1));
+  art->offset = malloc(sizeof(*art->offset) * (art->count ? art->count : 1));
+  if (!art->width || !art->height || !art->picanm || !art->offset)
+  {
+    perror("malloc");
+    exit(e_error_malloc);
+  }
+
+  /* Pixels follow the tables in tile order, so the offsets are the prefix
+   * sums of the tile areas. */
+  offset = art->ms.position;
+  for (; i < art->count; ++i)
+  {
+    i16 w = i16_le_get(width + 2 * i);
+    i16 h = i16_le_get(height + 2 * i);
+
+    if (w < 0 || h < 0)
+    {
+      art_fail(art, path, "negative tile size");
+    }
+
+    art->width[i] = (u16)w;
+    art->height[i] = (u16)h;
+    art->picanm[i] = u32_le_get(picanm + 4 * i);
+    art->offset[i] = offset;
+    offset += (i64)w * h;
+
+    if (offset > art->ms.size)
+    {
+      art_fail(art, path, "truncated tile data");
+    }
+  }
+}
+
+/* Index of tile number tile, or -1 when the file doesn't hold it. */
+static INLINE i64
+art_find(const ArtFile* art, i32 tile)
+{
+  if (tile < art->tile_start || tile > art->tile_end)
+  {
+    return -1;
+  }
+
+  return tile - art->tile_start;
+}
+
+/* Zero-copy view of the width * height pixels of tile i, column-major,
+ * valid until art_close(). */
+static INLINE const u8*
+art_data(const ArtFile* art, u32 i)
+{
+  return art->ms.data + art->offset[i];
+}
+
+static INLINE void
+art_close(ArtFile* art)
+{
+  memorystream_free(&art->ms);
+  free(art->width);
+  free(art->height);
+  free(art->picanm);
+  free(art->offset);
+  memset(art, 0, sizeof(*art));
+}
+
+#endif /* ART_H */
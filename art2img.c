@@ -0,0 +1,284 @@
+/* SPDX-License-Identifier: MIT */
+/**
+ * @file   art2img.c
+ * @author Marc-Alexandre Espiaut <ma.dev@espiaut.fr>
+ * @date   2026-03-24
+ * @version 1.1
+ * @brief  Extracts the tiles of ART files as TGA images.
+ *
+ * @copyright Copyright (c) 2026 Marc-Alexandre Espiaut
+ */
+
+#if defined(__linux__)
+#define _XOPEN_SOURCE 700 /* pwrite(), posix_memalign() for fileio.h */
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "art.h"
+#include "artdecode.h"
+#include "errorcodes.h"
+#include "fileio.h"
+#include "filelist.h"
+#include "memorystream.h"
+#include "outputbuffer.h"
+#include "types.h"
+
+#define ART2IMG_VERSION "1.1"
+
+enum
+{
+  e_tga_header_len = 18,
+  e_tga_name_len = 32
+};
+
+/* An uncompressed TGA, top row first. Color-mapped, the tile keeps its
+ * palette indices; truecolor, lut holds the BGRA bytes of each index. */
+static void
+tga_make(OutputBuffer* ob, const rgba_u8_t* palette, const u32* lut, const u8* pixel, u16 width, u16 height)
+{
+  u8 header[e_tga_header_len] = {0};
+  usize depth = lut ? 4 : 1;
+
+  if (lut)
+  {
+    header[2] = 2; /* truecolor */
+    header[16] = 32;
+    header[17] = 0x28; /* top-left origin, 8 bits of alpha */
+  }
+  else
+  {
+    header[1] = 1; /* color map */
+    header[2] = 1; /* color-mapped */
+    u16_le_put(header + 5, 256);
+    header[7] = 24;
+    header[16] = 8;
+    header[17] = 0x20; /* top-left origin */
+  }
+  u16_le_put(header + 12, width);
+  u16_le_put(header + 14, height);
+
+  ob->size = 0;
+  outputbuffer_reserve(ob, e_tga_header_len + e_art_palette_len + (usize)width * height * depth);
+  outputbuffer_write(ob, header, sizeof(header));
+
+  if (lut)
+  {
+    artdecode_pixels(pixel, width, height, lut, (u8*)ob->data + ob->size);
+  }
+  else
+  {
+    u8* dst = (u8*)ob->data + ob->size;
+    usize i = 0;
+
+    for (; i < 256; ++i)
+    {
+      dst[3 * i + 0] = palette[i].b;
+      dst[3 * i + 1] = palette[i].g;
+      dst[3 * i + 2] = palette[i].r;
+    }
+    ob->size += e_art_palette_len;
+
+    artdecode_transpose(pixel, width, height, (u8*)ob->data + ob->size);
+  }
+  ob->size += (usize)width * height * depth;
+}
+
+/* The BGRA bytes of each palette index, in memory order. */
+static void
+palette_lut_make(const rgba_u8_t* palette, u32* lut)
+{
+  usize i = 0;
+
+  for (; i < 256; ++i)
+  {
+    u8 bgra[4];
+
+    bgra[0] = palette[i].b;
+    bgra[1] = palette[i].g;
+    bgra[2] = palette[i].r;
+    bgra[3] = palette[i].a;
+    memcpy(&lut[i], bgra, sizeof(bgra));
+  }
+}
+
+/* Extracts the non-empty tiles of art numbered first to last, as
+ * truecolor if lut isn't NULL. Returns how many there were. */
+static u32
+art_extract(ArtFile* art, const rgba_u8_t* palette, const u32* lut, i32 first, i32 last, int force, OutputBuffer* ob)
+{
+  i32 tile = first > art->tile_start ? first : art->tile_start;
+  i32 end = last < art->tile_end ? last : art->tile_end;
+  u32 extracted = 0;
+
+  for (; tile <= end; ++tile)
+  {
+    u32 i = (u32)art_find(art, tile);
+    char name[e_tga_name_len];
+
+    if (!art->width[i] || !art->height[i])
+    {
+      continue;
+    }
+
+    sprintf(name, "tile%04d.tga", (int)tile);
+    if (!force)
+    {
+      fileio_abort_if_exists(name);
+    }
+
+    fprintf(stdout, "Extracting tile %d (%ux%u) to %s.\n", (int)tile, art->width[i], art->height[i], name);
+    tga_make(ob, palette, lut, art_data(art, i), art->width[i], art->height[i]);
+    fileio_file_write(name, (const u8*)ob->data, ob->size, 0);
+    ++extracted;
+  }
+
+  return extracted;
+}
+
+/* "N" or "A-B". Returns 0 if s is neither. */
+static int
+tiles_parse(const char* s, i32* first, i32* last)
+{
+  char* end = NULL;
+  long a = strtol(s, &end, 10);
+  long b = a;
+
+  if (end == s || a < 0)
+  {
+    return 0;
+  }
+
+  if (*end == '-')
+  {
+    s = end + 1;
+    b = strtol(s, &end, 10);
+    if (end == s || b < a)
+    {
+      return 0;
+    }
+  }
+
+  if (*end != '\0' || b > 0x7FFFFFFFL)
+  {
+    return 0;
+  }
+
+  *first = (i32)a;
+  *last = (i32)b;
+  return 1;
+}
+
+static void
+usage(const char* prgname, const char* prgver)
+{
+  fprintf(stderr, "%s %s : Copyright (c) 2026 Marc-Alexandre Espiaut\n", prgname, prgver);
+  fprintf(stderr, "\n");
+  fprintf(stderr, "%s is a tool for extracting tiles from Build engine ART files.\n", prgname);
+  fprintf(stderr, "\n");
+  fprintf(stderr, "Usage: %s [options] [files]\n", prgname);
+  fprintf(stderr, "\n");
+  fprintf(stderr, "Each tile N is written as tileNNNN.tga in the current directory. Only the\n");
+  fprintf(stderr, "requested tiles are read.\n");
+  fprintf(stderr, "\n");
+  fprintf(stderr, "Options:\n");
+  fprintf(stderr, "  -h, --help             Show this help message and exit\n");
+  fprintf(stderr, "  -t, --tiles N|A-B      Extract tile N, or tiles A to B, instead of all\n");
+  fprintf(stderr, "  -p, --palette FILE     Take the colors from FILE (default: PALETTE.DAT)\n");
+  fprintf(stderr, "  -r, --rgba             Write 32 bits RGBA, index 255 transparent\n");
+  fprintf(stderr, "  -f, --force            Overwrite existing TGA files\n");
+  fprintf(stderr, "\n");
+  fprintf(stderr, "Examples:\n");
+  fprintf(stderr, "  %s TILES000.ART\n", prgname);
+  fprintf(stderr, "  %s -t 1405-1420 TILES005.ART\n", prgname);
+  fprintf(stderr, "  %s -r -t 1405-1420 TILES005.ART\n", prgname);
+  fprintf(stderr, "  %s -p ../PALETTE.DAT -t 2000 TILES*.ART\n", prgname);
+  exit(EXIT_FAILURE);
+}
+
+int
+main(int argc, char* argv[])
+{
+  FileList files = {0};
+  OutputBuffer ob = {0};
+  rgba_u8_t palette[256];
+  u32 lut[256];
+  char* palette_path = "PALETTE.DAT";
+  i32 first = 0;
+  i32 last = 0x7FFFFFFF;
+  int force = 0;
+  int rgba = 0;
+  u32 extracted = 0;
+  usize j = 0;
+  int i;
+
+  if (argc < 2)
+  {
+    usage(argv[0], ART2IMG_VERSION);
+  }
+
+  for (i = 1; i < argc; ++i)
+  {
+    if (!strcmp(argv[i], "-h") || !strcmp(argv[i], "--help"))
+    {
+      usage(argv[0], ART2IMG_VERSION);
+    }
+    else if (!strcmp(argv[i], "-t") || !strcmp(argv[i], "--tiles"))
+    {
+      if (++i == argc || !tiles_parse(argv[i], &first, &last))
+      {
+        usage(argv[0], ART2IMG_VERSION);
+      }
+    }
+    else if (!strcmp(argv[i], "-p") || !strcmp(argv[i], "--palette"))
+    {
+      if (++i == argc)
+      {
+        usage(argv[0], ART2IMG_VERSION);
+      }
+      palette_path = argv[i];
+    }
+    else if (!strcmp(argv[i], "-r") || !strcmp(argv[i], "--rgba"))
+    {
+      rgba = 1;
+    }
+    else if (!strcmp(argv[i], "-f") || !strcmp(argv[i], "--force"))
+    {
+      force = 1;
+    }
+    else
+    {
+      filelist_add(&files, argv[i]);
+    }
+  }
+
+  if (!files.count)
+  {
+    usage(argv[0], ART2IMG_VERSION);
+  }
+
+  art_palette_load(palette, palette_path);
+  palette_lut_make(palette, lut);
+
+  for (; j < files.count; ++j)
+  {
+    ArtFile art;
+
+    /* A range that misses the file costs its tables only. */
+    art_open(&art, files.path[j]);
+    extracted += art_extract(&art, palette, rgba ? lut : NULL, first, last, force, &ob);
+    art_close(&art);
+  }
+
+  if (!extracted)
+  {
+    fprintf(stderr, "WARN: No tile was extracted.\n");
+  }
+
+  outputbuffer_free(&ob);
+  filelist_free(&files);
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,190 @@
+/* SPDX-License-Identifier: MIT */
+/**
+ * @file   artdecode.h
+ * @author Marc-Alexandre Espiaut <ma.dev@espiaut.fr>
+ * @date   2026-03-25
+ * @brief  Column-major ART tiles to row-major images.
+ *
+ * A tile is stored column by column, an image row by row, so every output
+ * byte comes from a different input column. Done pixel by pixel, a tall
+ * tile reads each input cache line once per row. The tile is instead cut
+ * into blocks small enough for their input columns and output rows to
+ * stay in L1 together, and each block is transposed 8x8 bytes at a time
+ * in SSE2 registers.
+ *
+ * For truecolor output the palette lookup runs on the transposed block,
+ * while it is still in L1, one row at a time: 8 indices per AVX2 gather
+ * when the compiler targets AVX2, one table load per pixel otherwise.
+ *
+ * @copyright Copyright (c) 2026 Marc-Alexandre Espiaut
+ */
+
+#ifndef ARTDECODE_H
+#define ARTDECODE_H
+
+#include <string.h>
+
+#include "types.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define ARTDECODE_AVX2
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define ARTDECODE_SSE2
+#endif
+
+enum
+{
+  e_artdecode_block = 64 /* 64 columns in, 64 rows out: 8 KiB */
+};
+
+#if defined(ARTDECODE_SSE2)
+/* Eight 8 bytes columns, src_stride apart, to eight 8 bytes rows. */
+static INLINE void
+artdecode_8x8(const u8* src, usize src_stride, u8* dst, usize dst_stride)
+{
+  __m128i c0 = _mm_loadl_epi64((const __m128i*)(src + 0 * src_stride));
+  __m128i c1 = _mm_loadl_epi64((const __m128i*)(src + 1 * src_stride));
+  __m128i c2 = _mm_loadl_epi64((const __m128i*)(src + 2 * src_stride));
+  __m128i c3 = _mm_loadl_epi64((const __m128i*)(src + 3 * src_stride));
+  __m128i c4 = _mm_loadl_epi64((const __m128i*)(src + 4 * src_stride));
+  __m128i c5 = _mm_loadl_epi64((const __m128i*)(src + 5 * src_stride));
+  __m128i c6 = _mm_loadl_epi64((const __m128i*)(src + 6 * src_stride));
+  __m128i c7 = _mm_loadl_epi64((const __m128i*)(src + 7 * src_stride));
+
+  /* Interleaving bytes, then pairs, then quads of columns leaves row y in
+   * the y-th 8 bytes. */
+  __m128i a0 = _mm_unpacklo_epi8(c0, c1);
+  __m128i a1 = _mm_unpacklo_epi8(c2, c3);
+  __m128i a2 = _mm_unpacklo_epi8(c4, c5);
+  __m128i a3 = _mm_unpacklo_epi8(c6, c7);
+  __m128i b0 = _mm_unpacklo_epi16(a0, a1);
+  __m128i b1 = _mm_unpackhi_epi16(a0, a1);
+  __m128i b2 = _mm_unpacklo_epi16(a2, a3);
+  __m128i b3 = _mm_unpackhi_epi16(a2, a3);
+  __m128i r01 = _mm_unpacklo_epi32(b0, b2);
+  __m128i r23 = _mm_unpackhi_epi32(b0, b2);
+  __m128i r45 = _mm_unpacklo_epi32(b1, b3);
+  __m128i r67 = _mm_unpackhi_epi32(b1, b3);
+
+  _mm_storel_epi64((__m128i*)(dst + 0 * dst_stride), r01);
+  _mm_storel_epi64((__m128i*)(dst + 1 * dst_stride), _mm_unpackhi_epi64(r01, r01));
+  _mm_storel_epi64((__m128i*)(dst + 2 * dst_stride), r23);
+  _mm_storel_epi64((__m128i*)(dst + 3 * dst_stride), _mm_unpackhi_epi64(r23, r23));
+  _mm_storel_epi64((__m128i*)(dst + 4 * dst_stride), r45);
+  _mm_storel_epi64((__m128i*)(dst + 5 * dst_stride), _mm_unpackhi_epi64(r45, r45));
+  _mm_storel_epi64((__m128i*)(dst + 6 * dst_stride), r67);
+  _mm_storel_epi64((__m128i*)(dst + 7 * dst_stride), _mm_unpackhi_epi64(r67, r67));
+}
+#endif
+
+/* Transposes width columns of height bytes, src_stride apart, to height
+ * rows of width bytes, dst_stride apart. */
+static INLINE void
+artdecode_block(const u8* src, usize src_stride, u8* dst, usize dst_stride, usize width, usize height)
+{
+  usize x = 0;
+
+#if defined(ARTDECODE_SSE2)
+  for (; x + 8 <= width; x += 8)
+  {
+    usize y = 0;
+
+    for (; y + 8 <= height; y += 8)
+    {
+      artdecode_8x8(src + x * src_stride + y, src_stride, dst + y * dst_stride + x, dst_stride);
+    }
+    for (; y < height; ++y)
+    {
+      usize k = 0;
+
+      for (; k < 8; ++k)
+      {
+        dst[y * dst_stride + x + k] = src[(x + k) * src_stride + y];
+      }
+    }
+  }
+#endif
+
+  for (; x < width; ++x)
+  {
+    usize y = 0;
+
+    for (; y < height; ++y)
+    {
+      dst[y * dst_stride + x] = src[x * src_stride + y];
+    }
+  }
+}
+
+/* A width x height tile to row-major palette indices. */
+static INLINE void
+artdecode_transpose(const u8* src, usize width, usize height, u8* dst)
+{
+  usize bx = 0;
+
+  for (; bx < width; bx += e_artdecode_block)
+  {
+    usize bw = width - bx < e_artdecode_block ? width - bx : e_artdecode_block;
+    usize by = 0;
+
+    for (; by < height; by += e_artdecode_block)
+    {
+      usize bh = height - by < e_artdecode_block ? height - by : e_artdecode_block;
+
+      artdecode_block(src + bx * height + by, height, dst + by * width + bx, width, bw, bh);
+    }
+  }
+}
+
+/* n indices to n pixels of lut, whose 4 bytes are stored as is. dst
+ * needs no alignment. */
+static INLINE void
+artdecode_lookup(const u8* src, usize n, const u32* lut, u8* dst)
+{
+  usize i = 0;
+
+#if defined(ARTDECODE_AVX2)
+  for (; i + 8 <= n; i += 8)
+  {
+    __m256i index = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(src + i)));
+    _mm256_storeu_si256((__m256i*)(dst + 4 * i), _mm256_i32gather_epi32((const int*)lut, index, 4));
+  }
+#endif
+
+  for (; i < n; ++i)
+  {
+    memcpy(dst + 4 * i, &lut[src[i]], 4);
+  }
+}
+
+/* A width x height tile to row-major pixels of lut. */
+static INLINE void
+artdecode_pixels(const u8* src, usize width, usize height, const u32* lut, u8* dst)
+{
+  u8 block[e_artdecode_block * e_artdecode_block];
+  usize bx = 0;
+
+  for (; bx < width; bx += e_artdecode_block)
+  {
+    usize bw = width - bx < e_artdecode_block ? width - bx : e_artdecode_block;
+    usize by = 0;
+
+    for (; by < height; by += e_artdecode_block)
+    {
+      usize bh = height - by < e_artdecode_block ? height - by : e_artdecode_block;
+      usize y = 0;
+
+      artdecode_block(src + bx * height + by, height, block, e_artdecode_block, bw, bh);
+      for (; y < bh; ++y)
+      {
+        artdecode_lookup(block + y * e_artdecode_block, bw, lut, dst + 4 * ((by + y) * width + bx));
+      }
+    }
+  }
+}
+
+#endif /* ARTDECODE_H */
@@ -0,0 +1,549 @@
+/* SPDX-License-Identifier: MIT */
+/**
+ * @file   bench.c
+ * @author Marc-Alexandre Espiaut <ma.dev@espiaut.fr>
+ * @date   2026-03-18
+ * @version 1.1
+ * @brief  Measures the parsers and the GRP code over a corpus of files.
+ *
+ * @copyright Copyright (c) 2026 Marc-Alexandre Espiaut
+ */
+
+#if defined(__linux__)
+#define _GNU_SOURCE /* copy_file_range(), splice(), O_DIRECT for fileio.h */
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#if defined(_WIN32)
+#include <direct.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "arena.h"
+#include "errorcodes.h"
+#include "fileio.h"
+#include "filelist.h"
+#include "grpextract.h"
+#include "grpreader.h"
+#include "grpwriter.h"
+#include "hash.h"
+#include "map.h"
+#include "memorystream.h"
+#include "thread.h"
+#include "timing.h"
+#include "types.h"
+#include "voc.h"
+
+#define BENCH_VERSION "1.1"
+
+/* Latencies of every file handled in every round, and the wall time of
+ * the rounds as a whole, overhead included. */
+typedef struct bench_s bench_t;
+struct bench_s
+{
+  const char* name;
+  u64* sample;
+  usize count;
+  usize capacity;
+  u64 bytes;
+  u64 elapsed;
+};
+
+static void
+bench_sample_add(bench_t* bench, u64 ns, u64 bytes)
+{
+  if (bench->count == bench->capacity)
+  {
+    usize capacity = bench->capacity ? bench->capacity * 2 : 1024;
+    u64* grown = realloc(bench->sample, sizeof(*grown) * capacity);
+
+    if (!grown)
+    {
+      perror("realloc");
+      exit(e_error_malloc);
+    }
+    bench->sample = grown;
+    bench->capacity = capacity;
+  }
+
+  bench->sample[bench->count++] = ns;
+  bench->bytes += bytes;
+}
+
+static int
+sample_compare(const void* a, const void* b)
+{
+  u64 x = *(const u64*)a;
+  u64 y = *(const u64*)b;
+
+  return x < y ? -1 : x > y;
+}
+
+/* Nearest rank, on samples already sorted. */
+static f64
+bench_percentile_us(const bench_t* bench, f64 p)
+{
+  usize rank = 0;
+
+  if (!bench->count)
+  {
+    return 0.0;
+  }
+
+  rank = (usize)(p * (f64)bench->count + 0.999999);
+  rank = rank ? rank - 1 : 0;
+  if (rank >= bench->count)
+  {
+    rank = bench->count - 1;
+  }
+
+  return (f64)bench->sample[rank] / 1000.0;
+}
+
+static void
+bench_print(bench_t* bench, int last)
+{
+  f64 seconds = (f64)bench->elapsed / 1e9;
+
+  qsort(bench->sample, bench->count, sizeof(*bench->sample), sample_compare);
+
+  fprintf(stdout, "    {\"name\": \"%s\", \"files\": %lu, \"bytes\": %.0f, \"seconds\": %.6f, \"mb_per_s\": %.3f, \"files_per_s\": %.3f, \"p50_us\": %.3f, \"p99_us\": %.3f}%s\n",
+          bench->name,
+          (unsigned long)bench->count,
+          (f64)bench->bytes,
+          seconds,
+          seconds > 0 ? (f64)bench->bytes / 1e6 / seconds : 0.0,
+          seconds > 0 ? (f64)bench->count / seconds : 0.0,
+          bench_percentile_us(bench, 0.50),
+          bench_percentile_us(bench, 0.99),
+          last ? "" : ",");
+}
+
+static int
+has_extension(const char* path, const char* extension)
+{
+  usize len = strlen(path);
+  usize ext_len = strlen(extension);
+  usize i = 0;
+
+  if (len < ext_len)
+  {
+    return 0;
+  }
+
+  for (path += len - ext_len; i < ext_len; ++i)
+  {
+    char c = path[i];
+
+    if (c >= 'A' && c <= 'Z')
+    {
+      c = (char)(c + ('a' - 'A'));
+    }
+    if (c != extension[i])
+    {
+      return 0;
+    }
+  }
+
+  return 1;
+}
+
+/* The same work as mapinfo, minus the printing. */
+static void
+bench_map(bench_t* bench, char* path[], usize n, u32 rounds)
+{
+  MemoryStream ms = {0};
+  Arena arena = {0};
+  u64 start = timing_now();
+  u32 round = 0;
+
+  for (; round < rounds; ++round)
+  {
+    usize i = 0;
+
+    for (; i < n; ++i)
+    {
+      map_t map = {0};
+      map_summary_t summary = {0};
+      u64 t0 = 0;
+      u64 size = 0;
+
+      if (!has_extension(path[i], ".map"))
+      {
+        continue;
+      }
+
+      t0 = timing_now();
+      memorystream_init(&ms, path[i]);
+      size = (u64)ms.size;
+      map_parse(&ms, &map, &arena);
+      memorystream_free(&ms);
+      map_analyze(&map, &summary);
+      arena_reset(&arena);
+      bench_sample_add(bench, timing_now() - t0, size);
+    }
+  }
+
+  bench->elapsed = timing_now() - start;
+  arena_free(&arena);
+}
+
+/* The same walk as vocinfo, minus the printing. */
+static void
+bench_voc(bench_t* bench, char* path[], usize n, u32 rounds)
+{
+  u64 start = timing_now();
+  u32 round = 0;
+
+  for (; round < rounds; ++round)
+  {
+    usize i = 0;
+
+    for (; i < n; ++i)
+    {
+      VocStream vs;
+      voc_header_t header = {0};
+      block_header_t bh = {0};
+      i64 offset = 0;
+      u64 t0 = 0;
+      u64 size = 0;
+
+      if (!has_extension(path[i], ".voc"))
+      {
+        continue;
+      }
+
+      t0 = timing_now();
+      vocstream_open(&vs, path[i]);
+      if (voc_header_parse(&vs, &header))
+      {
+        while (voc_block_next(&vs, &bh, &offset))
+        {
+        }
+      }
+      size = (u64)vs.position; /* as far as the walk went */
+      vocstream_close(&vs);
+      bench_sample_add(bench, timing_now() - t0, size);
+    }
+  }
+
+  bench->elapsed = timing_now() - start;
+}
+
+/* Packs every file of the corpus into scratch through grpwriter.h, the
+ * code grp runs: kernel copies where it can, the directory backpatched
+ * last. A member's latency is its open, read and write. */
+static void
+bench_grp_pack(bench_t* bench, char* path[], usize n, u32 rounds, const char* scratch)
+{
+  GrpMember* member = calloc(n ? n : 1, sizeof(*member));
+  u64 start = 0;
+  u32 round = 0;
+  usize i = 0;
+
+  if (!member)
+  {
+    perror("calloc");
+    exit(e_error_malloc);
+  }
+
+  /* Named after the file, not the path, so the reader side finds every
+   * member. */
+  for (; i < n; ++i)
+  {
+    char name[e_grp_name_len + 1] = {0};
+    const char* base = path[i];
+    const char* c = path[i];
+
+    for (; *c; ++c)
+    {
+      if (*c == '/' || *c == '\\')
+      {
+        base = c + 1;
+      }
+    }
+
+    grpreader_name_fold(name, base);
+    memcpy(member[i].name, name, e_grp_name_len);
+    member[i].path = path[i];
+    member[i].old = -1;
+  }
+
+  start = timing_now();
+  for (; round < rounds; ++round)
+  {
+    GrpWriter w;
+    FILE* fp = fileio_fopen(scratch, "wb+");
+
+    grpwriter_begin(&w, fp, member, n, NULL, NULL, NULL, NULL, NULL);
+    for (i = 0; i < n; ++i)
+    {
+      u64 t0 = timing_now();
+      u64 size = grpwriter_member(&w, i);
+
+      bench_sample_add(bench, timing_now() - t0, size);
+    }
+    grpwriter_end(&w);
+    fileio_fclose(fp);
+  }
+
+  bench->elapsed = timing_now() - start;
+  free(member);
+}
+
+/* Opens the packed archive and reads every member through the mapping,
+ * as ungrp does before writing it out. Hashing stands in for the write so
+ * the bytes are really touched. */
+static void
+bench_grp_read(bench_t* bench, u32 rounds, const char* scratch)
+{
+  u64 start = timing_now();
+  u64 sink = 0;
+  u32 round = 0;
+
+  for (; round < rounds; ++round)
+  {
+    GrpReader grp = {0};
+    u32 i = 0;
+
+    grpreader_open(&grp, (char*)scratch);
+    for (; i < grp.count; ++i)
+    {
+      u64 t0 = timing_now();
+
+      sink ^= hash_xxh64(grpreader_data(&grp, i), grp.entry[i].size, 0);
+      bench_sample_add(bench, timing_now() - t0, grp.entry[i].size);
+    }
+    grpreader_close(&grp);
+  }
+
+  bench->elapsed = timing_now() - start;
+
+  /* Keeps the hashing from being optimized away. */
+  if (sink == 1)
+  {
+    fprintf(stderr, "\n");
+  }
+}
+
+/* Extracts the packed archive into dir through grpextract.h, the code
+ * ungrp runs, with the same threads and flags. The files are removed
+ * between rounds, outside of the timing. Basenames can repeat across a
+ * corpus, so members overwrite each other instead of failing like
+ * ungrp's exclusive create would. */
+static void
+bench_grp_extract(bench_t* bench, u32 rounds, const char* scratch, const char* dir, u32 jobs, int flags)
+{
+  u32 round = 0;
+
+#if defined(_WIN32)
+  _mkdir(dir);
+#else
+  mkdir(dir, 0777);
+#endif
+
+  for (; round < rounds; ++round)
+  {
+    GrpReader grp = {0};
+    GrpExtractEntry* member = NULL;
+    u64* latency = NULL;
+    u64 t0 = 0;
+    u32 i = 0;
+
+    grpreader_open(&grp, (char*)scratch);
+    member = malloc(sizeof(*member) * (grp.count ? grp.count : 1));
+    latency = calloc(grp.count ? grp.count : 1, sizeof(*latency));
+    if (!member || !latency)
+    {
+      perror("malloc");
+      exit(e_error_malloc);
+    }
+    for (; i < grp.count; ++i)
+    {
+      member[i].name = grp.entry[i].name;
+      member[i].size = grp.entry[i].size;
+      member[i].offset = grp.entry[i].offset;
+    }
+
+    t0 = timing_now();
+    grpextract_members(grp.ms.data, member, grp.count, jobs, flags, dir, NULL, NULL, latency);
+    bench->elapsed += timing_now() - t0;
+
+    for (i = 0; i < grp.count; ++i)
+    {
+      char path[FILENAME_MAX];
+
+      bench_sample_add(bench, latency[i], grp.entry[i].size);
+      if (grpextract_is_safe_name(grp.entry[i].name))
+      {
+        sprintf(path, "%s/%s", dir, grp.entry[i].name);
+        remove(path);
+      }
+    }
+
+    free(latency);
+    free(member);
+    grpreader_close(&grp);
+  }
+
+#if defined(_WIN32)
+  _rmdir(dir);
+#else
+  rmdir(dir);
+#endif
+}
+
+static void
+usage(const char* prgname, const char* prgver)
+{
+  fprintf(stderr, "%s %s : Copyright (c) 2026 Marc-Alexandre Espiaut\n", prgname, prgver);
+  fprintf(stderr, "\n");
+  fprintf(stderr, "%s is a tool for benchmarking the duke3d-cli-tools parsers and writers.\n", prgname);
+  fprintf(stderr, "\n");
+  fprintf(stderr, "Usage: %s [options] [directories or files]\n", prgname);
+  fprintf(stderr, "\n");
+  fprintf(stderr, "Runs map_parse on .map files, voc_walk on .voc files, then grp_pack,\n");
+  fprintf(stderr, "grp_read and grp_extract on all of them, and prints the results as JSON on\n");
+  fprintf(stderr, "stdout.\n");
+  fprintf(stderr, "\n");
+  fprintf(stderr, "Options:\n");
+  fprintf(stderr, "  -h, --help             Show this help message and exit\n");
+  fprintf(stderr, "  -r, --rounds N         Run every benchmark N times over the corpus (default: 5)\n");
+  fprintf(stderr, "  -o, --scratch FILE     Archive written by grp_pack (default: bench.tmp.grp)\n");
+  fprintf(stderr, "  -x, --extract DIR      Directory written by grp_extract (default: bench.tmp.d)\n");
+  fprintf(stderr, "  -j, --jobs N           Extract with N threads (0: one per CPU)\n");
+  fprintf(stderr, "  -d, --direct           Write large members around the page cache (O_DIRECT)\n");
+  fprintf(stderr, "  -l, --list LIST.TXT    Add files as listed in LIST.TXT (- for stdin)\n");
+  fprintf(stderr, "\n");
+  fprintf(stderr, "Examples:\n");
+  fprintf(stderr, "  %s fuzz_inputs\n", prgname);
+  fprintf(stderr, "  %s -r 20 maps sounds > before.json\n", prgname);
+  fprintf(stderr, "  %s -j 0 fuzz_inputs\n", prgname);
+  exit(EXIT_FAILURE);
+}
+
+int
+main(int argc, char* argv[])
+{
+  FileList files = {0};
+  bench_t bench[5] = {{0}};
+  const char* scratch = "bench.tmp.grp";
+  const char* dir = "bench.tmp.d";
+  u32 rounds = 5;
+  u32 jobs = 1;
+  int flags = 0;
+  int i;
+
+  if (argc < 2)
+  {
+    usage(argv[0], BENCH_VERSION);
+  }
+
+  for (i = 1; i < argc; ++i)
+  {
+    if (!strcmp(argv[i], "-h") || !strcmp(argv[i], "--help"))
+    {
+      usage(argv[0], BENCH_VERSION);
+    }
+    else if (!strcmp(argv[i], "-r") || !strcmp(argv[i], "--rounds"))
+    {
+      if (++i == argc)
+      {
+        usage(argv[0], BENCH_VERSION);
+      }
+      rounds = (u32)strtoul(argv[i], NULL, 10);
+    }
+    else if (!strcmp(argv[i], "-o") || !strcmp(argv[i], "--scratch"))
+    {
+      if (++i == argc)
+      {
+        usage(argv[0], BENCH_VERSION);
+      }
+      scratch = argv[i];
+    }
+    else if (!strcmp(argv[i], "-x") || !strcmp(argv[i], "--extract"))
+    {
+      if (++i == argc)
+      {
+        usage(argv[0], BENCH_VERSION);
+      }
+      dir = argv[i];
+    }
+    else if (!strcmp(argv[i], "-j") || !strcmp(argv[i], "--jobs"))
+    {
+      if (++i == argc)
+      {
+        usage(argv[0], BENCH_VERSION);
+      }
+      jobs = (u32)strtoul(argv[i], NULL, 10);
+      if (!jobs)
+      {
+        jobs = thread_cpu_count();
+      }
+    }
+    else if (!strcmp(argv[i], "-d") || !strcmp(argv[i], "--direct"))
+    {
+      flags |= e_fileio_direct;
+    }
+    else if (!strcmp(argv[i], "-l") || !strcmp(argv[i], "--list"))
+    {
+      if (++i == argc)
+      {
+        usage(argv[0], BENCH_VERSION);
+      }
+      filelist_load(&files, argv[i]);
+    }
+    else
+    {
+      struct stat st;
+
+      if (stat(argv[i], &st) == 0 && S_ISDIR(st.st_mode))
+      {
+        filelist_load_dir(&files, argv[i]);
+      }
+      else
+      {
+        filelist_add(&files, argv[i]);
+      }
+    }
+  }
+
+  if (!files.count || !rounds)
+  {
+    usage(argv[0], BENCH_VERSION);
+  }
+
+  bench[0].name = "map_parse";
+  bench[1].name = "voc_walk";
+  bench[2].name = "grp_pack";
+  bench[3].name = "grp_read";
+  bench[4].name = "grp_extract";
+
+  bench_map(&bench[0], files.path, files.count, rounds);
+  bench_voc(&bench[1], files.path, files.count, rounds);
+  bench_grp_pack(&bench[2], files.path, files.count, rounds, scratch);
+  bench_grp_read(&bench[3], rounds, scratch);
+  bench_grp_extract(&bench[4], rounds, scratch, dir, jobs, flags);
+  remove(scratch);
+
+  fprintf(stdout, "{\n");
+  fprintf(stdout, "  \"version\": \"%s\",\n", BENCH_VERSION);
+  fprintf(stdout, "  \"rounds\": %lu,\n", (unsigned long)rounds);
+  fprintf(stdout, "  \"benchmarks\": [\n");
+  for (i = 0; i < 5; ++i)
+  {
+    bench_print(&bench[i], i == 4);
+    free(bench[i].sample);
+  }
+  fprintf(stdout, "  ]\n");
+  fprintf(stdout, "}\n");
+
+  filelist_free(&files);
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,439 @@
+/* SPDX-License-Identifier: MIT */
+/**
+ * @file   contentcache.h
+ * @author Marc-Alexandre Espiaut <ma.dev@espiaut.fr>
+ * @date   2026-03-16
+ * @brief  Content-addressed cache of archive members.
+ *
+ * The cache is a directory holding one blob per distinct content, named by
+ * its XXH64 in hex, and an "index" text file remembering the hash of each
+ * source, by canonical path, along with its stamp (see filestamp.h). A
+ * source whose stamp did not change since it was last packed is then
+ * copied from its blob, which the kernel can reflink, without reading the
+ * source tree at all. Sources without a stamp are always read.
+ *
+ * @copyright Copyright (c) 2026 Marc-Alexandre Espiaut
+ */
+
+#ifndef CONTENTCACHE_H
+#define CONTENTCACHE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#if defined(_WIN32)
+#include <direct.h>
+#endif
+
+#include "errorcodes.h"
+#include "fileio.h"
+#include "filestamp.h"
+#include "hash.h"
+#include "memorystream.h"
+#include "types.h"
+
+enum
+{
+  e_contentcache_version = 2
+};
+
+typedef struct CacheRecord CacheRecord;
+struct CacheRecord
+{
+  char* path; /* canonical */
+  FileStamp stamp;
+  u64 hash;
+};
+
+typedef struct ContentCache ContentCache;
+struct ContentCache
+{
+  char* dir;
+  char* path; /* scratch buffers for contentcache_path() */
+  char* tmp_path;
+  CacheRecord* record;
+  usize count;
+  usize capacity;
+  u32* index; /* open addressing on the path, record index + 1, 0 when empty */
+  u32 index_mask;
+  int dirty;
+};
+
+static INLINE const char*
+contentcache_path(ContentCache* cache, char* dst, const char* name, const char* suffix)
+{
+  sprintf(dst, "%s/%s%s", cache->dir, name, suffix);
+  return dst;
+}
+
+/* Moves name.tmp over name once it is complete, so a crash never leaves a
+ * truncated file behind. */
+static INLINE void
+contentcache_commit(ContentCache* cache, const char* name)
+{
+  contentcache_path(cache, cache->tmp_path, name, ".tmp");
+  contentcache_path(cache, cache->path, name, "");
+  fileio_replace(cache->tmp_path, cache->path);
+}
+
+static INLINE void
+contentcache_index_insert(ContentCache* cache, usize i)
+{
+  u32 slot = (u32)hash_xxh64(cache->record[i].path, strlen(cache->record[i].path), 0) & cache->index_mask;
+
+  while (cache->index[slot])
+  {
+    slot = (slot + 1) & cache->index_mask;
+  }
+  cache->index[slot] = (u32)i + 1;
+}
+
+static INLINE i64
+contentcache_index_find(ContentCache* cache, const char* path)
+{
+  u32 slot = 0;
+
+  if (!cache->index)
+  {
+    return -1;
+  }
+
+  slot = (u32)hash_xxh64(path, strlen(path), 0) & cache->index_mask;
+  while (cache->index[slot])
+  {
+    u32 i = cache->index[slot] - 1;
+
+    if (!strcmp(cache->record[i].path, path))
+    {
+      return (i64)i;
+    }
+    slot = (slot + 1) & cache->index_mask;
+  }
+
+  return -1;
+}
+
+/* Keeps the table at most half full. */
+static INLINE void
+contentcache_record_add(ContentCache* cache, const char* path, usize path_len, const FileStamp* stamp, u64 hash)
+{
+  CacheRecord* record = NULL;
+  i64 found = -1;
+
+  if ((cache->count + 1) * 2 > (usize)cache->index_mask + 1 || !cache->index)
+  {
+    usize slots = cache->index ? ((usize)cache->index_mask + 1) * 2 : 256;
+    usize i = 0;
+
+    free(cache->index);
+    cache->index = calloc(slots, sizeof(*cache->index));
+    if (!cache->index)
+    {
+      perror("calloc");
+      exit(e_error_malloc);
+    }
+    cache->index_mask = (u32)(slots - 1);
+
+    for (; i < cache->count; ++i)
+    {
+      contentcache_index_insert(cache, i);
+    }
+  }
+
+  if (cache->count == cache->capacity)
+  {
+    usize capacity = cache->capacity ? cache->capacity * 2 : 64;
+    CacheRecord* grown = realloc(cache->record, sizeof(*grown) * capacity);
+
+    if (!grown)
+    {
+      perror("realloc");
+      exit(e_error_malloc);
+    }
+    cache->record = grown;
+    cache->capacity = capacity;
+  }
+
+  record = &cache->record[cache->count];
+  record->path = malloc(path_len + 1);
+  if (!record->path)
+  {
+    perror("malloc");
+    exit(e_error_malloc);
+  }
+  memcpy(record->path, path, path_len);
+  record->path[path_len] = '\0';
+
+  /* A path packed again replaces its old record. */
+  found = contentcache_index_find(cache, record->path);
+  if (found >= 0)
+  {
+    free(record->path);
+    record = &cache->record[found];
+  }
+  else
+  {
+    contentcache_index_insert(cache, cache->count++);
+  }
+
+  record->stamp = *stamp;
+  record->hash = hash;
+}
+
+/* A version line, then one record per line: hash, size, inode, mtime,
+ * its nanoseconds, ctime, its nanoseconds and the path up to the end of
+ * the line. An index of another version is ignored, and so are the lines
+ * that don't parse: the cache is only a hint. */
+static INLINE void
+contentcache_index_load(ContentCache* cache)
+{
+  MemoryStream ms = {0};
+  FILE* fp = fopen(contentcache_path(cache, cache->path, "index", ""), "rb");
+  const char* p = NULL;
+  const char* end = NULL;
+
+  if (!fp)
+  {
+    return;
+  }
+  fclose(fp);
+
+  memorystream_init(&ms, cache->path);
+  p = (const char*)ms.data;
+  end = p + ms.size;
+
+  {
+    char version[32] = {0};
+    const char* line_end = memchr(p, '\n', (size_t)(end - p));
+
+    sprintf(version, "contentcache %d\n", e_contentcache_version);
+    if (!line_end || (usize)(line_end + 1 - p) != strlen(version) || memcmp(p, version, strlen(version)))
+    {
+      memorystream_free(&ms);
+      return;
+    }
+    p = line_end + 1;
+  }
+
+  while (p < end)
+  {
+    const char* line_end = memchr(p, '\n', (size_t)(end - p));
+    char line[192] = {0};
+    const char* path = NULL;
+    unsigned long size = 0;
+    unsigned long inode = 0;
+    long mtime = 0;
+    long mtime_nsec = 0;
+    long ctime = 0;
+    long ctime_nsec = 0;
+    u64 hash = 0;
+    int consumed = 0;
+
+    if (!line_end)
+    {
+      line_end = end;
+    }
+
+    /* The numbers fit in well under 192 bytes: parse them from a
+     * terminated copy, the mapping isn't. */
+    memcpy(line, p, (size_t)(line_end - p) < sizeof(line) - 1 ? (size_t)(line_end - p) : sizeof(line) - 1);
+
+    if (hash_hex_parse(line, &hash) &&
+        sscanf(line + 16, " %lu %lu %ld %ld %ld %ld %n", &size, &inode, &mtime, &mtime_nsec, &ctime, &ctime_nsec, &consumed) == 6 && consumed)
+    {
+      path = p + 16 + consumed;
+      if (path < line_end)
+      {
+        FileStamp stamp;
+
+        stamp.size = size;
+        stamp.inode = inode;
+        stamp.mtime = mtime;
+        stamp.mtime_nsec = mtime_nsec;
+        stamp.ctime = ctime;
+        stamp.ctime_nsec = ctime_nsec;
+        contentcache_record_add(cache, path, (usize)(line_end - path), &stamp, hash);
+      }
+    }
+
+    p = line_end + 1;
+  }
+
+  memorystream_free(&ms);
+  cache->dirty = 0;
+}
+
+static INLINE void
+contentcache_open(ContentCache* cache, const char* dir)
+{
+  usize len = strlen(dir);
+
+  memset(cache, 0, sizeof(*cache));
+
+  /* Room for the longest name built by contentcache_path(). */
+  cache->dir = malloc(len + 1);
+  cache->path = malloc(len + sizeof("/0123456789abcdef.tmp"));
+  cache->tmp_path = malloc(len + sizeof("/0123456789abcdef.tmp"));
+  if (!cache->dir || !cache->path || !cache->tmp_path)
+  {
+    perror("malloc");
+    exit(e_error_malloc);
+  }
+  memcpy(cache->dir, dir, len + 1);
+
+  /* Fails harmlessly when it already exists; any real problem shows up at
+   * the first blob written. */
+#if defined(_WIN32)
+  _mkdir(dir);
+#else
+  mkdir(dir, 0777);
+#endif
+
+  contentcache_index_load(cache);
+}
+
+/* Fills key with the canonical path and the stamp of the source at path.
+ * Returns 0, leaving nothing to free, when the source can't be cached. */
+static INLINE int
+contentcache_key(const char* path, CacheRecord* key)
+{
+  memset(key, 0, sizeof(*key));
+
+  if (!filestamp_get(path, &key->stamp) || !(key->path = filestamp_canonical(path)))
+  {
+    return 0;
+  }
+  return 1;
+}
+
+/* Returns 1 and the hash when the source of key was packed with the same
+ * stamp. */
+static INLINE int
+contentcache_find(ContentCache* cache, const CacheRecord* key, u64* hash)
+{
+  i64 found = contentcache_index_find(cache, key->path);
+
+  if (found < 0 || !filestamp_equal(&cache->record[found].stamp, &key->stamp))
+  {
+    return 0;
+  }
+
+  *hash = cache->record[found].hash;
+  return 1;
+}
+
+/* Opens the blob of a hash, or returns NULL when it is missing or does not
+ * have the expected size, so the caller packs from the source instead. */
+static INLINE FILE*
+contentcache_blob_open(ContentCache* cache, u64 hash, u64 size)
+{
+  char name[17] = {0};
+  struct stat st;
+  FILE* fp = NULL;
+
+  hash_hex(hash, name);
+  fp = fopen(contentcache_path(cache, cache->path, name, ""), "rb");
+  if (!fp)
+  {
+    return NULL;
+  }
+
+  if (fstat(fileno(fp), &st) == -1 || (u64)st.st_size != size)
+  {
+    fclose(fp);
+    return NULL;
+  }
+
+  return fp;
+}
+
+/* Records the hash of the source of key and stores its contents unless a
+ * blob with the same hash is already there. data holds key->stamp.size
+ * bytes, read after the key was taken. */
+static INLINE void
+contentcache_store(ContentCache* cache, const CacheRecord* key, u64 hash, const u8* data)
+{
+  u64 size = key->stamp.size;
+  char name[17] = {0};
+  FILE* fp = NULL;
+
+  hash_hex(hash, name);
+  fp = fopen(contentcache_path(cache, cache->path, name, ""), "rb");
+  if (fp)
+  {
+    fclose(fp);
+  }
+  else
+  {
+    fp = fopen(contentcache_path(cache, cache->tmp_path, name, ".tmp"), "wb");
+    if (!fp)
+    {
+      perror("fopen");
+      exit(e_error_fopen);
+    }
+    if (size && fwrite(data, 1, (size_t)size, fp) != size)
+    {
+      perror("fwrite");
+      exit(e_error_fwrite);
+    }
+    if (fclose(fp) == EOF)
+    {
+      perror("fclose");
+      exit(e_error_fclose);
+    }
+    contentcache_commit(cache, name);
+  }
+
+  contentcache_record_add(cache, key->path, strlen(key->path), &key->stamp, hash);
+  cache->dirty = 1;
+}
+
+/* Writes the index back if anything was stored, then frees the cache. */
+static INLINE void
+contentcache_close(ContentCache* cache)
+{
+  usize i = 0;
+
+  if (cache->dirty)
+  {
+    FILE* fp = fopen(contentcache_path(cache, cache->tmp_path, "index", ".tmp"), "wb");
+
+    if (!fp)
+    {
+      perror("fopen");
+      exit(e_error_fopen);
+    }
+
+    fprintf(fp, "contentcache %d\n", e_contentcache_version);
+    for (; i < cache->count; ++i)
+    {
+      const FileStamp* stamp = &cache->record[i].stamp;
+      char name[17] = {0};
+
+      hash_hex(cache->record[i].hash, name);
+      fprintf(fp, "%s %lu %lu %ld %ld %ld %ld %s\n", name, (unsigned long)stamp->size, (unsigned long)stamp->inode, (long)stamp->mtime, (long)stamp->mtime_nsec, (long)stamp->ctime, (long)stamp->ctime_nsec, cache->record[i].path);
+    }
+
+    if (ferror(fp) || fclose(fp) == EOF)
+    {
+      perror("fwrite");
+      exit(e_error_fwrite);
+    }
+    contentcache_commit(cache, "index");
+  }
+
+  for (i = 0; i < cache->count; ++i)
+  {
+    free(cache->record[i].path);
+  }
+  free(cache->record);
+  free(cache->index);
+  free(cache->dir);
+  free(cache->path);
+  free(cache->tmp_path);
+  memset(cache, 0, sizeof(*cache));
+}
+
+#endif /* CONTENTCACHE_H */
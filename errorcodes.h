@@ -22,7 +22,9 @@ enum
   e_error_ftell,
   e_error_fwrite,
   e_error_malloc,
-  e_error_name_upper
+  e_error_name_upper,
+  e_error_thread,
+  e_error_format
 };
 
 #endif /* ERRORCODES_H */
@@ -0,0 +1,615 @@
+/* SPDX-License-Identifier: MIT */
+/**
+ * @file   fileio.h
+ * @author Marc-Alexandre Espiaut <ma.dev@espiaut.fr>
+ * @date   2026-03-29
+ * @brief  Checked file I/O shared by the tools.
+ *
+ * The stdio wrappers exit with a message on the first failure, like the
+ * rest of the tools. The payload copies move bytes between two files in
+ * the kernel where Linux allows it, and the file writer creates a member
+ * with positional writes straight from a mapping. FileWriter covers the
+ * outputs produced piece by piece: one large aligned buffer, written out
+ * with pwrite(), optionally bypassing the page cache. Inputs are read
+ * through memorystream.h; the hints below tell the kernel how.
+ *
+ * In strict C modes, pwrite() and posix_memalign() are only declared with
+ * _XOPEN_SOURCE 700 on Linux. The kernel copies need copy_file_range()
+ * and splice(), and O_DIRECT is only declared with _GNU_SOURCE, which
+ * implies the former. A tool defines the one it needs before its first
+ * include.
+ *
+ * @copyright Copyright (c) 2026 Marc-Alexandre Espiaut
+ */
+
+#ifndef FILEIO_H
+#define FILEIO_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#define FILEIO_PWRITE
+#endif
+
+#if defined(__linux__) && defined(_GNU_SOURCE)
+#include <sys/sendfile.h>
+#define FILEIO_KERNEL_COPY
+#endif
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#endif
+
+#include "errorcodes.h"
+#include "memorystream.h"
+#include "stats.h"
+#include "types.h"
+
+enum
+{
+  e_fileio_align = 4096,        /* O_DIRECT buffers, offsets and sizes */
+  e_fileio_buffer = 1 << 20,    /* FileWriter, a multiple of e_fileio_align */
+  e_fileio_direct_min = 1 << 23 /* smaller files stay in the page cache */
+};
+
+/* fileio_file_write() and fileio_writer_open() flags. */
+enum
+{
+  e_fileio_exclusive = 1, /* fail if the file exists */
+  e_fileio_direct = 2     /* O_DIRECT where the system and filesystem allow */
+};
+
+/* fileio_map_advise() access patterns. */
+enum
+{
+  e_fileio_sequential, /* read once, front to back: read ahead, drop behind */
+  e_fileio_willneed    /* read soon: start faulting the pages in */
+};
+
+typedef struct FileWriter FileWriter;
+struct FileWriter
+{
+  const char* path;
+#if defined(FILEIO_PWRITE)
+  int fd;
+#else
+  FILE* fp;
+#endif
+  u8* buffer;
+  usize size; /* buffered bytes */
+  u64 offset; /* in the file, of the first buffered byte */
+  int direct; /* fd is open with O_DIRECT */
+};
+
+static INLINE void
+fileio_fclose(FILE* stream)
+{
+  if (!stream)
+  {
+    exit(e_error_fclose);
+  }
+
+  if (fclose(stream) == EOF)
+  {
+    perror("fclose");
+    exit(e_error_fclose);
+  }
+}
+
+static INLINE void
+fileio_fwrite(const void* ptr, size_t size, size_t n, FILE* stream)
+{
+  if (!ptr || !stream)
+  {
+    exit(e_error_fwrite);
+  }
+
+  if (fwrite(ptr, size, n, stream) != n)
+  {
+    perror("fwrite");
+    fileio_fclose(stream);
+    exit(e_error_fwrite);
+  }
+}
+
+static INLINE int
+fileio_fseek(FILE* stream, long offset, int whence)
+{
+  int result = 0;
+
+  if (!stream)
+  {
+    exit(e_error_fseek);
+  }
+
+  result = fseek(stream, offset, whence);
+  if (result == -1)
+  {
+    perror("fseek");
+    exit(e_error_fseek);
+  }
+
+  return result;
+}
+
+static INLINE FILE*
+fileio_fopen(const char* path, const char* mode)
+{
+  FILE* fp = NULL;
+
+  if (!path || !mode)
+  {
+    exit(e_error_fopen);
+  }
+
+  fp = fopen(path, mode);
+  if (!fp)
+  {
+    perror("fopen");
+    exit(e_error_fopen);
+  }
+  return fp;
+}
+
+static INLINE void
+fileio_abort_if_exists(const char* path)
+{
+  FILE* fp = fopen(path, "rb");
+
+  if (fp)
+  {
+    fileio_fclose(fp);
+    fprintf(stderr, "ERROR: %s already exists! Quitting!\n", path);
+    exit(EXIT_FAILURE);
+  }
+}
+
+/* Moves the complete file tmp over path, so that path is never seen half
+ * written. Windows can't replace a file that is open or mapped. */
+static INLINE void
+fileio_replace(const char* tmp, const char* path)
+{
+#if defined(_WIN32)
+  if (!MoveFileExA(tmp, path, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH))
+  {
+    fprintf(stderr, "ERROR: Cannot replace %s with %s!\n", path, tmp);
+    exit(e_error_fwrite);
+  }
+#else
+  if (rename(tmp, path) == -1)
+  {
+    perror("rename");
+    exit(e_error_fwrite);
+  }
+#endif
+}
+
+/* Tells the kernel fd will be read front to back, so it reads ahead more
+ * aggressively. Only a hint: pipes and systems without posix_fadvise()
+ * just ignore it. */
+static INLINE void
+fileio_advise_sequential(int fd)
+{
+#if defined(FILEIO_PWRITE) && defined(POSIX_FADV_SEQUENTIAL)
+  posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#else
+  (void)fd;
+#endif
+}
+
+/* The same hint for length bytes at offset of a mapped stream; heap copies
+ * are already in memory and are left alone. */
+static INLINE void
+fileio_map_advise(const MemoryStream* ms, i64 offset, i64 length, int advice)
+{
+#if defined(FILEIO_PWRITE) && defined(POSIX_MADV_SEQUENTIAL)
+  i64 page = (i64)sysconf(_SC_PAGESIZE);
+  i64 start = 0;
+
+  if (!ms->mapped || length <= 0 || page <= 0)
+  {
+    return;
+  }
+
+  start = offset - offset % page;
+  posix_madvise(ms->data + start, (size_t)(offset + length - start), advice == e_fileio_sequential ? POSIX_MADV_SEQUENTIAL : POSIX_MADV_WILLNEED);
+#else
+  (void)ms;
+  (void)offset;
+  (void)length;
+  (void)advice;
+#endif
+}
+
+#if defined(FILEIO_KERNEL_COPY)
+/* Moves bytes from in_fp to the end of out_fp without going through user
+ * space. copy_file_range() lets the filesystem reflink or copy server-side
+ * where it can; sendfile() covers kernels and filesystem pairs that refuse
+ * it, and splice() takes over when in_fp is a pipe. With a negative offset,
+ * the rest of in_fp is copied from its current position; otherwise at most
+ * length bytes are copied from offset, leaving the position of in_fp alone.
+ * Returns the number of bytes copied, or 0 when neither call could start so
+ * the caller falls back to stdio. */
+static INLINE u64
+fileio_copy_kernel(FILE* in_fp, i64 offset, u64 length, FILE* out_fp, Stats* stats)
+{
+  u64 calls = 2; /* the flush and the seek */
+  const u64 chunk = 0x40000000;
+  int in_fd = fileno(in_fp);
+  int out_fd = fileno(out_fp);
+  loff_t range_offset = (loff_t)offset;
+  off_t send_offset = (off_t)offset;
+  u64 total = 0;
+  ssize_t result = 0;
+  const char* call = "copy_file_range";
+
+  if (fflush(out_fp) == EOF)
+  {
+    perror("fflush");
+    exit(e_error_fwrite);
+  }
+
+  while (total < length &&
+         (result = copy_file_range(in_fd, offset < 0 ? NULL : &range_offset, out_fd, NULL, (size_t)(length - total < chunk ? length - total : chunk), 0)) > 0)
+  {
+    total += (u64)result;
+    ++calls;
+  }
+  ++calls;
+
+  if (result < 0 && total == 0)
+  {
+    call = "sendfile";
+    while (total < length && (result = sendfile(out_fd, in_fd, offset < 0 ? NULL : &send_offset, (size_t)(length - total < chunk ? length - total : chunk))) > 0)
+    {
+      total += (u64)result;
+      ++calls;
+    }
+    ++calls;
+  }
+
+  if (result < 0 && total == 0 && offset < 0)
+  {
+    call = "splice";
+    while ((result = splice(in_fd, NULL, out_fd, NULL, (size_t)chunk, SPLICE_F_MOVE)) > 0)
+    {
+      total += (u64)result;
+      ++calls;
+    }
+    ++calls;
+  }
+
+  if (result < 0 && total != 0)
+  {
+    perror(call);
+    exit(e_error_fwrite);
+  }
+
+  /* The descriptor moved behind stdio's back. */
+  fileio_fseek(out_fp, 0, SEEK_END);
+
+  stats_io(stats, 0, 0, calls);
+  return total;
+}
+#endif
+
+/* Copies the rest of in_fp to out_fp and returns how many bytes that was. */
+static INLINE u64
+fileio_copy(FILE* in_fp, FILE* out_fp, Stats* stats)
+{
+  u64 total = 0;
+  size_t j = 0;
+  char buf[8192] = {0};
+
+  fileio_advise_sequential(fileno(in_fp));
+
+#if defined(FILEIO_KERNEL_COPY)
+  total = fileio_copy_kernel(in_fp, -1, (u64)-1, out_fp, stats);
+  if (total)
+  {
+    return total;
+  }
+#endif
+
+  while ((j = fread(buf, 1, sizeof(buf), in_fp)) > 0)
+  {
+    fileio_fwrite(buf, 1, j, out_fp);
+    total += j;
+    stats_io(stats, 0, 0, 2);
+  }
+
+  return total;
+}
+
+#if defined(FILEIO_PWRITE)
+static INLINE void
+fileio_pwrite(int fd, const u8* src, u64 n, u64 offset)
+{
+  u64 done = 0;
+
+  while (done < n)
+  {
+    ssize_t result = pwrite(fd, src + done, (size_t)(n - done), (off_t)(offset + done));
+
+    if (result < 0)
+    {
+      if (errno == EINTR)
+      {
+        continue;
+      }
+      perror("pwrite");
+      exit(e_error_fwrite);
+    }
+    done += (u64)result;
+  }
+}
+
+static INLINE int
+fileio_open(const char* path, int flags, int* direct)
+{
+  int oflags = O_WRONLY | O_CREAT | ((flags & e_fileio_exclusive) ? O_EXCL : O_TRUNC);
+  int fd = -1;
+
+  *direct = 0;
+#if defined(O_DIRECT)
+  if (flags & e_fileio_direct)
+  {
+    /* tmpfs and a few others refuse O_DIRECT: those simply get a
+     * buffered descriptor, and any other error shows up again below. */
+    fd = open(path, oflags | O_DIRECT, 0666);
+    *direct = fd != -1;
+  }
+#endif
+  if (fd == -1)
+  {
+    fd = open(path, oflags, 0666);
+  }
+
+  if (fd == -1)
+  {
+    if (errno == EEXIST)
+    {
+      fprintf(stderr, "ERROR: %s already exists! Quitting!\n", path);
+      exit(EXIT_FAILURE);
+    }
+    perror("open");
+    exit(e_error_fopen);
+  }
+
+  return fd;
+}
+#endif
+
+/* Opens path for writing; flags are e_fileio_exclusive and
+ * e_fileio_direct. */
+static INLINE void
+fileio_writer_open(FileWriter* w, const char* path, int flags)
+{
+  memset(w, 0, sizeof(*w));
+  w->path = path;
+
+#if defined(FILEIO_PWRITE)
+  w->fd = fileio_open(path, flags, &w->direct);
+  if (posix_memalign((void**)&w->buffer, e_fileio_align, e_fileio_buffer))
+  {
+    w->buffer = NULL;
+  }
+#else
+  if (flags & e_fileio_exclusive)
+  {
+    fileio_abort_if_exists(path);
+  }
+  w->fp = fileio_fopen(path, "wb");
+  w->buffer = malloc(e_fileio_buffer);
+#endif
+
+  if (!w->buffer)
+  {
+    perror("malloc");
+    exit(e_error_malloc);
+  }
+}
+
+/* O_DIRECT only takes aligned transfers: the odd tail and the patches go
+ * through the page cache. */
+static INLINE void
+fileio_writer_direct_off(FileWriter* w)
+{
+#if defined(FILEIO_PWRITE) && defined(O_DIRECT)
+  int fl = 0;
+
+  if (!w->direct)
+  {
+    return;
+  }
+
+  fl = fcntl(w->fd, F_GETFL);
+  if (fl == -1 || fcntl(w->fd, F_SETFL, fl & ~O_DIRECT) == -1)
+  {
+    perror("fcntl");
+    exit(e_error_fwrite);
+  }
+  w->direct = 0;
+#else
+  (void)w;
+#endif
+}
+
+static INLINE void
+fileio_writer_out(FileWriter* w, const u8* src, u64 n)
+{
+#if defined(FILEIO_PWRITE)
+  fileio_pwrite(w->fd, src, n, w->offset);
+#else
+  fileio_fwrite(src, 1, (size_t)n, w->fp);
+#endif
+  w->offset += n;
+}
+
+static INLINE void
+fileio_writer_write(FileWriter* w, const void* src, u64 n)
+{
+  const u8* c = src;
+
+  /* A large write with nothing buffered needs no copy, unless O_DIRECT
+   * wants it in the aligned buffer. */
+  if (!w->size && !w->direct && n >= e_fileio_buffer)
+  {
+    fileio_writer_out(w, c, n);
+    return;
+  }
+
+  while (n)
+  {
+    usize room = e_fileio_buffer - w->size;
+    usize k = n < room ? (usize)n : room;
+
+    memcpy(w->buffer + w->size, c, k);
+    w->size += k;
+    c += k;
+    n -= k;
+
+    if (w->size == e_fileio_buffer)
+    {
+      fileio_writer_out(w, w->buffer, w->size);
+      w->size = 0;
+    }
+  }
+}
+
+/* Overwrites n bytes already written at offset, e.g. a header whose sizes
+ * were only known at the end. */
+static INLINE void
+fileio_writer_patch(FileWriter* w, u64 offset, const void* src, u64 n)
+{
+  const u8* c = src;
+
+  if (offset + n > w->offset + w->size)
+  {
+    fprintf(stderr, "ERROR: %s: patch past the end!\n", w->path);
+    exit(e_error_fwrite);
+  }
+
+  if (offset < w->offset)
+  {
+    u64 k = w->offset - offset < n ? w->offset - offset : n;
+
+    fileio_writer_direct_off(w);
+#if defined(FILEIO_PWRITE)
+    fileio_pwrite(w->fd, c, k, offset);
+#else
+    fileio_fseek(w->fp, (long)offset, SEEK_SET);
+    fileio_fwrite(c, 1, (size_t)k, w->fp);
+    fileio_fseek(w->fp, 0, SEEK_END);
+#endif
+    c += k;
+    offset += k;
+    n -= k;
+  }
+
+  if (n)
+  {
+    memcpy(w->buffer + (offset - w->offset), c, (size_t)n);
+  }
+}
+
+static INLINE void
+fileio_writer_close(FileWriter* w)
+{
+  if (w->direct && w->size % e_fileio_align)
+  {
+    usize head = w->size - w->size % e_fileio_align;
+
+    fileio_writer_out(w, w->buffer, head);
+    fileio_writer_direct_off(w);
+    fileio_writer_out(w, w->buffer + head, w->size - head);
+  }
+  else if (w->size)
+  {
+    fileio_writer_out(w, w->buffer, w->size);
+  }
+
+#if defined(FILEIO_PWRITE)
+  if (close(w->fd) == -1)
+  {
+    perror("close");
+    exit(e_error_fclose);
+  }
+#else
+  fileio_fclose(w->fp);
+#endif
+
+  free(w->buffer);
+  memset(w, 0, sizeof(*w));
+}
+
+#if defined(FILEIO_PWRITE)
+/* Creates path and writes size bytes of data to it with positional writes:
+ * no stdio buffer, and the blocks are reserved before the first write.
+ * Large files asked with e_fileio_direct go through an aligned FileWriter
+ * instead, so they don't push everything else out of the page cache. */
+static INLINE void
+fileio_file_write(const char* path, const u8* data, u64 size, int flags)
+{
+  int direct = 0;
+  int fd = -1;
+
+  if ((flags & e_fileio_direct) && size >= e_fileio_direct_min)
+  {
+    FileWriter w;
+
+    fileio_writer_open(&w, path, flags);
+    fileio_writer_write(&w, data, size);
+    fileio_writer_close(&w);
+    return;
+  }
+
+  fd = fileio_open(path, flags & ~e_fileio_direct, &direct);
+
+#if defined(__linux__) && defined(FALLOC_FL_KEEP_SIZE)
+  if (size)
+  {
+    /* Reserves the extents in one go where the filesystem can. Failures,
+     * EOPNOTSUPP first, are ignored: unlike posix_fallocate(), this never
+     * falls back to writing every block. Declared with _GNU_SOURCE only;
+     * without it the file is just written. */
+    fallocate(fd, FALLOC_FL_KEEP_SIZE, 0, (off_t)size);
+  }
+#endif
+
+  fileio_pwrite(fd, data, size, 0);
+
+  if (close(fd) == -1)
+  {
+    perror("close");
+    exit(e_error_fclose);
+  }
+}
+#else
+static INLINE void
+fileio_file_write(const char* path, const u8* data, u64 size, int flags)
+{
+  FILE* out_fp = NULL;
+
+  if (flags & e_fileio_exclusive)
+  {
+    fileio_abort_if_exists(path);
+  }
+
+  out_fp = fileio_fopen(path, "wb");
+  if (size)
+  {
+    fileio_fwrite(data, 1, (size_t)size, out_fp);
+  }
+  fileio_fclose(out_fp);
+}
+#endif
+
+#endif /* FILEIO_H */
@@ -0,0 +1,354 @@
+/* SPDX-License-Identifier: MIT */
+/**
+ * @file   filelist.h
+ * @author Marc-Alexandre Espiaut <ma.dev@espiaut.fr>
+ * @date   2026-03-11
+ * @brief  Lists of input paths gathered from arguments and list files.
+ *
+ * @copyright Copyright (c) 2026 Marc-Alexandre Espiaut
+ */
+
+#ifndef FILELIST_H
+#define FILELIST_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <dirent.h>
+#endif
+
+/* The Windows CRT only has the S_IF* masks. */
+#if !defined(S_ISREG)
+#define S_ISREG(m) (((m) & S_IFMT) == S_IFREG)
+#endif
+#if !defined(S_ISDIR)
+#define S_ISDIR(m) (((m) & S_IFMT) == S_IFDIR)
+#endif
+
+#include "errorcodes.h"
+#include "types.h"
+
+typedef struct FileList FileList;
+struct FileList
+{
+  char** path;
+  usize count;
+  usize capacity;
+  char** storage; /* buffers read from list files, owned by the list */
+  usize storage_count;
+};
+
+static INLINE void
+filelist_add(FileList* list, char* path)
+{
+  if (list->count == list->capacity)
+  {
+    usize capacity = list->capacity ? list->capacity * 2 : 64;
+    char** grown = realloc(list->path, sizeof(*grown) * capacity);
+
+    if (!grown)
+    {
+      perror("realloc");
+      exit(e_error_malloc);
+    }
+
+    list->path = grown;
+    list->capacity = capacity;
+  }
+
+  list->path[list->count++] = path;
+}
+
+/* Where an argument given as NAME=PATH splits, or NULL for a plain path.
+ * NAME must be 1 to name_max characters without a path separator, and an
+ * existing file named like the whole argument stays a path: "a=b.voc" on
+ * disk is never read as b.voc stored as A. */
+static INLINE const char*
+filelist_name_split(const char* arg, usize name_max)
+{
+  const char* eq = strchr(arg, '=');
+  struct stat st;
+  usize len = 0;
+
+  if (!eq)
+  {
+    return NULL;
+  }
+
+  len = (usize)(eq - arg);
+  if (!len || len > name_max || strcspn(arg, "/\\") < len || stat(arg, &st) == 0)
+  {
+    return NULL;
+  }
+
+  return eq;
+}
+
+/* A copy of path, to be freed, with the extension of its last component
+ * replaced by ext, or ext appended when it has none. A leading dot, as in
+ * ".hidden", is not an extension. */
+static INLINE char*
+path_extension_replace(const char* path, const char* ext)
+{
+  const char* base = path;
+  const char* dot = NULL;
+  const char* c = path;
+  usize ext_len = strlen(ext);
+  char* out = NULL;
+  usize len = 0;
+
+  for (; *c; ++c)
+  {
+    if (*c == '/' || *c == '\\')
+    {
+      base = c + 1;
+    }
+  }
+  dot = strrchr(base, '.');
+  len = dot && dot != base ? (usize)(dot - path) : strlen(path);
+
+  out = malloc(len + ext_len + 1);
+  if (!out)
+  {
+    perror("malloc");
+    exit(e_error_malloc);
+  }
+  memcpy(out, path, len);
+  memcpy(out + len, ext, ext_len + 1);
+
+  return out;
+}
+
+/* Hands a buffer holding paths over to the list. */
+static INLINE void
+filelist_storage_add(FileList* list, char* data)
+{
+  char** grown = realloc(list->storage, sizeof(*grown) * (list->storage_count + 1));
+
+  if (!grown)
+  {
+    perror("realloc");
+    exit(e_error_malloc);
+  }
+
+  list->storage = grown;
+  list->storage[list->storage_count++] = data;
+}
+
+/* Adds every path of a list file, "-" being stdin. Entries are separated
+ * by newlines or NUL bytes (as written by find -print0); carriage returns
+ * are dropped and empty entries are skipped. */
+static INLINE void
+filelist_load(FileList* list, const char* list_path)
+{
+  FILE* fp = NULL;
+  char* data = NULL;
+  usize size = 0;
+  usize capacity = 0;
+  usize start = 0;
+  usize i = 0;
+
+  fp = strcmp(list_path, "-") ? fopen(list_path, "rb") : stdin;
+  if (!fp)
+  {
+    perror("fopen");
+    exit(e_error_fopen);
+  }
+
+  /* The list may come from a pipe, so it is read in growing chunks. */
+  for (;;)
+  {
+    usize n = 0;
+
+    if (capacity - size < 4096)
+    {
+      char* grown = NULL;
+
+      capacity = capacity ? capacity * 2 : 65536;
+      grown = realloc(data, capacity + 1);
+      if (!grown)
+      {
+        perror("realloc");
+        exit(e_error_malloc);
+      }
+      data = grown;
+    }
+
+    n = fread(data + size, 1, capacity - size, fp);
+    size += n;
+    if (!n)
+    {
+      break;
+    }
+  }
+
+  if (ferror(fp))
+  {
+    perror("fread");
+    exit(e_error_fread);
+  }
+
+  if (fp != stdin && fclose(fp) == EOF)
+  {
+    perror("fclose");
+    exit(e_error_fclose);
+  }
+
+  data[size] = '\0';
+
+  for (; i <= size; ++i)
+  {
+    if (data[i] == '\n' || data[i] == '\0')
+    {
+      usize end = i;
+
+      while (end > start && data[end - 1] == '\r')
+      {
+        --end;
+      }
+      data[end] = '\0';
+
+      if (end > start)
+      {
+        filelist_add(list, data + start);
+      }
+      start = i + 1;
+    }
+  }
+
+  filelist_storage_add(list, data);
+}
+
+static INLINE int
+filelist_path_compare(const void* a, const void* b)
+{
+  return strcmp(*(char* const*)a, *(char* const*)b);
+}
+
+/* Adds the regular files directly inside dir, sorted by name so runs over
+ * the same directory see the same order. Subdirectories are not entered. */
+static INLINE void
+filelist_load_dir(FileList* list, const char* dir)
+{
+  usize dir_len = strlen(dir);
+  usize first = list->count;
+  char* data = NULL;
+  usize size = 0;
+  usize capacity = 0;
+  usize i = 0;
+#if defined(_WIN32)
+  WIN32_FIND_DATAA entry;
+  HANDLE find = INVALID_HANDLE_VALUE;
+  char* pattern = malloc(dir_len + sizeof("/*"));
+
+  if (!pattern)
+  {
+    perror("malloc");
+    exit(e_error_malloc);
+  }
+  sprintf(pattern, "%s/*", dir);
+  find = FindFirstFileA(pattern, &entry);
+  free(pattern);
+  if (find == INVALID_HANDLE_VALUE)
+  {
+    fprintf(stderr, "ERROR: Cannot read directory %s!\n", dir);
+    exit(e_error_fopen);
+  }
+#else
+  struct dirent* entry = NULL;
+  DIR* d = opendir(dir);
+
+  if (!d)
+  {
+    perror("opendir");
+    exit(e_error_fopen);
+  }
+#endif
+
+  /* Paths are appended to one buffer, and only listed once it stops
+   * moving. */
+  for (;;)
+  {
+    const char* name = NULL;
+    usize name_len = 0;
+    struct stat st;
+
+#if defined(_WIN32)
+    name = entry.cFileName;
+#else
+    entry = readdir(d);
+    if (!entry)
+    {
+      break;
+    }
+    name = entry->d_name;
+#endif
+
+    name_len = strlen(name);
+    if (size + dir_len + name_len + 2 > capacity)
+    {
+      char* grown = NULL;
+
+      capacity = (capacity ? capacity * 2 : 65536) + dir_len + name_len + 2;
+      grown = realloc(data, capacity);
+      if (!grown)
+      {
+        perror("realloc");
+        exit(e_error_malloc);
+      }
+      data = grown;
+    }
+
+    memcpy(data + size, dir, dir_len);
+    data[size + dir_len] = '/';
+    memcpy(data + size + dir_len + 1, name, name_len + 1);
+    if (stat(data + size, &st) == 0 && S_ISREG(st.st_mode))
+    {
+      size += dir_len + name_len + 2;
+    }
+
+#if defined(_WIN32)
+    if (!FindNextFileA(find, &entry))
+    {
+      break;
+    }
+#endif
+  }
+
+#if defined(_WIN32)
+  FindClose(find);
+#else
+  closedir(d);
+#endif
+
+  for (; i < size; i += strlen(data + i) + 1)
+  {
+    filelist_add(list, data + i);
+  }
+  qsort(list->path + first, list->count - first, sizeof(*list->path), filelist_path_compare);
+
+  filelist_storage_add(list, data);
+}
+
+static INLINE void
+filelist_free(FileList* list)
+{
+  usize i = 0;
+
+  for (; i < list->storage_count; ++i)
+  {
+    free(list->storage[i]);
+  }
+
+  free(list->storage);
+  free(list->path);
+  memset(list, 0, sizeof(*list));
+}
+
+#endif /* FILELIST_H */
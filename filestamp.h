@@ -0,0 +1,108 @@
+/* SPDX-License-Identifier: MIT */
+/**
+ * @file   filestamp.h
+ * @author Marc-Alexandre Espiaut <ma.dev@espiaut.fr>
+ * @date   2026-03-21
+ * @brief  What the caches take a file to be, and whether it changed.
+ *
+ * A stamp is the size, inode, mtime and ctime of a file, to the
+ * nanosecond where the system keeps them. Restoring an mtime, as tar or
+ * an editor may, still moves the ctime; a file replaced by another one of
+ * the same size and dates usually has another inode. Files modified in
+ * the last seconds get no stamp at all: on filesystems with coarse times,
+ * a second edit within the same tick would look unchanged.
+ *
+ * Caches key their records on the canonical path, so a file reached
+ * through another working directory or a symbolic link is the same file,
+ * and two trees holding the same relative paths are not.
+ *
+ * realpath() needs _XOPEN_SOURCE or _GNU_SOURCE on Linux, so a tool using
+ * a cache defines one before its first include.
+ *
+ * @copyright Copyright (c) 2026 Marc-Alexandre Espiaut
+ */
+
+#ifndef FILESTAMP_H
+#define FILESTAMP_H
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+
+/* The Windows CRT only has the S_IF* masks. */
+#if !defined(S_ISREG)
+#define S_ISREG(m) (((m) & S_IFMT) == S_IFREG)
+#endif
+
+#include "types.h"
+
+/* Nanoseconds of a struct stat time, where the system has them. */
+#if defined(__APPLE__)
+#define FILESTAMP_NSEC(st, t) ((i64)(st).st_##t##timespec.tv_nsec)
+#elif defined(__unix__)
+#define FILESTAMP_NSEC(st, t) ((i64)(st).st_##t##tim.tv_nsec)
+#else
+#define FILESTAMP_NSEC(st, t) ((i64)0)
+#endif
+
+enum
+{
+  e_filestamp_settle = 2 /* seconds, the FAT time granularity */
+};
+
+typedef struct FileStamp FileStamp;
+struct FileStamp
+{
+  u64 size;
+  u64 inode;
+  i64 mtime;
+  i64 mtime_nsec;
+  i64 ctime;
+  i64 ctime_nsec;
+};
+
+/* Stamps the file at path. Returns 0 for anything but a settled regular
+ * file: those are never cached. */
+static INLINE int
+filestamp_get(const char* path, FileStamp* stamp)
+{
+  struct stat st;
+
+  memset(stamp, 0, sizeof(*stamp));
+
+  if (stat(path, &st) == -1 || !S_ISREG(st.st_mode) || (i64)st.st_mtime + e_filestamp_settle > (i64)time(NULL))
+  {
+    return 0;
+  }
+
+  stamp->size = (u64)st.st_size;
+  stamp->inode = (u64)st.st_ino;
+  stamp->mtime = (i64)st.st_mtime;
+  stamp->mtime_nsec = FILESTAMP_NSEC(st, m);
+  stamp->ctime = (i64)st.st_ctime;
+  stamp->ctime_nsec = FILESTAMP_NSEC(st, c);
+  return 1;
+}
+
+static INLINE int
+filestamp_equal(const FileStamp* a, const FileStamp* b)
+{
+  return a->size == b->size && a->inode == b->inode &&
+         a->mtime == b->mtime && a->mtime_nsec == b->mtime_nsec &&
+         a->ctime == b->ctime && a->ctime_nsec == b->ctime_nsec;
+}
+
+/* The absolute path of path with every link resolved, to be freed, or
+ * NULL when it can't be resolved. */
+static INLINE char*
+filestamp_canonical(const char* path)
+{
+#if defined(_WIN32)
+  return _fullpath(NULL, path, 0);
+#else
+  return realpath(path, NULL);
+#endif
+}
+
+#endif /* FILESTAMP_H */
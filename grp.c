@@ -3,21 +3,40 @@
  * @file   grp.c
  * @author Marc-Alexandre Espiaut <ma.dev@espiaut.fr>
  * @date   2026-01-30
- * @version 1.1
+ * @version 1.2
  * @brief  Creates a GRP file from a list of files.
  *
  * @copyright Copyright (c) 2026 Marc-Alexandre Espiaut
  */
 
+#if defined(__linux__)
+#define _GNU_SOURCE /* copy_file_range(), splice() for fileio.h */
+#endif
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <unistd.h>
+#define GRP_FSYNC
+#endif
+
+#include "contentcache.h"
+#include "fileio.h"
+#include "filelist.h"
+#include "grpreader.h"
+#include "grpwriter.h"
+#include "stats.h"
+#include "types.h"
 
-#define GRP_VERSION "1.1"
+#define GRP_VERSION "1.2"
 
 enum
 {
-  grp_name_len = 12
+  grp_name_len = 12,
+  grp_entry_len = 16
 };
 
 typedef struct
@@ -25,202 +44,215 @@ typedef struct
   char s[grp_name_len];
 } str12;
 
-enum
-{
-  error_fclose = 2,
-  error_fopen,
-  error_fseek,
-  error_ftell,
-  error_fwrite,
-  error_name_upper
-};
-
-static long
-safe_ftell(FILE* stream)
+static void
+name_upper(str12* name)
 {
-  long result = 0;
+  size_t i;
 
-  if (!stream)
+  if (!name)
   {
-    exit(error_ftell);
+    exit(e_error_name_upper);
   }
 
-  result = ftell(stream);
-  if (result == -1)
-  {
-    perror("ftell");
-    exit(error_ftell);
-  }
-  else
+  for (i = 0; i < grp_name_len && name->s[i] != '\0'; ++i)
   {
-    return result;
+    if (name->s[i] >= 'a' && name->s[i] <= 'z')
+    {
+      name->s[i] = (char)(name->s[i] - ('a' - 'A'));
+    }
   }
 }
 
-static int
-safe_fseek(FILE* stream, long offset, int whence)
+/* An input is either a path, stored under its own name, or NAME=PATH.
+ * The latter is the only way to name a member read from stdin ("-"). */
+static void
+member_parse(GrpMember* member, const char* arg)
 {
-  int result = 0;
-
-  if (!stream)
-  {
-    exit(error_fseek);
-  }
-
-  result = fseek(stream, offset, whence);
-  if (result == -1)
-  {
-    perror("fseek");
-    exit(error_fseek);
-  }
-  else
-  {
-    return result;
-  }
+  const char* eq = filelist_name_split(arg, grp_name_len);
+  str12 name = {0};
+
+  strncpy(name.s, arg, eq ? (size_t)(eq - arg) : grp_name_len);
+  name_upper(&name);
+  memcpy(member->name, name.s, grp_name_len);
+  member->path = eq ? eq + 1 : arg;
+  member->old = -1;
 }
 
 static void
-safe_fclose(FILE* stream)
+grp_write(const char* out, const char* in[], size_t n, ContentCache* cache, Stats* stats)
 {
-  if (!stream)
-  {
-    exit(error_fclose);
-  }
+  size_t i;
+  FILE* out_fp = NULL;
+  GrpMember* member = NULL;
 
-  if (fclose(stream) == EOF)
-  {
-    perror("fclose");
-    exit(error_fclose);
-  }
-}
+  fprintf(stdout, "Checking in %s already exists.\n", out);
+  fileio_abort_if_exists(out);
 
-static void
-safe_fwrite(const void* ptr, size_t size, size_t n, FILE* stream)
-{
-  if (!ptr || !stream)
+  member = calloc(n ? n : 1, sizeof(*member));
+  if (!member)
   {
-    exit(error_fwrite);
+    perror("calloc");
+    exit(e_error_malloc);
   }
+  stats_alloc(stats, 1);
 
-  if (fwrite(ptr, size, n, stream) != n)
+  for (i = 0; i < n; ++i)
   {
-    perror("fwrite");
-    safe_fclose(stream);
-    exit(error_fwrite);
+    member_parse(&member[i], in[i]);
   }
+
+  fprintf(stdout, "Creating %s.\n", out);
+  out_fp = fileio_fopen(out, "wb+");
+  grpwriter_stream(out_fp, member, n, NULL, NULL, cache, stats, stdout);
+
+  free(member);
+  fileio_fclose(out_fp);
+  return;
 }
 
-static FILE*
-safe_fopen(const char* path, const char* mode)
+/* An input replacing a member of the same size is compared byte for byte
+ * against the mapped member: touching a file or checking it out again must
+ * not cost a rewrite of its payload. mtimes can't decide it: an older
+ * version restored with its date, an edit within the second of the last
+ * update or an interrupted update would all keep stale bytes. */
+static int
+member_is_unchanged(GrpReader* old, u32 i, const char* path)
 {
-  FILE* fp = NULL;
+  struct stat st;
+  MemoryStream ms = {0};
+  int unchanged = 0;
 
-  if (!path || !mode)
+  if (stat(path, &st) == -1)
   {
-    exit(error_fopen);
+    perror("stat");
+    exit(e_error_fopen);
   }
 
-  fp = fopen(path, mode);
-  if (!fp)
+  if ((u64)st.st_size != old->entry[i].size)
   {
-    perror("fopen");
-    exit(error_fopen);
+    return 0;
   }
-  return fp;
-}
 
-static void
-abort_if_exists(const char* path)
-{
-  FILE* fp = fopen(path, "rb");
-  if (fp)
-  {
-    safe_fclose(fp);
-    fprintf(stderr, "ERROR: %s already exists! Quitting!\n", path);
-    exit(EXIT_FAILURE);
-  }
+  memorystream_init(&ms, (char*)path);
+  unchanged = ms.size == (i64)old->entry[i].size && (!ms.size || !memcmp(ms.data, grpreader_data(old, i), (size_t)ms.size));
+  memorystream_free(&ms);
+
+  return unchanged;
 }
 
+/* Rewrites an existing archive with the inputs replacing the members of
+ * the same name, or appended after them, like ar r. The result goes to a
+ * temporary file renamed over the archive, so readers never see a torn
+ * directory. */
 static void
-name_upper(str12* name)
+grp_update(const char* out, const char* in[], size_t n, ContentCache* cache, Stats* stats)
 {
+  GrpReader old = {0};
+  FILE* old_fp = NULL;
+  FILE* out_fp = NULL;
+  GrpMember* member = NULL;
+  char* tmp = NULL;
+  size_t count = 0;
   size_t i;
+  u64 begin = 0;
+  struct stat st;
 
-  if (!name)
+  old_fp = fopen(out, "rb");
+  if (!old_fp)
   {
-    exit(error_name_upper);
+    grp_write(out, in, n, cache, stats);
+    return;
   }
 
-  for (i = 0; i < grp_name_len && name->s[i] != '\0'; ++i)
+  if (fstat(fileno(old_fp), &st) == -1)
   {
-    if (name->s[i] >= 'a' && name->s[i] <= 'z')
-    {
-      name->s[i] = (char)(name->s[i] - ('a' - 'A'));
-    }
+    perror("fstat");
+    exit(e_error_fopen);
   }
-}
-
-static void
-grp_write(const char* out, const char* in[], size_t n)
-{
-  size_t i;
-  FILE* out_fp = NULL;
-
-  fprintf(stdout, "Checking in %s already exists.\n", out);
-  abort_if_exists(out);
 
-  fprintf(stdout, "Creating %s.\n", out);
-  out_fp = safe_fopen(out, "wb+");
+  fprintf(stdout, "Updating %s.\n", out);
+  begin = stats_begin(stats);
+  grpreader_open(&old, (char*)out);
+  stats_end(stats, e_stats_open, begin);
+  stats_io(stats, 0, 0, old.ms.syscalls);
+  /* The kept members are copied in archive order. */
+  fileio_map_advise(&old.ms, 0, old.ms.size, e_fileio_sequential);
+
+  member = calloc(old.count + n ? old.count + n : 1, sizeof(*member));
+  tmp = malloc(strlen(out) + sizeof(".tmp"));
+  if (!member || !tmp)
+  {
+    perror("malloc");
+    exit(e_error_malloc);
+  }
+  stats_alloc(stats, 2);
 
-  safe_fwrite("KenSilverman", 1, grp_name_len, out_fp);
-  safe_fwrite(&n, 1, 4, out_fp);
+  for (; count < old.count; ++count)
+  {
+    memcpy(member[count].name, old.ms.data + (count + 1) * grp_entry_len, grp_name_len);
+    member[count].old = (i64)count;
+  }
 
   for (i = 0; i < n; ++i)
   {
-    FILE* in_fp = safe_fopen(in[i], "rb");
-    fprintf(stdout, "Adding %s to list.\n", in[i]);
+    char name[grp_name_len + 1] = {0};
+    i64 found = -1;
 
-    {
-      str12 name = {0};
+    member_parse(&member[count], in[i]);
+    memcpy(name, member[count].name, grp_name_len);
+    found = grpreader_find(&old, name);
 
-      strncpy(name.s, in[i], grp_name_len);
-      name_upper(&name);
-      safe_fwrite(name.s, 1, grp_name_len, out_fp);
-      fprintf(stdout, "File name %s", name.s);
+    if (found < 0)
+    {
+      ++count;
     }
-
+    else if (!grpwriter_is_stream(member[count].path) && member_is_unchanged(&old, (u32)found, member[count].path))
     {
-      long in_size = 0L;
-      safe_fseek(in_fp, 0, SEEK_END);
-      in_size = safe_ftell(in_fp);
-      safe_fseek(in_fp, 0, SEEK_SET);
-      safe_fwrite(&in_size, 1, 4, out_fp);
-      fprintf(stdout, " of size %ld.\n", in_size);
+      member[found].path = NULL;
+      fprintf(stdout, "%s is unchanged.\n", member[count].path);
     }
-
-    safe_fclose(in_fp);
-  }
-
-  for (i = 0; i < n; ++i)
-  {
-    FILE* in_fp = safe_fopen(in[i], "rb");
-
-    fprintf(stdout, "Adding %s\n", in[i]);
+    else
     {
-      size_t j = 0;
-      char buf[8192] = {0};
-
-      while ((j = fread(buf, 1, sizeof(buf), in_fp)) > 0)
-      {
-        safe_fwrite(buf, 1, j, out_fp);
-      }
+      member[found].path = member[count].path;
     }
-
-    safe_fclose(in_fp);
   }
 
-  safe_fclose(out_fp);
-  return;
+  /* A leftover temporary file may be someone else's: never clobber it. */
+  sprintf(tmp, "%s.tmp", out);
+  fileio_abort_if_exists(tmp);
+  out_fp = fileio_fopen(tmp, "wb+");
+  grpwriter_stream(out_fp, member, count, &old, old_fp, cache, stats, stdout);
+
+  begin = stats_begin(stats);
+  if (fflush(out_fp) == EOF)
+  {
+    perror("fflush");
+    exit(e_error_fwrite);
+  }
+#if defined(GRP_FSYNC)
+  /* The archive keeps its permissions across the rename. */
+  if (fchmod(fileno(out_fp), st.st_mode & 07777) == -1)
+  {
+    perror("fchmod");
+    exit(e_error_fwrite);
+  }
+  if (fsync(fileno(out_fp)) == -1)
+  {
+    perror("fsync");
+    exit(e_error_fwrite);
+  }
+#endif
+  fileio_fclose(out_fp);
+
+  /* Windows cannot replace a file that is still open or mapped. */
+  grpreader_close(&old);
+  fileio_fclose(old_fp);
+  fileio_replace(tmp, out);
+  stats_end(stats, e_stats_commit, begin);
+  stats_io(stats, 0, 0, 6);
+
+  free(tmp);
+  free(member);
 }
 
 static void
@@ -230,36 +262,123 @@ usage(const char* prgname, const char* prgver)
   fprintf(stderr, "\n");
   fprintf(stderr, "%s is a tool for making group (.grp) files for Build engine games.\n", prgname);
   fprintf(stderr, "\n");
-  fprintf(stderr, "Usage: %s [options] [files]\n", prgname);
+  fprintf(stderr, "Usage: %s [options] output.grp [files]\n", prgname);
   fprintf(stderr, "\n");
   fprintf(stderr, "Process input files and creates a GRP output file.\n");
+  fprintf(stderr, "A file given as NAME=PATH is stored as NAME; a PATH of - reads stdin.\n");
+  fprintf(stderr, "NAME is 1 to 12 characters; an existing file whose name has a = is\n");
+  fprintf(stderr, "added under its own name.\n");
   fprintf(stderr, "\n");
 
   fprintf(stderr, "Options:\n");
   fprintf(stderr, "  -h, --help             Show this help message and exit\n");
+  fprintf(stderr, "  -l, --list LIST.TXT    Add files as listed in LIST.TXT (- for stdin)\n");
+  fprintf(stderr, "  -u, --update           Replace or append files in an existing output\n");
+  fprintf(stderr, "  -c, --cache DIR        Reuse unchanged files from the cache in DIR\n");
+  fprintf(stderr, "  --stats                Print timings and I/O counters to stderr as JSON\n");
   /*
     fprintf(stderr, "  -v, --verbose          Enable verbose output\n");
     fprintf(stderr, "  -g, --group            Group files by extensions\n");
-    fprintf(stderr, "  -l, --list LIST.TXT    Add files as listed in LIST.TXT\n");
     fprintf(stderr, "  -o, --output FILE.GRP  Write output to FILE\n");
-    fprintf(stderr, "\n");
   */
+  fprintf(stderr, "\n");
   fprintf(stderr, "Examples:\n");
   fprintf(stderr, "  %s output.grp input.map input.dmo input.art\n", prgname);
+  fprintf(stderr, "  %s output.grp -l list.txt\n", prgname);
+  fprintf(stderr, "  %s -u output.grp input.map\n", prgname);
+  fprintf(stderr, "  %s -c cache output.grp -l list.txt\n", prgname);
+  fprintf(stderr, "  cat input.map | %s output.grp E1L1.MAP=-\n", prgname);
   exit(EXIT_FAILURE);
 }
 
 int
 main(int argc, char* argv[])
 {
+  FileList files = {0};
+  ContentCache cache = {0};
+  Stats stats = {0};
+  int stats_enabled = 0;
+  const char* cache_dir = NULL;
+  const char* out = NULL;
+  int update = 0;
+  int i;
+
   if (argc < 3)
   {
     usage(argv[0], GRP_VERSION);
   }
+
+  for (i = 1; i < argc; ++i)
+  {
+    if (!strcmp(argv[i], "-h") || !strcmp(argv[i], "--help"))
+    {
+      usage(argv[0], GRP_VERSION);
+    }
+    else if (!strcmp(argv[i], "-l") || !strcmp(argv[i], "--list"))
+    {
+      if (++i == argc)
+      {
+        usage(argv[0], GRP_VERSION);
+      }
+      filelist_load(&files, argv[i]);
+    }
+    else if (!strcmp(argv[i], "-u") || !strcmp(argv[i], "--update"))
+    {
+      update = 1;
+    }
+    else if (!strcmp(argv[i], "-c") || !strcmp(argv[i], "--cache"))
+    {
+      if (++i == argc)
+      {
+        usage(argv[0], GRP_VERSION);
+      }
+      cache_dir = argv[i];
+    }
+    else if (!strcmp(argv[i], "--stats"))
+    {
+      stats_enabled = 1;
+    }
+    else if (!out)
+    {
+      out = argv[i];
+    }
+    else
+    {
+      filelist_add(&files, argv[i]);
+    }
+  }
+
+  if (!out || !files.count)
+  {
+    usage(argv[0], GRP_VERSION);
+  }
+
+  stats_init(&stats);
+
+  if (cache_dir)
+  {
+    contentcache_open(&cache, cache_dir);
+  }
+
+  if (update)
+  {
+    grp_update(out, (const char**)files.path, files.count, cache_dir ? &cache : NULL, stats_enabled ? &stats : NULL);
+  }
   else
   {
-    grp_write(argv[1], (const char**)(argv + 2), (size_t)(argc - 2));
+    grp_write(out, (const char**)files.path, files.count, cache_dir ? &cache : NULL, stats_enabled ? &stats : NULL);
+  }
+
+  if (cache_dir)
+  {
+    contentcache_close(&cache);
+  }
+
+  if (stats_enabled)
+  {
+    stats_print(&stats, "grp", stderr);
   }
+  filelist_free(&files);
 
   return EXIT_SUCCESS;
 }
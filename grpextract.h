@@ -0,0 +1,187 @@
+/* SPDX-License-Identifier: MIT */
+/**
+ * @file   grpextract.h
+ * @author Marc-Alexandre Espiaut <ma.dev@espiaut.fr>
+ * @date   2026-03-12
+ * @brief  Extracts the members of a mapped archive, optionally in parallel.
+ *
+ * The caller describes each member by its offset in the mapping, its size
+ * and its name, so GRP members and RTS lumps go through the same code.
+ * Every member is written with fileio_file_write() straight from the
+ * mapping. ungrp and unrts extract into the current directory; bench
+ * extracts into a scratch directory and records how long each member took.
+ *
+ * @copyright Copyright (c) 2026 Marc-Alexandre Espiaut
+ */
+
+#ifndef GRPEXTRACT_H
+#define GRPEXTRACT_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "errorcodes.h"
+#include "fileio.h"
+#include "thread.h"
+#include "timing.h"
+#include "types.h"
+
+/* Extraction is bound by per-file syscall latency, not bandwidth, so the
+ * members are handed out to workers in small chunks to overlap it. */
+enum
+{
+  e_grpextract_chunk = 16
+};
+
+typedef struct GrpExtractEntry GrpExtractEntry;
+struct GrpExtractEntry
+{
+  const char* name;
+  u64 size;
+  i64 offset; /* from the start of the mapping */
+};
+
+typedef struct GrpExtract GrpExtract;
+struct GrpExtract
+{
+  const u8* data;
+  const GrpExtractEntry* entry;
+  usize count;
+  usize next;
+  int flags;
+  const char* dir;    /* prefixed to the member names, NULL for none */
+  const char* suffix; /* appended to the member names */
+  FILE* log;          /* progress messages, NULL for none */
+  u64* latency;       /* nanoseconds per member, in entry order, or NULL */
+  Mutex lock;
+};
+
+/* Member names come from the archive: never let one escape the output
+ * directory. */
+static INLINE int
+grpextract_is_safe_name(const char* name)
+{
+  return name[0] != '\0' && strcmp(name, ".") && strcmp(name, "..") && !strpbrk(name, "/\\:");
+}
+
+static INLINE void
+grpextract_one(const GrpExtract* extract, usize j)
+{
+  const GrpExtractEntry* entry = &extract->entry[j];
+  const char* dir = extract->dir ? extract->dir : "";
+  char path[FILENAME_MAX];
+  u64 t0 = 0;
+
+  if (!grpextract_is_safe_name(entry->name))
+  {
+    fprintf(stderr, "WARN: Skipping member with unsafe name \"%s\"\n", entry->name);
+    return;
+  }
+
+  if (strlen(dir) + 1 + strlen(entry->name) + strlen(extract->suffix) + 1 > sizeof(path))
+  {
+    fprintf(stderr, "WARN: Skipping %s, the path would be too long\n", entry->name);
+    return;
+  }
+
+  sprintf(path, "%s%s%s%s", dir, extract->dir ? "/" : "", entry->name, extract->suffix);
+
+  if (extract->log)
+  {
+    fprintf(extract->log, "Extracting %s (%lu bytes).\n", path + (extract->dir ? strlen(dir) + 1 : 0), (unsigned long)entry->size);
+  }
+
+  t0 = extract->latency ? timing_now() : 0;
+  fileio_file_write(path, extract->data + entry->offset, entry->size, extract->flags);
+  if (extract->latency)
+  {
+    extract->latency[j] = timing_now() - t0;
+  }
+}
+
+static INLINE void
+grpextract_worker(void* arg)
+{
+  GrpExtract* extract = arg;
+
+  for (;;)
+  {
+    usize first = 0;
+    usize last = 0;
+
+    mutex_lock(&extract->lock);
+    first = extract->next;
+    last = first + e_grpextract_chunk < extract->count ? first + e_grpextract_chunk : extract->count;
+    extract->next = last;
+    mutex_unlock(&extract->lock);
+
+    if (first == last)
+    {
+      break;
+    }
+
+    for (; first < last; ++first)
+    {
+      grpextract_one(extract, first);
+    }
+  }
+}
+
+/* Extracts the n entries, whose offsets are from data, with up to jobs
+ * threads, each to its name followed by suffix. dir, suffix, log and
+ * latency may be NULL; latency, when given, holds n entries. */
+static INLINE void
+grpextract_members(const u8* data, const GrpExtractEntry* entry, usize n, u32 jobs, int flags, const char* dir, const char* suffix, FILE* log, u64* latency)
+{
+  GrpExtract extract = {0};
+  Thread* thread = NULL;
+  u32 i = 0;
+
+  extract.data = data;
+  extract.entry = entry;
+  extract.count = n;
+  extract.flags = flags;
+  extract.dir = dir;
+  extract.suffix = suffix ? suffix : "";
+  extract.log = log;
+  extract.latency = latency;
+
+  if (jobs > (n + e_grpextract_chunk - 1) / e_grpextract_chunk)
+  {
+    jobs = (u32)((n + e_grpextract_chunk - 1) / e_grpextract_chunk);
+  }
+
+  if (jobs <= 1)
+  {
+    usize j = 0;
+    for (; j < n; ++j)
+    {
+      grpextract_one(&extract, j);
+    }
+    return;
+  }
+
+  thread = calloc(jobs, sizeof(*thread));
+  if (!thread)
+  {
+    perror("calloc");
+    exit(e_error_malloc);
+  }
+
+  mutex_init(&extract.lock);
+
+  for (; i < jobs; ++i)
+  {
+    thread_create(&thread[i], grpextract_worker, &extract);
+  }
+  for (i = 0; i < jobs; ++i)
+  {
+    thread_join(thread[i]);
+  }
+
+  mutex_destroy(&extract.lock);
+  free(thread);
+}
+
+#endif /* GRPEXTRACT_H */
@@ -0,0 +1,195 @@
+/* SPDX-License-Identifier: MIT */
+/**
+ * @file   grpreader.h
+ * @author Marc-Alexandre Espiaut <ma.dev@espiaut.fr>
+ * @date   2026-03-12
+ * @brief  Random access to the members of a GRP file.
+ *
+ * @copyright Copyright (c) 2026 Marc-Alexandre Espiaut
+ */
+
+#ifndef GRPREADER_H
+#define GRPREADER_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "errorcodes.h"
+#include "memorystream.h"
+#include "types.h"
+
+enum
+{
+  e_grp_name_len = 12,
+  e_grp_entry_len = 16
+};
+
+typedef struct GrpEntry GrpEntry;
+struct GrpEntry
+{
+  char name[e_grp_name_len + 1]; /* upper-cased, NUL-terminated */
+  u32 size;
+  i64 offset; /* from the start of the file */
+};
+
+typedef struct GrpReader GrpReader;
+struct GrpReader
+{
+  MemoryStream ms;
+  GrpEntry* entry;
+  u32 count;
+  u32* index; /* open addressing, entry index + 1, 0 when empty */
+  u32 index_mask;
+};
+
+/* Same folding as name_upper() in grp.c: only a-z change, and names are
+ * cut at 12 characters like the writer does. */
+static INLINE void
+grpreader_name_fold(char* dst, const char* src)
+{
+  usize i = 0;
+
+  for (; i < e_grp_name_len && src[i] != '\0'; ++i)
+  {
+    dst[i] = (src[i] >= 'a' && src[i] <= 'z') ? (char)(src[i] - ('a' - 'A')) : src[i];
+  }
+  dst[i] = '\0';
+}
+
+/* FNV-1a */
+static INLINE u32
+grpreader_name_hash(const char* name)
+{
+  u32 hash = 2166136261U;
+
+  for (; *name; ++name)
+  {
+    hash = (hash ^ (u8)*name) * 16777619U;
+  }
+
+  return hash;
+}
+
+static INLINE void
+grpreader_fail(GrpReader* grp, const char* path, const char* reason)
+{
+  fprintf(stderr, "ERROR: %s: %s!\n", path, reason);
+  memorystream_free(&grp->ms);
+  exit(e_error_format);
+}
+
+/* Maps the archive and indexes its directory; no payload byte is read. */
+static INLINE void
+grpreader_open(GrpReader* grp, char* path)
+{
+  const u8* header = NULL;
+  const u8* directory = NULL;
+  i64 offset = 0;
+  u32 capacity = 1;
+  u32 i = 0;
+
+  memset(grp, 0, sizeof(*grp));
+  memorystream_init(&grp->ms, path);
+
+  header = memorystream_view(&grp->ms, e_grp_entry_len);
+  if (!header || memcmp(header, "KenSilverman", e_grp_name_len))
+  {
+    grpreader_fail(grp, path, "not a GRP file");
+  }
+
+  grp->count = u32_le_get(header + e_grp_name_len);
+  directory = memorystream_view(&grp->ms, (i64)grp->count * e_grp_entry_len);
+  if (!directory)
+  {
+    grpreader_fail(grp, path, "truncated directory");
+  }
+
+  grp->entry = malloc(sizeof(*grp->entry) * (grp->count ? grp->count : 1));
+  while (capacity < grp->count * 2)
+  {
+    capacity *= 2;
+  }
+  grp->index = calloc(capacity, sizeof(*grp->index));
+  grp->index_mask = capacity - 1;
+  if (!grp->entry || !grp->index)
+  {
+    perror("malloc");
+    exit(e_error_malloc);
+  }
+
+  /* Payloads follow the directory in the same order, so the offsets are
+   * the prefix sums of the sizes. */
+  offset = grp->ms.position;
+  for (; i < grp->count; ++i)
+  {
+    const u8* src = directory + (usize)i * e_grp_entry_len;
+    GrpEntry* entry = &grp->entry[i];
+    char raw[e_grp_name_len + 1] = {0};
+    u32 slot = 0;
+
+    memcpy(raw, src, e_grp_name_len);
+    grpreader_name_fold(entry->name, raw);
+    entry->size = u32_le_get(src + e_grp_name_len);
+    entry->offset = offset;
+    offset += entry->size;
+
+    if (offset > grp->ms.size)
+    {
+      grpreader_fail(grp, path, "truncated member data");
+    }
+
+    /* On duplicate names the first member wins, as in the engine. */
+    slot = grpreader_name_hash(entry->name) & grp->index_mask;
+    while (grp->index[slot] && strcmp(grp->entry[grp->index[slot] - 1].name, entry->name))
+    {
+      slot = (slot + 1) & grp->index_mask;
+    }
+    if (!grp->index[slot])
+    {
+      grp->index[slot] = i + 1;
+    }
+  }
+}
+
+/* Index of the member called name (any case), or -1. */
+static INLINE i64
+grpreader_find(GrpReader* grp, const char* name)
+{
+  char folded[e_grp_name_len + 1] = {0};
+  u32 slot = 0;
+
+  grpreader_name_fold(folded, name);
+  slot = grpreader_name_hash(folded) & grp->index_mask;
+
+  while (grp->index[slot])
+  {
+    u32 i = grp->index[slot] - 1;
+
+    if (!strcmp(grp->entry[i].name, folded))
+    {
+      return i;
+    }
+    slot = (slot + 1) & grp->index_mask;
+  }
+
+  return -1;
+}
+
+/* Zero-copy view of a member's bytes, valid until grpreader_close(). */
+static INLINE const u8*
+grpreader_data(GrpReader* grp, u32 i)
+{
+  return grp->ms.data + grp->entry[i].offset;
+}
+
+static INLINE void
+grpreader_close(GrpReader* grp)
+{
+  memorystream_free(&grp->ms);
+  free(grp->entry);
+  free(grp->index);
+  memset(grp, 0, sizeof(*grp));
+}
+
+#endif /* GRPREADER_H */
@@ -0,0 +1,387 @@
+/* SPDX-License-Identifier: MIT */
+/**
+ * @file   grpwriter.h
+ * @author Marc-Alexandre Espiaut <ma.dev@espiaut.fr>
+ * @date   2026-01-30
+ * @brief  Streams members into a GRP file.
+ *
+ * The directory is built in memory while the payloads are streamed, then
+ * written over the zeroed placeholder once every size is known. This way
+ * each input is opened exactly once. Members kept from an old archive are
+ * copied from its mapping, or by the kernel where it can; with a cache,
+ * unchanged sources are copied from their blobs.
+ *
+ * grp drives a whole archive through grpwriter_stream(); bench times the
+ * members one by one with the same calls.
+ *
+ * @copyright Copyright (c) 2026 Marc-Alexandre Espiaut
+ */
+
+#ifndef GRPWRITER_H
+#define GRPWRITER_H
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#if defined(_WIN32)
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+#include "contentcache.h"
+#include "errorcodes.h"
+#include "fileio.h"
+#include "filelist.h"
+#include "grpreader.h"
+#include "hash.h"
+#include "memorystream.h"
+#include "stats.h"
+#include "types.h"
+
+typedef struct GrpMember GrpMember;
+struct GrpMember
+{
+  char name[e_grp_name_len];
+  const char* path; /* NULL: keep the payload of the old member */
+  i64 old;          /* index in the old archive, -1 for a new member */
+};
+
+typedef struct GrpMemberHash GrpMemberHash;
+struct GrpMemberHash
+{
+  u64 hash;
+  u64 size;
+  usize i;
+};
+
+typedef struct GrpWriter GrpWriter;
+struct GrpWriter
+{
+  FILE* fp;
+  const GrpMember* member;
+  usize count;
+  u8* directory;
+  GrpMemberHash* hash; /* with a cache, to report duplicates */
+  usize hashed;
+  GrpReader* old; /* the archive being updated, or NULL */
+  FILE* old_fp;
+  ContentCache* cache;
+  Stats* stats;
+  FILE* log; /* progress messages, NULL for none */
+};
+
+static INLINE void
+grpwriter_log(const GrpWriter* w, const char* format, ...)
+{
+  va_list args;
+
+  if (!w->log)
+  {
+    return;
+  }
+
+  va_start(args, format);
+  vfprintf(w->log, format, args);
+  va_end(args);
+}
+
+/* Pipes and stdin have no size nor mtime to go by: they are streamed as
+ * they come, never compared nor cached. */
+static INLINE int
+grpwriter_is_stream(const char* path)
+{
+  struct stat st;
+
+  if (!strcmp(path, "-"))
+  {
+    return 1;
+  }
+
+  if (stat(path, &st) == -1)
+  {
+    perror("stat");
+    exit(e_error_fopen);
+  }
+
+  return !S_ISREG(st.st_mode);
+}
+
+static INLINE FILE*
+grpwriter_source_open(const char* path)
+{
+  if (strcmp(path, "-"))
+  {
+    return fileio_fopen(path, "rb");
+  }
+
+#if defined(_WIN32)
+  _setmode(_fileno(stdin), _O_BINARY);
+#endif
+  return stdin;
+}
+
+/* Copies a member of the old archive as is. The kernel path can share the
+ * extents with the old file; the mapping covers everything else. */
+static INLINE u64
+grpwriter_copy_old(GrpWriter* w, u32 i)
+{
+  const GrpEntry* entry = &w->old->entry[i];
+  u64 done = 0;
+
+#if defined(FILEIO_KERNEL_COPY)
+  if (entry->size)
+  {
+    done = fileio_copy_kernel(w->old_fp, entry->offset, entry->size, w->fp, w->stats);
+  }
+#endif
+
+  if (done < entry->size)
+  {
+    fileio_fwrite(grpreader_data(w->old, i) + done, 1, (size_t)(entry->size - done), w->fp);
+  }
+
+  return entry->size;
+}
+
+/* Packs a source through the cache: a source with the stamp it had when
+ * it was stored is copied from its blob, anything else is read once
+ * through a mapping to be hashed, written out and, if it has a stamp and
+ * kept its size while being read, stored for the next build. */
+static INLINE u64
+grpwriter_copy_cached(GrpWriter* w, const char* path, u64* hash)
+{
+  CacheRecord key;
+  MemoryStream ms = {0};
+  FILE* blob = NULL;
+  int keyed = contentcache_key(path, &key);
+  u64 size = 0;
+  u64 begin = 0;
+
+  if (keyed && contentcache_find(w->cache, &key, hash) && (blob = contentcache_blob_open(w->cache, *hash, key.stamp.size)))
+  {
+    begin = stats_begin(w->stats);
+    size = fileio_copy(blob, w->fp, w->stats);
+    fileio_fclose(blob);
+    stats_end(w->stats, e_stats_copy, begin);
+    grpwriter_log(w, "Copied %s from the cache.\n", path);
+    free(key.path);
+    return size;
+  }
+
+  begin = stats_begin(w->stats);
+  memorystream_init(&ms, (char*)path);
+  fileio_map_advise(&ms, 0, ms.size, e_fileio_sequential);
+  stats_end(w->stats, e_stats_open, begin);
+  size = (u64)ms.size;
+  stats_alloc(w->stats, !ms.mapped && ms.size);
+
+  begin = stats_begin(w->stats);
+  *hash = hash_xxh64(ms.data, (usize)size, 0);
+  stats_end(w->stats, e_stats_hash, begin);
+
+  /* Timed apart from the hash, which is a phase of its own. */
+  begin = stats_begin(w->stats);
+  if (size)
+  {
+    fileio_fwrite(ms.data, 1, (size_t)size, w->fp);
+  }
+  if (keyed && size == key.stamp.size)
+  {
+    contentcache_store(w->cache, &key, *hash, ms.data);
+  }
+  memorystream_free(&ms);
+  stats_end(w->stats, e_stats_copy, begin);
+  stats_io(w->stats, 0, 0, ms.syscalls + 1);
+
+  free(key.path);
+  return size;
+}
+
+/* Writes the header and a zeroed directory for the n members, which must
+ * stay valid until grpwriter_end(). old and old_fp are the archive being
+ * updated, cache and stats may be NULL. */
+static INLINE void
+grpwriter_begin(GrpWriter* w, FILE* fp, const GrpMember* member, usize n, GrpReader* old, FILE* old_fp, ContentCache* cache, Stats* stats, FILE* log)
+{
+  u8 header[e_grp_entry_len] = {0};
+  u64 begin = stats_begin(stats);
+
+  memset(w, 0, sizeof(*w));
+  w->fp = fp;
+  w->member = member;
+  w->count = n;
+  w->old = old;
+  w->old_fp = old_fp;
+  w->cache = cache;
+  w->stats = stats;
+  w->log = log;
+
+  w->directory = calloc(n ? n : 1, e_grp_entry_len);
+  w->hash = cache ? calloc(n ? n : 1, sizeof(*w->hash)) : NULL;
+  if (!w->directory || (cache && !w->hash))
+  {
+    perror("calloc");
+    exit(e_error_malloc);
+  }
+  stats_alloc(stats, cache ? 2 : 1);
+
+  memcpy(header, "KenSilverman", e_grp_name_len);
+  u32_le_put(header + e_grp_name_len, (u32)n);
+  fileio_fwrite(header, 1, e_grp_entry_len, fp);
+  fileio_fwrite(w->directory, e_grp_entry_len, n, fp);
+  stats_end(stats, e_stats_directory, begin);
+  stats_io(stats, 0, e_grp_entry_len * (u64)(n + 1), 0);
+}
+
+/* Streams member i, in order, and returns its size. */
+static INLINE u64
+grpwriter_member(GrpWriter* w, usize i)
+{
+  const GrpMember* member = &w->member[i];
+  u8* entry = w->directory + i * e_grp_entry_len;
+  u64 in_size = 0;
+  u64 begin = 0;
+
+  memcpy(entry, member->name, e_grp_name_len);
+
+  if (!member->path)
+  {
+    grpwriter_log(w, "Keeping %.12s.\n", member->name);
+    begin = stats_begin(w->stats);
+    in_size = grpwriter_copy_old(w, (u32)member->old);
+    stats_end(w->stats, e_stats_copy, begin);
+
+    if (w->hash)
+    {
+      begin = stats_begin(w->stats);
+      w->hash[w->hashed].hash = hash_xxh64(grpreader_data(w->old, (u32)member->old), (usize)in_size, 0);
+      w->hash[w->hashed++].i = i;
+      stats_end(w->stats, e_stats_hash, begin);
+    }
+  }
+  else
+  {
+    grpwriter_log(w, "%s %s\n", member->old < 0 ? "Adding" : "Updating", member->path);
+
+    if (w->cache && !grpwriter_is_stream(member->path))
+    {
+      in_size = grpwriter_copy_cached(w, member->path, &w->hash[w->hashed].hash);
+      w->hash[w->hashed++].i = i;
+    }
+    else
+    {
+      FILE* in_fp = NULL;
+
+      begin = stats_begin(w->stats);
+      in_fp = grpwriter_source_open(member->path);
+      stats_end(w->stats, e_stats_open, begin);
+
+      begin = stats_begin(w->stats);
+      in_size = fileio_copy(in_fp, w->fp, w->stats);
+      stats_end(w->stats, e_stats_copy, begin);
+
+      if (in_fp != stdin)
+      {
+        fileio_fclose(in_fp);
+      }
+      stats_io(w->stats, 0, 0, in_fp != stdin ? 2 : 0);
+    }
+
+    if (in_size > 0xFFFFFFFFUL)
+    {
+      fprintf(stderr, "ERROR: %s is larger than 4 GiB! Quitting!\n", member->path);
+      exit(EXIT_FAILURE);
+    }
+    stats_io(w->stats, in_size, 0, 0);
+  }
+
+  u32_le_put(entry + e_grp_name_len, (u32)in_size);
+  grpwriter_log(w, "File name %.12s of size %lu.\n", (const char*)entry, (unsigned long)in_size);
+  /* Kept members are not read from a source, only copied over. */
+  stats_io(w->stats, 0, in_size, 0);
+
+  if (w->hashed && w->hash[w->hashed - 1].i == i)
+  {
+    w->hash[w->hashed - 1].size = in_size;
+  }
+
+  return in_size;
+}
+
+static INLINE int
+grpwriter_hash_compare(const void* a, const void* b)
+{
+  const GrpMemberHash* x = a;
+  const GrpMemberHash* y = b;
+
+  if (x->hash != y->hash)
+  {
+    return x->hash < y->hash ? -1 : 1;
+  }
+  return x->i < y->i ? -1 : x->i > y->i;
+}
+
+/* Members can't share a payload in a GRP, but packing the same file twice
+ * is usually a mistake in a build list, so it is worth a warning. Sorting
+ * the hashes finds every run of equal contents in one pass. */
+static INLINE void
+grpwriter_duplicates_report(GrpWriter* w)
+{
+  usize first = 0;
+  usize i = 1;
+
+  qsort(w->hash, w->hashed, sizeof(*w->hash), grpwriter_hash_compare);
+
+  for (; i < w->hashed; ++i)
+  {
+    if (w->hash[i].hash != w->hash[first].hash)
+    {
+      first = i;
+    }
+    else if (w->hash[i].size)
+    {
+      fprintf(stderr, "WARN: %.12s has the same contents as %.12s.\n", w->member[w->hash[i].i].name, w->member[w->hash[first].i].name);
+    }
+  }
+}
+
+/* Writes the directory over its placeholder. The stream is left open. */
+static INLINE void
+grpwriter_end(GrpWriter* w)
+{
+  u64 begin = stats_begin(w->stats);
+
+  fileio_fseek(w->fp, e_grp_entry_len, SEEK_SET);
+  fileio_fwrite(w->directory, e_grp_entry_len, w->count, w->fp);
+  stats_end(w->stats, e_stats_directory, begin);
+  stats_io(w->stats, 0, e_grp_entry_len * (u64)w->count, 1);
+
+  if (w->hash)
+  {
+    grpwriter_duplicates_report(w);
+  }
+
+  free(w->hash);
+  free(w->directory);
+  w->hash = NULL;
+  w->directory = NULL;
+}
+
+static INLINE void
+grpwriter_stream(FILE* fp, const GrpMember* member, usize n, GrpReader* old, FILE* old_fp, ContentCache* cache, Stats* stats, FILE* log)
+{
+  GrpWriter w;
+  usize i = 0;
+
+  grpwriter_begin(&w, fp, member, n, old, old_fp, cache, stats, log);
+  for (; i < n; ++i)
+  {
+    grpwriter_member(&w, i);
+  }
+  grpwriter_end(&w);
+}
+
+#endif /* GRPWRITER_H */
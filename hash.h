@@ -0,0 +1,170 @@
+/* SPDX-License-Identifier: MIT */
+/**
+ * @file   hash.h
+ * @author Marc-Alexandre Espiaut <ma.dev@espiaut.fr>
+ * @date   2026-03-16
+ * @brief  XXH64 content hash.
+ *
+ * @copyright Copyright (c) 2026 Marc-Alexandre Espiaut
+ */
+
+#ifndef HASH_H
+#define HASH_H
+
+#include <string.h>
+
+#include "types.h"
+
+/* 64-bit constants spelled out in halves, C89 has no long long literals. */
+#define HASH_PRIME64_1 (((u64)0x9E3779B1UL << 32) | 0x85EBCA87UL)
+#define HASH_PRIME64_2 (((u64)0xC2B2AE3DUL << 32) | 0x27D4EB4FUL)
+#define HASH_PRIME64_3 (((u64)0x165667B1UL << 32) | 0x9E3779F9UL)
+#define HASH_PRIME64_4 (((u64)0x85EBCA77UL << 32) | 0xC2B2AE63UL)
+#define HASH_PRIME64_5 (((u64)0x27D4EB2FUL << 32) | 0x165667C5UL)
+
+static INLINE u64
+hash_rotl64(u64 x, int r)
+{
+  return (x << r) | (x >> (64 - r));
+}
+
+/* Assembled byte by byte: the input may be unaligned, and the hash must
+ * not depend on the host byte order. */
+static INLINE u64
+hash_u64_le_get(const u8* p)
+{
+  return (u64)p[0] | ((u64)p[1] << 8) | ((u64)p[2] << 16) | ((u64)p[3] << 24) |
+         ((u64)p[4] << 32) | ((u64)p[5] << 40) | ((u64)p[6] << 48) | ((u64)p[7] << 56);
+}
+
+static INLINE u32
+hash_u32_le_get(const u8* p)
+{
+  return (u32)p[0] | ((u32)p[1] << 8) | ((u32)p[2] << 16) | ((u32)p[3] << 24);
+}
+
+static INLINE u64
+hash_round(u64 acc, u64 input)
+{
+  acc += input * HASH_PRIME64_2;
+  acc = hash_rotl64(acc, 31);
+  return acc * HASH_PRIME64_1;
+}
+
+static INLINE u64
+hash_merge(u64 acc, u64 value)
+{
+  acc ^= hash_round(0, value);
+  return acc * HASH_PRIME64_1 + HASH_PRIME64_4;
+}
+
+static INLINE u64
+hash_xxh64(const void* data, usize len, u64 seed)
+{
+  const u8* p = data;
+  const u8* end = p + len;
+  u64 h = 0;
+
+  if (len >= 32)
+  {
+    const u8* limit = end - 32;
+    u64 v1 = seed + HASH_PRIME64_1 + HASH_PRIME64_2;
+    u64 v2 = seed + HASH_PRIME64_2;
+    u64 v3 = seed;
+    u64 v4 = seed - HASH_PRIME64_1;
+
+    /* Four independent lanes keep the multipliers busy. */
+    do
+    {
+      v1 = hash_round(v1, hash_u64_le_get(p));
+      v2 = hash_round(v2, hash_u64_le_get(p + 8));
+      v3 = hash_round(v3, hash_u64_le_get(p + 16));
+      v4 = hash_round(v4, hash_u64_le_get(p + 24));
+      p += 32;
+    } while (p <= limit);
+
+    h = hash_rotl64(v1, 1) + hash_rotl64(v2, 7) + hash_rotl64(v3, 12) + hash_rotl64(v4, 18);
+    h = hash_merge(h, v1);
+    h = hash_merge(h, v2);
+    h = hash_merge(h, v3);
+    h = hash_merge(h, v4);
+  }
+  else
+  {
+    h = seed + HASH_PRIME64_5;
+  }
+
+  h += (u64)len;
+
+  for (; p + 8 <= end; p += 8)
+  {
+    h ^= hash_round(0, hash_u64_le_get(p));
+    h = hash_rotl64(h, 27) * HASH_PRIME64_1 + HASH_PRIME64_4;
+  }
+
+  if (p + 4 <= end)
+  {
+    h ^= (u64)hash_u32_le_get(p) * HASH_PRIME64_1;
+    h = hash_rotl64(h, 23) * HASH_PRIME64_2 + HASH_PRIME64_3;
+    p += 4;
+  }
+
+  for (; p < end; ++p)
+  {
+    h ^= (u64)*p * HASH_PRIME64_5;
+    h = hash_rotl64(h, 11) * HASH_PRIME64_1;
+  }
+
+  h ^= h >> 33;
+  h *= HASH_PRIME64_2;
+  h ^= h >> 29;
+  h *= HASH_PRIME64_3;
+  h ^= h >> 32;
+
+  return h;
+}
+
+/* Sixteen lowercase hex digits and a NUL. */
+static INLINE void
+hash_hex(u64 hash, char dst[17])
+{
+  static const char digit[] = "0123456789abcdef";
+  int i = 15;
+
+  for (; i >= 0; --i)
+  {
+    dst[i] = digit[hash & 0xF];
+    hash >>= 4;
+  }
+  dst[16] = '\0';
+}
+
+static INLINE int
+hash_hex_parse(const char* src, u64* hash)
+{
+  u64 value = 0;
+  int i = 0;
+
+  for (; i < 16; ++i)
+  {
+    char c = src[i];
+
+    if (c >= '0' && c <= '9')
+    {
+      value = (value << 4) | (u64)(c - '0');
+    }
+    else if (c >= 'a' && c <= 'f')
+    {
+      value = (value << 4) | (u64)(c - 'a' + 10);
+    }
+    else
+    {
+      return 0;
+    }
+  }
+
+  *hash = value;
+  return 1;
+}
+
+#endif /* HASH_H */
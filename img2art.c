@@ -0,0 +1,576 @@
+/* SPDX-License-Identifier: MIT */
+/**
+ * @file   img2art.c
+ * @author Marc-Alexandre Espiaut <ma.dev@espiaut.fr>
+ * @date   2026-03-26
+ * @version 1.0
+ * @brief  Creates an ART file from TGA images.
+ *
+ * @copyright Copyright (c) 2026 Marc-Alexandre Espiaut
+ */
+
+#if defined(__linux__)
+#define _XOPEN_SOURCE 700 /* pwrite(), posix_memalign() for fileio.h */
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "art.h"
+#include "artdecode.h"
+#include "errorcodes.h"
+#include "fileio.h"
+#include "filelist.h"
+#include "memorystream.h"
+#include "palettelut.h"
+#include "thread.h"
+#include "types.h"
+
+#define IMG2ART_VERSION "1.0"
+
+enum
+{
+  e_tga_header_len = 18,
+  e_tile_max_side = 32767 /* sizes are signed 16 bits in the tables */
+};
+
+/* Row-major, top row first. */
+typedef struct image_s image_t;
+struct image_s
+{
+  u16 width;
+  u16 height;
+  rgba_u8_t* pixel;
+};
+
+/* One pixel of bits bits: gray, 16 bits BGR555, 24 bits BGR or 32 bits
+ * BGRA. */
+static rgba_u8_t
+tga_color(const u8* src, u32 bits)
+{
+  rgba_u8_t color;
+
+  color.a = 255;
+  switch (bits)
+  {
+    case 8:
+      color.r = color.g = color.b = src[0];
+      break;
+    case 15:
+    case 16:
+    {
+      u16 value = u16_le_get(src);
+      color.r = (u8)(((value >> 10) & 0x1F) << 3);
+      color.g = (u8)(((value >> 5) & 0x1F) << 3);
+      color.b = (u8)((value & 0x1F) << 3);
+      break;
+    }
+    default:
+      color.b = src[0];
+      color.g = src[1];
+      color.r = src[2];
+      color.a = bits == 32 ? src[3] : 255;
+      break;
+  }
+
+  return color;
+}
+
+/* Uncompressed or RLE color-mapped, truecolor and grayscale TGA. Returns
+ * 0, after saying why, for anything else or a truncated file. */
+static int
+tga_decode(const u8* src, i64 size, image_t* image, const char* path)
+{
+  const u8* end = src + size;
+  const u8* cmap = NULL;
+  const u8* p = NULL;
+  u32 type = 0;
+  u32 depth = 0;
+  u32 cmap_first = 0;
+  u32 cmap_len = 0;
+  u32 cmap_depth = 0;
+  usize bpp = 0;
+  usize cmap_bpp = 0;
+  usize count = 0;
+  usize i = 0;
+  int top_down = 0;
+
+  memset(image, 0, sizeof(*image));
+
+  if (size < e_tga_header_len)
+  {
+    fprintf(stderr, "WARN: %s isn't a TGA file, skipping.\n", path);
+    return 0;
+  }
+
+  type = src[2];
+  cmap_first = u16_le_get(src + 3);
+  cmap_len = u16_le_get(src + 5);
+  cmap_depth = src[7];
+  image->width = u16_le_get(src + 12);
+  image->height = u16_le_get(src + 14);
+  depth = src[16];
+  top_down = (src[17] & 0x20) != 0;
+  bpp = (depth + 7) / 8;
+  cmap_bpp = (cmap_depth + 7) / 8;
+
+  if (!((type & ~8u) == 1 && depth == 8 && src[1] == 1 && (cmap_depth == 15 || cmap_depth == 16 || cmap_depth == 24 || cmap_depth == 32)) &&
+      !((type & ~8u) == 2 && (depth == 15 || depth == 16 || depth == 24 || depth == 32)) &&
+      !((type & ~8u) == 3 && depth == 8))
+  {
+    fprintf(stderr, "WARN: %s: TGA type %u with %u bits pixels isn't supported, skipping.\n", path, type, depth);
+    return 0;
+  }
+
+  if (!image->width || !image->height || image->width > e_tile_max_side || image->height > e_tile_max_side)
+  {
+    fprintf(stderr, "WARN: %s: %ux%u doesn't fit a tile, skipping.\n", path, image->width, image->height);
+    return 0;
+  }
+
+  p = src + e_tga_header_len + src[0];
+  /* Truecolor images may carry a color map too: it is skipped, never
+   * used for their pixels. */
+  if (src[1] == 1)
+  {
+    cmap = (type & ~8u) == 1 ? p : NULL;
+    p += cmap_len * cmap_bpp;
+  }
+  if (p > end)
+  {
+    fprintf(stderr, "WARN: %s is truncated, skipping.\n", path);
+    return 0;
+  }
+
+  count = (usize)image->width * image->height;
+  image->pixel = malloc(sizeof(*image->pixel) * count);
+  if (!image->pixel)
+  {
+    perror("malloc");
+    exit(e_error_malloc);
+  }
+
+  /* Pixels are decoded in file order, then put in their row. */
+  while (i < count)
+  {
+    usize run = 1;
+    int repeat = 0;
+
+    if (type & 8)
+    {
+      if (p >= end)
+      {
+        break;
+      }
+      run = (usize)(*p & 0x7F) + 1;
+      repeat = (*p & 0x80) != 0;
+      ++p;
+    }
+
+    for (; run && i < count; --run, ++i)
+    {
+      rgba_u8_t color;
+      usize y = i / image->width;
+      usize x = i % image->width;
+
+      if (p + bpp > end)
+      {
+        break;
+      }
+
+      if (cmap)
+      {
+        u32 index = (u32)p[0] - cmap_first;
+        color.r = color.g = color.b = 0;
+        color.a = 255;
+        if (p[0] >= cmap_first && index < cmap_len)
+        {
+          color = tga_color(cmap + index * cmap_bpp, cmap_depth);
+        }
+      }
+      else
+      {
+        color = tga_color(p, depth);
+      }
+
+      if (!repeat || run == 1)
+      {
+        p += bpp;
+      }
+
+      y = top_down ? y : image->height - 1 - y;
+      image->pixel[y * image->width + x] = color;
+    }
+
+    if (run && i < count)
+    {
+      break;
+    }
+  }
+
+  if (i < count)
+  {
+    fprintf(stderr, "WARN: %s is truncated, skipping.\n", path);
+    free(image->pixel);
+    memset(image, 0, sizeof(*image));
+    return 0;
+  }
+
+  return 1;
+}
+
+typedef struct tile_s tile_t;
+struct tile_s
+{
+  u16 width;
+  u16 height;
+  u8* pixel; /* column-major palette indices */
+};
+
+/* Loads, decodes and quantizes one image to a tile. A file that can't be
+ * used leaves an empty tile, so that the numbering doesn't shift. */
+static void
+tile_make(char* path, const PaletteLut* lut, tile_t* tile)
+{
+  MemoryStream ms = {0};
+  FILE* fp = NULL;
+  image_t image;
+  u8* index = NULL;
+  usize count = 0;
+  usize i = 0;
+
+  memset(tile, 0, sizeof(*tile));
+
+  /* memorystream_init() would stop the whole import. */
+  fp = fopen(path, "rb");
+  if (!fp)
+  {
+    fprintf(stderr, "WARN: %s can't be read, skipping.\n", path);
+    return;
+  }
+  fclose(fp);
+  memorystream_init(&ms, path);
+
+  if (!tga_decode(ms.data, ms.size, &image, path))
+  {
+    memorystream_free(&ms);
+    return;
+  }
+  memorystream_free(&ms);
+
+  count = (usize)image.width * image.height;
+  index = malloc(count);
+  tile->pixel = malloc(count);
+  if (!index || !tile->pixel)
+  {
+    perror("malloc");
+    exit(e_error_malloc);
+  }
+
+  for (; i < count; ++i)
+  {
+    index[i] = palettelut_find(lut, image.pixel[i]);
+  }
+
+  /* Rows to columns is the transpose of a tile height pixels wide. */
+  artdecode_transpose(index, image.height, image.width, tile->pixel);
+  tile->width = image.width;
+  tile->height = image.height;
+
+  free(index);
+  free(image.pixel);
+}
+
+typedef struct import_s import_t;
+struct import_s
+{
+  char** path;
+  tile_t* tile;
+  usize count;
+  usize next;
+  const PaletteLut* lut;
+  Mutex lock;
+};
+
+/* Images differ too much in size for chunks: one at a time. */
+static void
+import_worker(void* arg)
+{
+  import_t* import = arg;
+
+  for (;;)
+  {
+    usize i = 0;
+
+    mutex_lock(&import->lock);
+    i = import->next;
+    if (i < import->count)
+    {
+      ++import->next;
+    }
+    mutex_unlock(&import->lock);
+
+    if (i == import->count)
+    {
+      break;
+    }
+
+    tile_make(import->path[i], import->lut, &import->tile[i]);
+  }
+}
+
+static void
+tiles_make(char* path[], usize n, const PaletteLut* lut, tile_t* tile, u32 jobs)
+{
+  import_t import;
+  Thread* thread = NULL;
+  u32 i = 0;
+
+  if (jobs > n)
+  {
+    jobs = (u32)n;
+  }
+
+  if (jobs <= 1)
+  {
+    usize j = 0;
+    for (; j < n; ++j)
+    {
+      tile_make(path[j], lut, &tile[j]);
+    }
+    return;
+  }
+
+  thread = calloc(jobs, sizeof(*thread));
+  if (!thread)
+  {
+    perror("calloc");
+    exit(e_error_malloc);
+  }
+
+  memset(&import, 0, sizeof(import));
+  import.path = path;
+  import.tile = tile;
+  import.count = n;
+  import.lut = lut;
+  mutex_init(&import.lock);
+
+  for (; i < jobs; ++i)
+  {
+    thread_create(&thread[i], import_worker, &import);
+  }
+  for (i = 0; i < jobs; ++i)
+  {
+    thread_join(thread[i]);
+  }
+
+  mutex_destroy(&import.lock);
+  free(thread);
+}
+
+/* Tiles first to first + n - 1, no animation and no centering. */
+static void
+art_write(const char* path, const tile_t* tile, usize n, u32 first)
+{
+  u8* table = malloc(e_art_header_len + 8 * (n ? n : 1));
+  u8* dst = table;
+  FileWriter w;
+  usize i = 0;
+
+  if (!table)
+  {
+    perror("malloc");
+    exit(e_error_malloc);
+  }
+
+  u32_le_put(dst + 0, e_art_version);
+  u32_le_put(dst + 4, (u32)n);
+  u32_le_put(dst + 8, first);
+  u32_le_put(dst + 12, first + (u32)n - 1);
+  dst += e_art_header_len;
+  for (i = 0; i < n; ++i)
+  {
+    u16_le_put(dst + 2 * i, tile[i].width);
+    u16_le_put(dst + 2 * (n + i), tile[i].height);
+    u32_le_put(dst + 4 * n + 4 * i, 0);
+  }
+
+  /* Small tiles are gathered into large writes. */
+  fileio_writer_open(&w, path, 0);
+  fileio_writer_write(&w, table, e_art_header_len + 8 * n);
+  for (i = 0; i < n; ++i)
+  {
+    fileio_writer_write(&w, tile[i].pixel, (u64)tile[i].width * tile[i].height);
+  }
+  fileio_writer_close(&w);
+
+  free(table);
+}
+
+static void
+usage(const char* prgname, const char* prgver)
+{
+  fprintf(stderr, "%s %s : Copyright (c) 2026 Marc-Alexandre Espiaut\n", prgname, prgver);
+  fprintf(stderr, "\n");
+  fprintf(stderr, "%s is a tool for creating Build engine ART files from TGA images.\n", prgname);
+  fprintf(stderr, "\n");
+  fprintf(stderr, "Usage: %s [options] [files]\n", prgname);
+  fprintf(stderr, "\n");
+  fprintf(stderr, "Each image becomes a tile, in order, its colors matched to the palette.\n");
+  fprintf(stderr, "Pixels with an alpha under 128 become transparent.\n");
+  fprintf(stderr, "\n");
+  fprintf(stderr, "Options:\n");
+  fprintf(stderr, "  -h, --help             Show this help message and exit\n");
+  fprintf(stderr, "  -o, --output FILE.ART  Write to FILE.ART (default: TILES000.ART)\n");
+  fprintf(stderr, "  -s, --start N          Number the first tile N (default: 0)\n");
+  fprintf(stderr, "  -p, --palette FILE     Take the colors from FILE (default: PALETTE.DAT)\n");
+  fprintf(stderr, "  -c, --cache FILE       Keep the color table of the palette in FILE\n");
+  fprintf(stderr, "  -j, --jobs N           Convert N images in parallel (0: one per CPU)\n");
+  fprintf(stderr, "  -l, --list LIST.TXT    Add files as listed in LIST.TXT (- for stdin)\n");
+  fprintf(stderr, "  -f, --force            Overwrite an existing ART file\n");
+  fprintf(stderr, "\n");
+  fprintf(stderr, "Examples:\n");
+  fprintf(stderr, "  %s -o TILES020.ART -s 5120 frame*.tga\n", prgname);
+  fprintf(stderr, "  find frames -name '*.tga' | sort | %s -j 0 -c palette.lut -l -\n", prgname);
+  exit(EXIT_FAILURE);
+}
+
+int
+main(int argc, char* argv[])
+{
+  FileList files = {0};
+  rgba_u8_t palette[256];
+  PaletteLut* lut = NULL;
+  tile_t* tile = NULL;
+  char* palette_path = "PALETTE.DAT";
+  const char* cache_path = NULL;
+  const char* output = "TILES000.ART";
+  unsigned long start = 0;
+  u32 jobs = 1;
+  int force = 0;
+  usize j = 0;
+  int i;
+
+  if (argc < 2)
+  {
+    usage(argv[0], IMG2ART_VERSION);
+  }
+
+  for (i = 1; i < argc; ++i)
+  {
+    if (!strcmp(argv[i], "-h") || !strcmp(argv[i], "--help"))
+    {
+      usage(argv[0], IMG2ART_VERSION);
+    }
+    else if (!strcmp(argv[i], "-o") || !strcmp(argv[i], "--output"))
+    {
+      if (++i == argc)
+      {
+        usage(argv[0], IMG2ART_VERSION);
+      }
+      output = argv[i];
+    }
+    else if (!strcmp(argv[i], "-s") || !strcmp(argv[i], "--start"))
+    {
+      if (++i == argc)
+      {
+        usage(argv[0], IMG2ART_VERSION);
+      }
+      start = strtoul(argv[i], NULL, 10);
+    }
+    else if (!strcmp(argv[i], "-p") || !strcmp(argv[i], "--palette"))
+    {
+      if (++i == argc)
+      {
+        usage(argv[0], IMG2ART_VERSION);
+      }
+      palette_path = argv[i];
+    }
+    else if (!strcmp(argv[i], "-c") || !strcmp(argv[i], "--cache"))
+    {
+      if (++i == argc)
+      {
+        usage(argv[0], IMG2ART_VERSION);
+      }
+      cache_path = argv[i];
+    }
+    else if (!strcmp(argv[i], "-j") || !strcmp(argv[i], "--jobs"))
+    {
+      if (++i == argc)
+      {
+        usage(argv[0], IMG2ART_VERSION);
+      }
+      jobs = (u32)strtoul(argv[i], NULL, 10);
+      if (!jobs)
+      {
+        jobs = thread_cpu_count();
+      }
+    }
+    else if (!strcmp(argv[i], "-l") || !strcmp(argv[i], "--list"))
+    {
+      if (++i == argc)
+      {
+        usage(argv[0], IMG2ART_VERSION);
+      }
+      filelist_load(&files, argv[i]);
+    }
+    else if (!strcmp(argv[i], "-f") || !strcmp(argv[i], "--force"))
+    {
+      force = 1;
+    }
+    else
+    {
+      filelist_add(&files, argv[i]);
+    }
+  }
+
+  if (!files.count)
+  {
+    usage(argv[0], IMG2ART_VERSION);
+  }
+
+  if (start + files.count - 1 > 0x7FFFFFFFUL - 65536 || files.count > 65536)
+  {
+    fprintf(stderr, "ERROR: Tiles %lu to %lu can't be numbered!\n", start, start + (unsigned long)files.count - 1);
+    exit(EXIT_FAILURE);
+  }
+
+  if (!force)
+  {
+    fileio_abort_if_exists(output);
+  }
+
+  lut = malloc(sizeof(*lut));
+  tile = calloc(files.count, sizeof(*tile));
+  if (!lut || !tile)
+  {
+    perror("malloc");
+    exit(e_error_malloc);
+  }
+
+  art_palette_load(palette, palette_path);
+  palettelut_open(lut, palette, cache_path);
+
+  tiles_make(files.path, files.count, lut, tile, jobs);
+
+  for (; j < files.count; ++j)
+  {
+    if (tile[j].pixel)
+    {
+      fprintf(stdout, "Adding %s as tile %lu (%ux%u).\n", files.path[j], start + (unsigned long)j, tile[j].width, tile[j].height);
+    }
+  }
+
+  art_write(output, tile, files.count, (u32)start);
+
+  for (j = 0; j < files.count; ++j)
+  {
+    free(tile[j].pixel);
+  }
+  free(tile);
+  free(lut);
+  filelist_free(&files);
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,531 @@
+/* SPDX-License-Identifier: MIT */
+/**
+ * @file   map.h
+ * @author Marc-Alexandre Espiaut <ma.dev@espiaut.fr>
+ * @date   2026-03-18
+ * @brief  Parsing and analysis of Build engine maps (.map).
+ *
+ * @copyright Copyright (c) 2026 Marc-Alexandre Espiaut
+ */
+
+#ifndef MAP_H
+#define MAP_H
+
+#include <stdio.h>
+#include <string.h>
+
+#include "arena.h"
+#include "memorystream.h"
+#include "types.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SPRITE_TABLE_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define SPRITE_TABLE_NEON
+#endif
+
+/* On-disk sizes, in bytes. */
+enum
+{
+  e_map_header_len = 22,
+  e_sector_len = 40,
+  e_wall_len = 32,
+  e_sprite_len = 44
+};
+
+/* Lumps for map_parse_lumps() to decode. The others are only counted:
+ * their records are stepped over without being read. */
+enum
+{
+  e_map_lump_sector = 1,
+  e_map_lump_wall = 2,
+  e_map_lump_sprite = 4,
+  e_map_lump_all = 7
+};
+
+typedef struct player_s player_t;
+struct player_s
+{
+  vec3_i32_t position;
+  i16 angle;
+};
+
+typedef struct ceilling_floor_s ceilling_floor_t;
+struct ceilling_floor_s
+{
+  i8 shade;
+  i32 height;
+  i16 pic;
+  i16 slope;
+  i16 stat;
+  u8 palette;
+  vec2_u8_t panning;
+};
+
+typedef struct sector_s sector_t;
+struct sector_s
+{
+  i16 wall_ptr;
+  i16 wall_count;
+  ceilling_floor_t ceilling;
+  ceilling_floor_t floor;
+  u8 visibility;
+  u8 filler;
+  u16 lotag;
+  i16 hitag;
+  i16 extra;
+};
+
+typedef struct wall_s wall_t;
+struct wall_s
+{
+  vec2_i32_t position;
+  i16 wall_next_right;
+  i16 wall_next_left;
+  i16 sector_next;
+  i16 stat;
+  i16 pic;
+  i16 pic_over;
+  signed char shade;
+  u8 pal;
+  vec2_u8_t repeat;
+  vec2_u8_t panning;
+  i16 lotag;
+  i16 hitag;
+  i16 extra;
+};
+
+typedef struct sprite_s sprite_t;
+struct sprite_s
+{
+  vec3_i32_t position;
+  i16 stat;
+  i16 pic;
+  signed char shade;
+  u8 pal;
+  u8 clipping_distance;
+  u8 filler;
+  vec2_u8_t repeat;
+  vec2_i8_t offset;
+  i16 sector;
+  i16 status;
+  i16 angle;
+  i16 owner;
+  vec3_i16_t vel;
+  u16 lotag;
+  u16 hitag;
+  i16 extra;
+};
+
+/* Structure-of-arrays copy of the sprite fields queries filter on, so a
+ * scan reads 2 bytes per sprite and field instead of whole sprite_t. */
+typedef struct sprite_table_s sprite_table_t;
+struct sprite_table_s
+{
+  i16* pic;
+  u16* lotag;
+  u8* pal;
+  i16* sector;
+};
+
+typedef struct map_s map_t;
+struct map_s
+{
+  i32 version;
+  player_t player;
+  i16 sector_start;
+  u16 sector_count;
+  sector_t* sector;
+  u16 wall_count;
+  wall_t* wall;
+  u16 sprite_count;
+  sprite_t* sprite;
+  sprite_table_t sprite_table;
+};
+
+static INLINE void
+ceilling_floor_parse(const u8* src, ceilling_floor_t* cf)
+{
+  cf->pic = i16_le_get(src + 0);
+  cf->slope = i16_le_get(src + 2);
+  cf->shade = (i8)src[4];
+  cf->palette = src[5];
+  cf->panning.x = src[6];
+  cf->panning.y = src[7];
+}
+
+static INLINE void
+sector_parse(const u8* src, sector_t* sector)
+{
+  sector->wall_ptr = i16_le_get(src + 0);
+  sector->wall_count = i16_le_get(src + 2);
+
+  sector->ceilling.height = i32_le_get(src + 4);
+  sector->floor.height = i32_le_get(src + 8);
+
+  sector->ceilling.stat = i16_le_get(src + 12);
+  sector->floor.stat = i16_le_get(src + 14);
+
+  ceilling_floor_parse(src + 16, &sector->ceilling);
+  ceilling_floor_parse(src + 24, &sector->floor);
+
+  sector->visibility = src[32];
+
+  sector->filler = src[33];
+
+  sector->lotag = u16_le_get(src + 34);
+  sector->hitag = i16_le_get(src + 36);
+  sector->extra = i16_le_get(src + 38);
+}
+
+static INLINE void
+wall_parse(const u8* src, wall_t* wall)
+{
+  wall->position.x = i32_le_get(src + 0);
+  wall->position.y = i32_le_get(src + 4);
+
+  wall->wall_next_right = i16_le_get(src + 8);
+  wall->wall_next_left = i16_le_get(src + 10);
+
+  wall->sector_next = i16_le_get(src + 12);
+
+  wall->stat = i16_le_get(src + 14);
+
+  wall->pic = i16_le_get(src + 16);
+  wall->pic_over = i16_le_get(src + 18);
+
+  wall->shade = (signed char)src[20];
+  wall->pal = src[21];
+
+  wall->repeat.x = src[22];
+  wall->repeat.y = src[23];
+
+  wall->panning.x = src[24];
+  wall->panning.y = src[25];
+
+  wall->lotag = i16_le_get(src + 26);
+  wall->hitag = i16_le_get(src + 28);
+  wall->extra = i16_le_get(src + 30);
+}
+
+static INLINE void
+sprite_parse(const u8* src, sprite_t* sprite)
+{
+  sprite->position.x = i32_le_get(src + 0);
+  sprite->position.y = i32_le_get(src + 4);
+  sprite->position.z = i32_le_get(src + 8);
+
+  sprite->stat = i16_le_get(src + 12);
+
+  sprite->pic = i16_le_get(src + 14);
+  sprite->shade = (signed char)src[16];
+  sprite->pal = src[17];
+
+  sprite->clipping_distance = src[18];
+
+  sprite->filler = src[19];
+
+  sprite->repeat.x = src[20];
+  sprite->repeat.y = src[21];
+
+  sprite->offset.x = (i8)src[22];
+  sprite->offset.y = (i8)src[23];
+
+  sprite->sector = i16_le_get(src + 24);
+  sprite->status = i16_le_get(src + 26);
+
+  sprite->angle = i16_le_get(src + 28);
+
+  sprite->owner = i16_le_get(src + 30);
+
+  sprite->vel.x = i16_le_get(src + 32);
+  sprite->vel.y = i16_le_get(src + 34);
+  sprite->vel.z = i16_le_get(src + 36);
+
+  sprite->lotag = u16_le_get(src + 38);
+  sprite->hitag = u16_le_get(src + 40);
+  sprite->extra = i16_le_get(src + 42);
+}
+
+static INLINE u16
+map_count_parse(MemoryStream* ms)
+{
+  const u8* src = memorystream_view(ms, 2);
+
+  return src ? u16_le_get(src) : 0;
+}
+
+/* Lumps are bounds-checked once, not per field: a truncated lump keeps
+ * only its whole records. */
+static INLINE u16
+map_lump_check(MemoryStream* ms, u16 count, i64 record_len, const char* lump)
+{
+  i64 available = (ms->size - ms->position) / record_len;
+
+  if (count > available)
+  {
+    fprintf(stderr, "WARN: %s lump truncated (%ld of %u records)\n", lump, (long)available, count);
+    return (u16)available;
+  }
+
+  return count;
+}
+
+/* Reads a record count without consuming it, 0 if it lies past the end. */
+static INLINE u16
+map_count_peek(MemoryStream* ms, i64 offset)
+{
+  if (offset < 0 || offset > ms->size - 2)
+  {
+    return 0;
+  }
+
+  return u16_le_get(ms->data + offset);
+}
+
+/* Sizes the arena once for the three record arrays, from the counts in
+ * the file but never below the vanilla maxima: a reused arena then only
+ * grows for oversized maps and is simply reset between files. */
+static INLINE void
+map_arena_reserve(MemoryStream* ms, map_t* map, Arena* arena)
+{
+  i64 wall_count_offset = ms->position + (i64)map->sector_count * e_sector_len;
+  u16 wall_count = map_count_peek(ms, wall_count_offset);
+  u16 sprite_count = map_count_peek(ms, wall_count_offset + 2 + (i64)wall_count * e_wall_len);
+  usize sectors = map->sector_count > 1024 ? map->sector_count : 1024;
+  usize walls = wall_count > 8192 ? wall_count : 8192;
+  usize sprites = sprite_count > 4096 ? sprite_count : 4096;
+  usize table = arena_size_align(sizeof(*map->sprite_table.pic) * sprites) + arena_size_align(sizeof(*map->sprite_table.lotag) * sprites) + arena_size_align(sizeof(*map->sprite_table.pal) * sprites) + arena_size_align(sizeof(*map->sprite_table.sector) * sprites);
+
+  arena_reserve(arena, arena_size_align(sizeof(*map->sector) * sectors) + arena_size_align(sizeof(*map->wall) * walls) + arena_size_align(sizeof(*map->sprite) * sprites) + table);
+}
+
+/* Record arrays of the lumps left out are NULL, their counts still set. */
+static INLINE void
+map_parse_lumps(MemoryStream* ms, map_t* map, Arena* arena, u32 lumps)
+{
+  {
+    u8 header[e_map_header_len] = {0};
+
+    memorystream_read(ms, header, e_map_header_len);
+
+    map->version = i32_le_get(header + 0);
+
+    map->player.position.x = i32_le_get(header + 4);
+    map->player.position.y = i32_le_get(header + 8);
+    map->player.position.z = i32_le_get(header + 12);
+    map->player.angle = i16_le_get(header + 16);
+
+    map->sector_start = i16_le_get(header + 18);
+
+    map->sector_count = u16_le_get(header + 20);
+  }
+
+  if (lumps)
+  {
+    map_arena_reserve(ms, map, arena);
+  }
+
+  map->sector_count = map_lump_check(ms, map->sector_count, e_sector_len, "sector");
+  if (!(lumps & e_map_lump_sector))
+  {
+    memorystream_view(ms, (i64)map->sector_count * e_sector_len);
+  }
+  else
+  {
+    const u8* src = memorystream_view(ms, (i64)map->sector_count * e_sector_len);
+    size_t i = 0;
+
+    map->sector = arena_alloc(arena, sizeof(*map->sector) * map->sector_count);
+    for (; i < map->sector_count; ++i, src += e_sector_len)
+    {
+      sector_parse(src, &map->sector[i]);
+    }
+  }
+
+  map->wall_count = map_lump_check(ms, map_count_parse(ms), e_wall_len, "wall");
+  if (!(lumps & e_map_lump_wall))
+  {
+    memorystream_view(ms, (i64)map->wall_count * e_wall_len);
+  }
+  else
+  {
+    const u8* src = memorystream_view(ms, (i64)map->wall_count * e_wall_len);
+    size_t i = 0;
+
+    map->wall = arena_alloc(arena, sizeof(*map->wall) * map->wall_count);
+    for (; i < map->wall_count; ++i, src += e_wall_len)
+    {
+      wall_parse(src, &map->wall[i]);
+    }
+  }
+
+  map->sprite_count = map_lump_check(ms, map_count_parse(ms), e_sprite_len, "sprite");
+  if (!(lumps & e_map_lump_sprite))
+  {
+    memorystream_view(ms, (i64)map->sprite_count * e_sprite_len);
+  }
+  else
+  {
+    const u8* src = memorystream_view(ms, (i64)map->sprite_count * e_sprite_len);
+    size_t i = 0;
+
+    map->sprite = arena_alloc(arena, sizeof(*map->sprite) * map->sprite_count);
+    map->sprite_table.pic = arena_alloc(arena, sizeof(*map->sprite_table.pic) * map->sprite_count);
+    map->sprite_table.lotag = arena_alloc(arena, sizeof(*map->sprite_table.lotag) * map->sprite_count);
+    map->sprite_table.pal = arena_alloc(arena, sizeof(*map->sprite_table.pal) * map->sprite_count);
+    map->sprite_table.sector = arena_alloc(arena, sizeof(*map->sprite_table.sector) * map->sprite_count);
+    for (; i < map->sprite_count; ++i, src += e_sprite_len)
+    {
+      sprite_parse(src, &map->sprite[i]);
+      map->sprite_table.pic[i] = map->sprite[i].pic;
+      map->sprite_table.lotag[i] = map->sprite[i].lotag;
+      map->sprite_table.pal[i] = map->sprite[i].pal;
+      map->sprite_table.sector[i] = map->sprite[i].sector;
+    }
+  }
+}
+
+static INLINE void
+map_parse(MemoryStream* ms, map_t* map, Arena* arena)
+{
+  map_parse_lumps(ms, map, arena, e_map_lump_all);
+}
+
+/* How the level can be finished, as far as single player goes. */
+enum
+{
+  e_nuke_none,
+  e_nuke_unknown, /* lotag 32767 */
+  e_nuke_fry, /* lotag 65534 */
+  e_nuke_normal, /* lotag 65535 */
+  e_nuke_secret /* NUKEBUTTON with palette 14 */
+};
+
+/* Everything the printers need, gathered in one pass over the sprites. */
+typedef struct map_summary_s map_summary_t;
+struct map_summary_s
+{
+  i32 nuke;
+  i32 coop_starts;
+  i32 dukematch_starts;
+  i32 misplaced_sprites; /* outside the sector they name, -1 if unchecked */
+};
+
+static INLINE i32
+nuke_from_lotag(u16 lotag)
+{
+  switch (lotag)
+  {
+    case 32767:
+      return e_nuke_unknown;
+      break;
+    case 65534:
+      return e_nuke_fry;
+      break;
+    case 65535:
+      return e_nuke_normal;
+      break;
+    default:
+      return e_nuke_none;
+      break;
+  }
+}
+
+/* Counts the sprites with the given picnum and lotag. */
+static INLINE usize
+sprite_table_count(const sprite_table_t* table, usize n, i16 pic, u16 lotag)
+{
+  usize count = 0;
+  usize i = 0;
+
+#if defined(SPRITE_TABLE_SSE2)
+  {
+    const __m128i want_pic = _mm_set1_epi16(pic);
+    const __m128i want_lotag = _mm_set1_epi16((short)lotag);
+
+    /* Matching lanes are -1, so subtracting the mask counts them. A lane
+     * sees at most 65535 / 8 matches; it can't overflow. */
+    __m128i acc = _mm_setzero_si128();
+    u16 lanes[8];
+    size_t j = 0;
+
+    for (; i + 8 <= n; i += 8)
+    {
+      __m128i p = _mm_loadu_si128((const __m128i*)(table->pic + i));
+      __m128i l = _mm_loadu_si128((const __m128i*)(table->lotag + i));
+      __m128i match = _mm_and_si128(_mm_cmpeq_epi16(p, want_pic), _mm_cmpeq_epi16(l, want_lotag));
+      acc = _mm_sub_epi16(acc, match);
+    }
+
+    _mm_storeu_si128((__m128i*)lanes, acc);
+    for (; j < 8; ++j)
+    {
+      count += lanes[j];
+    }
+  }
+#elif defined(SPRITE_TABLE_NEON)
+  {
+    const uint16x8_t want_pic = vdupq_n_u16((u16)pic);
+    const uint16x8_t want_lotag = vdupq_n_u16(lotag);
+    uint16x8_t acc = vdupq_n_u16(0);
+    u16 lanes[8];
+    size_t j = 0;
+
+    for (; i + 8 <= n; i += 8)
+    {
+      uint16x8_t p = vld1q_u16((const u16*)(table->pic + i));
+      uint16x8_t l = vld1q_u16(table->lotag + i);
+      uint16x8_t match = vandq_u16(vceqq_u16(p, want_pic), vceqq_u16(l, want_lotag));
+      acc = vsubq_u16(acc, match);
+    }
+
+    vst1q_u16(lanes, acc);
+    for (; j < 8; ++j)
+    {
+      count += lanes[j];
+    }
+  }
+#endif
+
+  for (; i < n; ++i)
+  {
+    count += (table->pic[i] == pic) & (table->lotag[i] == lotag);
+  }
+
+  return count;
+}
+
+static INLINE void
+map_analyze(map_t* map, map_summary_t* summary)
+{
+  const sprite_table_t* table = &map->sprite_table;
+  size_t i = 0;
+
+  memset(summary, 0, sizeof(*summary));
+
+  summary->dukematch_starts = (i32)sprite_table_count(table, map->sprite_count, 1405, 0); /* APLAYER */
+  summary->coop_starts = (i32)sprite_table_count(table, map->sprite_count, 1405, 1);
+
+  for (; i < map->sprite_count && !summary->nuke; ++i)
+  {
+    if (table->pic[i] == 142) /* NUKEBUTTON */
+    {
+      summary->nuke = nuke_from_lotag(table->lotag[i]);
+      if (!summary->nuke && table->pal[i] == 14)
+      {
+        summary->nuke = e_nuke_secret;
+      }
+    }
+  }
+
+  /* Sector effectors can end the level too, but sprites take precedence. */
+  for (i = 0; i < map->sector_count && !summary->nuke; ++i)
+  {
+    summary->nuke = nuke_from_lotag(map->sector[i].lotag);
+  }
+}
+
+#endif /* MAP_H */
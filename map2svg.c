@@ -0,0 +1,431 @@
+/* SPDX-License-Identifier: MIT */
+/**
+ * @file   map2svg.c
+ * @author Marc-Alexandre Espiaut <ma.dev@espiaut.fr>
+ * @date   2026-03-28
+ * @version 1.0
+ * @brief  Draws the sectors of MAP files as SVG images.
+ *
+ * Every sector is one <path>, its wall loops joined as subpaths with the
+ * even-odd rule so inner loops come out as holes. Coordinates go through
+ * a hand-rolled integer formatter straight into a large buffer, which
+ * reaches the file e_fileio_buffer (1 MiB) at a time. A drawing split
+ * into tiles only walks, for each tile, the sectors the spatial index
+ * puts under it.
+ *
+ * @copyright Copyright (c) 2026 Marc-Alexandre Espiaut
+ */
+
+#if defined(__linux__)
+#define _XOPEN_SOURCE 700 /* pwrite(), posix_memalign() for fileio.h */
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+#include "errorcodes.h"
+#include "fileio.h"
+#include "filelist.h"
+#include "map.h"
+#include "mapspatial.h"
+#include "memorystream.h"
+#include "outputbuffer.h"
+#include "types.h"
+
+#define MAP2SVG_VERSION "1.0"
+
+enum
+{
+  e_map2svg_flush = e_fileio_buffer, /* bytes buffered before a write, passed through by FileWriter */
+  e_map2svg_margin = 512, /* map units around the drawing */
+  e_map2svg_wall_len = 24, /* " -4294967295 -4294967295" */
+  e_map2svg_tiles_max = 64 /* per side */
+};
+
+static const char svg_digits[] =
+  "00010203040506070809"
+  "10111213141516171819"
+  "20212223242526272829"
+  "30313233343536373839"
+  "40414243444546474849"
+  "50515253545556575859"
+  "60616263646566676869"
+  "70717273747576777879"
+  "80818283848586878889"
+  "90919293949596979899";
+
+/* Writes value in decimal to dst, two digits per division, and returns
+ * its length. */
+static usize
+svg_int(char* dst, i64 value)
+{
+  char buffer[24];
+  char* p = buffer + sizeof(buffer);
+  u64 v = value < 0 ? (u64)0 - (u64)value : (u64)value;
+  usize n = 0;
+
+  while (v >= 100)
+  {
+    u32 d = (u32)(v % 100) * 2;
+
+    v /= 100;
+    *--p = svg_digits[d + 1];
+    *--p = svg_digits[d];
+  }
+  if (v >= 10)
+  {
+    *--p = svg_digits[v * 2 + 1];
+    *--p = svg_digits[v * 2];
+  }
+  else
+  {
+    *--p = (char)('0' + v);
+  }
+  if (value < 0)
+  {
+    *--p = '-';
+  }
+
+  n = (usize)(buffer + sizeof(buffer) - p);
+  memcpy(dst, p, n);
+  return n;
+}
+
+/* A loop starts at the first wall of the sector, ends with the wall whose
+ * point2 comes back to its start, and the next loop starts right after.
+ * Each loop is one absolute move, then relative lines, which keeps most
+ * numbers short. */
+static void
+svg_sector(OutputBuffer* ob, const map_t* map, u32 s)
+{
+  const sector_t* sector = &map->sector[s];
+  i32 end = sector->wall_ptr + sector->wall_count;
+  i32 start = sector->wall_ptr;
+  i32 i = sector->wall_ptr;
+  vec2_i32_t last = {0, 0};
+  char* dst = NULL;
+
+  outputbuffer_reserve(ob, 32 + (usize)sector->wall_count * (e_map2svg_wall_len + 2));
+  dst = ob->data + ob->size;
+
+  memcpy(dst, "<path d=\"", 9);
+  dst += 9;
+  for (; i < end; ++i)
+  {
+    const wall_t* wall = &map->wall[i];
+
+    if (i == start)
+    {
+      *dst++ = 'M';
+      dst += svg_int(dst, wall->position.x);
+      *dst++ = ' ';
+      dst += svg_int(dst, wall->position.y);
+    }
+    else
+    {
+      /* Repeated pairs continue the l command. */
+      *dst++ = i == start + 1 ? 'l' : ' ';
+      dst += svg_int(dst, (i64)wall->position.x - last.x);
+      *dst++ = ' ';
+      dst += svg_int(dst, (i64)wall->position.y - last.y);
+    }
+    last = wall->position;
+
+    if (wall->wall_next_right == start || i + 1 == end)
+    {
+      *dst++ = 'z';
+      start = i + 1;
+    }
+  }
+  memcpy(dst, "\"/>\n", 4);
+  dst += 4;
+
+  ob->size = (usize)(dst - ob->data);
+}
+
+static void
+svg_flush(OutputBuffer* ob, FileWriter* w, usize threshold)
+{
+  if (ob->size >= threshold)
+  {
+    fileio_writer_write(w, ob->data, ob->size);
+    ob->size = 0;
+  }
+}
+
+static int
+svg_sector_compare(const void* a, const void* b)
+{
+  return (int)*(const u16*)a - (int)*(const u16*)b;
+}
+
+/* Draws the n sectors of sector, in that order, over the box min-max. */
+static void
+svg_write(OutputBuffer* ob, const map_t* map, const u16* sector, u32 n, vec2_i32_t min, vec2_i32_t max, const char* path)
+{
+  FileWriter w;
+  u32 i = 0;
+
+  fileio_writer_open(&w, path, 0);
+
+  ob->size = 0;
+  outputbuffer_printf(ob, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n");
+  outputbuffer_printf(ob, "<svg xmlns=\"http://www.w3.org/2000/svg\" viewBox=\"%ld %ld %ld %ld\">\n", (long)min.x, (long)min.y, (long)((i64)max.x - min.x + 1), (long)((i64)max.y - min.y + 1));
+  outputbuffer_printf(ob, "<style>path{fill:#d8d8d8;fill-rule:evenodd;stroke:#000;stroke-width:1;vector-effect:non-scaling-stroke}</style>\n");
+
+  for (; i < n; ++i)
+  {
+    svg_sector(ob, map, sector[i]);
+    svg_flush(ob, &w, e_map2svg_flush);
+  }
+
+  /* The player start, drawn the size of the player. */
+  if (map->player.position.x >= min.x && map->player.position.x <= max.x && map->player.position.y >= min.y && map->player.position.y <= max.y)
+  {
+    outputbuffer_printf(ob, "<circle cx=\"%ld\" cy=\"%ld\" r=\"128\" fill=\"#c00\"/>\n", (long)map->player.position.x, (long)map->player.position.y);
+  }
+
+  outputbuffer_printf(ob, "</svg>\n");
+  svg_flush(ob, &w, 0);
+  fileio_writer_close(&w);
+}
+
+/* in with its extension replaced by .svg, or by -ROW-COLUMN.svg for a
+ * tile. */
+static char*
+svg_path_make(const char* in, u32 tiles, u32 row, u32 column)
+{
+  char ext[sizeof("-4294967295-4294967295.svg")];
+
+  if (tiles > 1)
+  {
+    sprintf(ext, "-%u-%u.svg", row, column);
+  }
+  else
+  {
+    strcpy(ext, ".svg");
+  }
+
+  return path_extension_replace(in, ext);
+}
+
+/* Draws the map of in to out, or when out is NULL to a file named after
+ * in. Tiles are always named after out or in. */
+static void
+map_draw(char* in, const char* out, u32 tiles, int force, Arena* arena, OutputBuffer* ob)
+{
+  MemoryStream ms = {0};
+  map_t map = {0};
+  MapSpatial spatial;
+  vec2_i32_t lo;
+  vec2_i32_t hi;
+  u16* sector = NULL;
+  u32 n = 0;
+  u32 s = 0;
+  u32 row = 0;
+
+  memorystream_init(&ms, in);
+  map_parse_lumps(&ms, &map, arena, e_map_lump_sector | e_map_lump_wall);
+  memorystream_free(&ms);
+
+  mapspatial_build(&spatial, &map);
+
+  sector = malloc(sizeof(*sector) * (map.sector_count ? map.sector_count : 1));
+  if (!sector)
+  {
+    perror("malloc");
+    exit(e_error_malloc);
+  }
+
+  lo.x = lo.y = 0x7FFFFFFF;
+  hi.x = hi.y = -0x7FFFFFFF - 1;
+  for (; s < map.sector_count; ++s)
+  {
+    if (spatial.valid[s])
+    {
+      lo.x = spatial.min[s].x < lo.x ? spatial.min[s].x : lo.x;
+      lo.y = spatial.min[s].y < lo.y ? spatial.min[s].y : lo.y;
+      hi.x = spatial.max[s].x > hi.x ? spatial.max[s].x : hi.x;
+      hi.y = spatial.max[s].y > hi.y ? spatial.max[s].y : hi.y;
+      sector[n++] = (u16)s;
+    }
+  }
+
+  if (n < map.sector_count)
+  {
+    fprintf(stderr, "WARN: %s: %u of %u sectors have broken walls and are left out.\n", in, map.sector_count - n, map.sector_count);
+  }
+
+  if (!n)
+  {
+    fprintf(stderr, "WARN: %s: No sector to draw.\n", in);
+  }
+  else
+  {
+    lo.x = lo.x > -0x7FFFFFFF + e_map2svg_margin ? lo.x - e_map2svg_margin : -0x7FFFFFFF - 1;
+    lo.y = lo.y > -0x7FFFFFFF + e_map2svg_margin ? lo.y - e_map2svg_margin : -0x7FFFFFFF - 1;
+    hi.x = hi.x < 0x7FFFFFFF - e_map2svg_margin ? hi.x + e_map2svg_margin : 0x7FFFFFFF;
+    hi.y = hi.y < 0x7FFFFFFF - e_map2svg_margin ? hi.y + e_map2svg_margin : 0x7FFFFFFF;
+  }
+
+  for (; n && row < tiles; ++row)
+  {
+    i64 height = ((i64)hi.y - lo.y + tiles) / tiles;
+    u32 column = 0;
+
+    for (; column < tiles; ++column)
+    {
+      i64 width = ((i64)hi.x - lo.x + tiles) / tiles;
+      char* name = tiles == 1 && out ? NULL : svg_path_make(out ? out : in, tiles, row, column);
+      const char* path = name ? name : out;
+
+      if (!force)
+      {
+        fileio_abort_if_exists(path);
+      }
+
+      if (tiles > 1)
+      {
+        vec2_i32_t min;
+        vec2_i32_t max;
+        u32 count = 0;
+
+        min.x = (i32)(lo.x + width * column);
+        min.y = (i32)(lo.y + height * row);
+        max.x = (i32)(min.x + width - 1 < hi.x ? min.x + width - 1 : hi.x);
+        max.y = (i32)(min.y + height - 1 < hi.y ? min.y + height - 1 : hi.y);
+
+        /* Sectors in map order, so overlaps stack as in the full drawing. */
+        count = mapspatial_sectors_in(&spatial, min, max, sector);
+        qsort(sector, count, sizeof(*sector), svg_sector_compare);
+
+        fprintf(stdout, "Drawing %s (%u sectors) to %s.\n", in, count, path);
+        svg_write(ob, &map, sector, count, min, max, path);
+      }
+      else
+      {
+        fprintf(stdout, "Drawing %s (%u sectors) to %s.\n", in, n, path);
+        svg_write(ob, &map, sector, n, lo, hi, path);
+      }
+
+      free(name);
+    }
+  }
+
+  free(sector);
+  mapspatial_free(&spatial);
+  arena_reset(arena);
+}
+
+static void
+usage(const char* prgname, const char* prgver)
+{
+  fprintf(stderr, "%s %s : Copyright (c) 2026 Marc-Alexandre Espiaut\n", prgname, prgver);
+  fprintf(stderr, "\n");
+  fprintf(stderr, "%s is a tool for drawing Build games maps (.map) as SVG images.\n", prgname);
+  fprintf(stderr, "\n");
+  fprintf(stderr, "Usage: %s [options] [files]\n", prgname);
+  fprintf(stderr, "\n");
+  fprintf(stderr, "Each FILE.MAP is drawn to FILE.svg, or to FILE-ROW-COLUMN.svg when split.\n");
+  fprintf(stderr, "\n");
+  fprintf(stderr, "Options:\n");
+  fprintf(stderr, "  -h, --help             Show this help message and exit\n");
+  fprintf(stderr, "  -o, --output FILE.SVG  Draw the only input to FILE.SVG instead\n");
+  fprintf(stderr, "  -t, --tiles N          Split the drawing into N x N tiles (up to %d)\n", e_map2svg_tiles_max);
+  fprintf(stderr, "  -l, --list LIST.TXT    Add files as listed in LIST.TXT (- for stdin)\n");
+  fprintf(stderr, "  -f, --force            Overwrite existing SVG files\n");
+  fprintf(stderr, "\n");
+  fprintf(stderr, "Examples:\n");
+  fprintf(stderr, "  %s E1L1.MAP\n", prgname);
+  fprintf(stderr, "  %s -o hollywood.svg E1L1.MAP\n", prgname);
+  fprintf(stderr, "  %s -t 4 maps/*.map\n", prgname);
+  exit(EXIT_FAILURE);
+}
+
+int
+main(int argc, char* argv[])
+{
+  FileList files = {0};
+  Arena arena = {0};
+  OutputBuffer ob = {0};
+  char* output = NULL;
+  u32 tiles = 1;
+  int force = 0;
+  usize j = 0;
+  int i;
+
+  if (argc < 2)
+  {
+    usage(argv[0], MAP2SVG_VERSION);
+  }
+
+  for (i = 1; i < argc; ++i)
+  {
+    if (!strcmp(argv[i], "-h") || !strcmp(argv[i], "--help"))
+    {
+      usage(argv[0], MAP2SVG_VERSION);
+    }
+    else if (!strcmp(argv[i], "-o") || !strcmp(argv[i], "--output"))
+    {
+      if (++i == argc)
+      {
+        usage(argv[0], MAP2SVG_VERSION);
+      }
+      output = argv[i];
+    }
+    else if (!strcmp(argv[i], "-t") || !strcmp(argv[i], "--tiles"))
+    {
+      if (++i == argc)
+      {
+        usage(argv[0], MAP2SVG_VERSION);
+      }
+      tiles = (u32)strtoul(argv[i], NULL, 10);
+      if (!tiles || tiles > e_map2svg_tiles_max)
+      {
+        usage(argv[0], MAP2SVG_VERSION);
+      }
+    }
+    else if (!strcmp(argv[i], "-l") || !strcmp(argv[i], "--list"))
+    {
+      if (++i == argc)
+      {
+        usage(argv[0], MAP2SVG_VERSION);
+      }
+      filelist_load(&files, argv[i]);
+    }
+    else if (!strcmp(argv[i], "-f") || !strcmp(argv[i], "--force"))
+    {
+      force = 1;
+    }
+    else
+    {
+      filelist_add(&files, argv[i]);
+    }
+  }
+
+  if (!files.count)
+  {
+    usage(argv[0], MAP2SVG_VERSION);
+  }
+
+  if (output && files.count != 1)
+  {
+    fprintf(stderr, "ERROR: --output takes exactly one input file!\n");
+    exit(EXIT_FAILURE);
+  }
+
+  outputbuffer_reserve(&ob, e_map2svg_flush + e_outputbuffer_min_capacity);
+
+  for (; j < files.count; ++j)
+  {
+    map_draw(files.path[j], output, tiles, force, &arena, &ob);
+  }
+
+  outputbuffer_free(&ob);
+  arena_free(&arena);
+  filelist_free(&files);
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,345 @@
+/* SPDX-License-Identifier: MIT */
+/**
+ * @file   mapcache.h
+ * @author Marc-Alexandre Espiaut <ma.dev@espiaut.fr>
+ * @date   2026-03-21
+ * @brief  Persistent cache of mapinfo summaries.
+ *
+ * The cache is one binary file: a header, then fixed-size records sorted
+ * by the XXH64 of the canonical map path, so a map reached through another
+ * working directory or a symbolic link shares its entry; a second hash of
+ * the path with another seed tells apart the paths whose first hashes
+ * collide. Each record holds the stamp of filestamp.h that the map had
+ * when it was summarized, and everything mapinfo prints about it.
+ * The file is mapped as is and searched in place, so a run over unchanged
+ * maps only costs a stat() per map. It is rewritten, through a temporary
+ * file and a rename, only when a map was added or changed.
+ *
+ * Records are in the byte order and layout of the machine that wrote them;
+ * the header tells a foreign or older file apart, which is then ignored.
+ *
+ * @copyright Copyright (c) 2026 Marc-Alexandre Espiaut
+ */
+
+#ifndef MAPCACHE_H
+#define MAPCACHE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "errorcodes.h"
+#include "fileio.h"
+#include "filestamp.h"
+#include "hash.h"
+#include "map.h"
+#include "memorystream.h"
+#include "types.h"
+
+/* The seed of path_check, 2^64 divided by the golden ratio. Built from
+ * halves like the primes of hash.h, C89 has no long long literals. */
+#define MAPCACHE_PATH_SEED (((u64)0x9E3779B9UL << 32) | 0x7F4A7C15UL)
+
+enum
+{
+  e_mapcache_version = 2,
+  e_mapcache_min_capacity = 256
+};
+
+typedef struct MapCacheHeader MapCacheHeader;
+struct MapCacheHeader
+{
+  char magic[8]; /* "MAPCACHE" */
+  u32 version;
+  u32 record_size; /* sizeof(MapCacheRecord), catches another layout */
+  u64 count;
+};
+
+typedef struct MapCacheRecord MapCacheRecord;
+struct MapCacheRecord
+{
+  u64 path_hash;
+  u64 path_check; /* the path hashed with another seed */
+  FileStamp stamp;
+  i32 version;
+  i32 nuke;
+  i32 coop_starts;
+  i32 dukematch_starts;
+  u16 sector_count;
+  u16 wall_count;
+  u16 sprite_count;
+  u16 path_len; /* tells apart most paths whose hashes collide */
+};
+
+typedef struct MapCache MapCache;
+struct MapCache
+{
+  char* path;
+  char* tmp_path;
+  MemoryStream ms; /* the file as found at mapcache_open() */
+  const MapCacheRecord* record; /* sorted, pointing into ms */
+  usize count;
+  MapCacheRecord* fresh; /* summarized during this run */
+  usize fresh_count;
+  usize fresh_capacity;
+};
+
+static const char mapcache_magic[8] = {'M', 'A', 'P', 'C', 'A', 'C', 'H', 'E'};
+
+/* Fills the key of record from the file at path. Returns 0 for anything
+ * but a settled regular file: those are never cached. */
+static INLINE int
+mapcache_key(const char* path, MapCacheRecord* record)
+{
+  char* canonical = NULL;
+  usize len = 0;
+
+  memset(record, 0, sizeof(*record));
+
+  if (!filestamp_get(path, &record->stamp) || !(canonical = filestamp_canonical(path)))
+  {
+    return 0;
+  }
+  len = strlen(canonical);
+
+  record->path_hash = hash_xxh64(canonical, len, 0);
+  record->path_check = hash_xxh64(canonical, len, MAPCACHE_PATH_SEED);
+  record->path_len = (u16)len;
+  free(canonical);
+  return 1;
+}
+
+static INLINE void
+mapcache_record_set(MapCacheRecord* record, const map_t* map, const map_summary_t* summary)
+{
+  record->version = map->version;
+  record->nuke = summary->nuke;
+  record->coop_starts = summary->coop_starts;
+  record->dukematch_starts = summary->dukematch_starts;
+  record->sector_count = map->sector_count;
+  record->wall_count = map->wall_count;
+  record->sprite_count = map->sprite_count;
+}
+
+/* Only the counts of map are filled in, which is all the printers read. */
+static INLINE void
+mapcache_record_get(const MapCacheRecord* record, map_t* map, map_summary_t* summary)
+{
+  map->version = record->version;
+  map->sector_count = record->sector_count;
+  map->wall_count = record->wall_count;
+  map->sprite_count = record->sprite_count;
+  summary->nuke = record->nuke;
+  summary->coop_starts = record->coop_starts;
+  summary->dukematch_starts = record->dukematch_starts;
+}
+
+/* A missing cache is an empty one. A cache that can't be used is ignored
+ * and will be replaced on close. */
+static INLINE void
+mapcache_open(MapCache* cache, const char* path)
+{
+  struct stat st;
+  const MapCacheHeader* header = NULL;
+
+  memset(cache, 0, sizeof(*cache));
+
+  cache->path = malloc(strlen(path) + 1);
+  cache->tmp_path = malloc(strlen(path) + sizeof(".tmp"));
+  if (!cache->path || !cache->tmp_path)
+  {
+    perror("malloc");
+    exit(e_error_malloc);
+  }
+  strcpy(cache->path, path);
+  sprintf(cache->tmp_path, "%s.tmp", path);
+
+  if (stat(path, &st) == -1)
+  {
+    return;
+  }
+
+  memorystream_init(&cache->ms, cache->path);
+  header = (const MapCacheHeader*)cache->ms.data;
+
+  if ((u64)cache->ms.size < sizeof(*header) ||
+      memcmp(header->magic, mapcache_magic, sizeof(mapcache_magic)) ||
+      header->version != e_mapcache_version ||
+      header->record_size != sizeof(MapCacheRecord) ||
+      header->count != ((u64)cache->ms.size - sizeof(*header)) / sizeof(MapCacheRecord) ||
+      ((u64)cache->ms.size - sizeof(*header)) % sizeof(MapCacheRecord))
+  {
+    fprintf(stderr, "WARN: Ignoring %s, it is not a mapinfo cache of this version.\n", path);
+    memorystream_free(&cache->ms);
+    return;
+  }
+
+  cache->record = (const MapCacheRecord*)(cache->ms.data + sizeof(*header));
+  cache->count = (usize)header->count;
+}
+
+/* Returns 1 and completes record when its key matches a cached summary.
+ * Read only, so workers can search concurrently. */
+static INLINE int
+mapcache_find(const MapCache* cache, MapCacheRecord* record)
+{
+  usize low = 0;
+  usize high = cache->count;
+
+  while (low < high)
+  {
+    usize middle = low + (high - low) / 2;
+
+    if (cache->record[middle].path_hash < record->path_hash)
+    {
+      low = middle + 1;
+    }
+    else
+    {
+      high = middle;
+    }
+  }
+
+  if (low == cache->count)
+  {
+    return 0;
+  }
+
+  if (cache->record[low].path_hash != record->path_hash ||
+      cache->record[low].path_check != record->path_check ||
+      cache->record[low].path_len != record->path_len ||
+      !filestamp_equal(&cache->record[low].stamp, &record->stamp))
+  {
+    return 0;
+  }
+
+  *record = cache->record[low];
+  return 1;
+}
+
+static INLINE void
+mapcache_add(MapCache* cache, const MapCacheRecord* record)
+{
+  if (cache->fresh_count == cache->fresh_capacity)
+  {
+    usize capacity = cache->fresh_capacity ? cache->fresh_capacity * 2 : e_mapcache_min_capacity;
+    MapCacheRecord* fresh = realloc(cache->fresh, capacity * sizeof(*fresh));
+
+    if (!fresh)
+    {
+      perror("realloc");
+      exit(e_error_malloc);
+    }
+
+    cache->fresh = fresh;
+    cache->fresh_capacity = capacity;
+  }
+
+  cache->fresh[cache->fresh_count++] = *record;
+}
+
+static INLINE int
+mapcache_record_compare(const void* a, const void* b)
+{
+  const MapCacheRecord* x = a;
+  const MapCacheRecord* y = b;
+
+  return x->path_hash < y->path_hash ? -1 : x->path_hash > y->path_hash;
+}
+
+static INLINE void
+mapcache_write(FILE* fp, const void* src, usize size)
+{
+  if (fwrite(src, 1, size, fp) != size)
+  {
+    perror("fwrite");
+    exit(e_error_fwrite);
+  }
+}
+
+/* Moves the cache file over the old one. The old mapping must be gone by
+ * then, Windows won't replace a mapped file. */
+static INLINE void
+mapcache_commit(MapCache* cache)
+{
+  fileio_replace(cache->tmp_path, cache->path);
+}
+
+/* Merges the fresh summaries into the cached ones, replacing those of the
+ * same path, and writes the result back if there was anything new. */
+static INLINE void
+mapcache_close(MapCache* cache)
+{
+  if (cache->fresh_count)
+  {
+    MapCacheHeader header;
+    FILE* fp = fopen(cache->tmp_path, "wb");
+    usize i = 0;
+    usize j = 0;
+    usize n = 0;
+
+    if (!fp)
+    {
+      perror("fopen");
+      exit(e_error_fopen);
+    }
+
+    /* A path given twice was summarized twice, the same way. */
+    qsort(cache->fresh, cache->fresh_count, sizeof(*cache->fresh), mapcache_record_compare);
+    for (i = 0; i < cache->fresh_count; ++i)
+    {
+      if (i + 1 < cache->fresh_count && cache->fresh[i + 1].path_hash == cache->fresh[i].path_hash)
+      {
+        continue;
+      }
+      cache->fresh[n++] = cache->fresh[i];
+    }
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, mapcache_magic, sizeof(mapcache_magic));
+    header.version = e_mapcache_version;
+    header.record_size = sizeof(MapCacheRecord);
+    mapcache_write(fp, &header, sizeof(header));
+
+    for (i = 0; i < cache->count || j < n; ++header.count)
+    {
+      if (j == n || (i < cache->count && cache->record[i].path_hash < cache->fresh[j].path_hash))
+      {
+        mapcache_write(fp, &cache->record[i++], sizeof(MapCacheRecord));
+      }
+      else
+      {
+        if (i < cache->count && cache->record[i].path_hash == cache->fresh[j].path_hash)
+        {
+          ++i;
+        }
+        mapcache_write(fp, &cache->fresh[j++], sizeof(MapCacheRecord));
+      }
+    }
+
+    if (fseek(fp, 0, SEEK_SET) == -1)
+    {
+      perror("fseek");
+      exit(e_error_fseek);
+    }
+    mapcache_write(fp, &header, sizeof(header));
+
+    if (fclose(fp) == EOF)
+    {
+      perror("fclose");
+      exit(e_error_fclose);
+    }
+
+    memorystream_free(&cache->ms);
+    mapcache_commit(cache);
+  }
+
+  memorystream_free(&cache->ms);
+  free(cache->fresh);
+  free(cache->path);
+  free(cache->tmp_path);
+  memset(cache, 0, sizeof(*cache));
+}
+
+#endif /* MAPCACHE_H */
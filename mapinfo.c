@@ -3,109 +3,33 @@
  * @file   mapinfo.c
  * @author Marc-Alexandre Espiaut <ma.dev@espiaut.fr>
  * @date   2026-02-01
- * @version 1.0
+ * @version 1.1
  * @brief  Displays information about a list of MAP files.
  *
  * @copyright Copyright (c) 2026 Marc-Alexandre Espiaut
  */
 
+#if defined(__linux__)
+#define _XOPEN_SOURCE 700 /* pwrite(), posix_memalign() for fileio.h, realpath() for mapcache.h */
+#endif
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include "arena.h"
 #include "errorcodes.h"
+#include "filelist.h"
+#include "map.h"
+#include "mapcache.h"
+#include "mapspatial.h"
 #include "memorystream.h"
+#include "outputbuffer.h"
+#include "stats.h"
+#include "thread.h"
 #include "types.h"
 
-#define MAPINFO_VERSION "1.0"
-
-typedef struct player_s player_t;
-struct player_s
-{
-  vec3_i32_t position;
-  i16 angle;
-};
-
-typedef struct ceilling_floor_s ceilling_floor_t;
-struct ceilling_floor_s
-{
-  i8 shade;
-  i32 height;
-  i16 pic;
-  i16 slope;
-  i16 stat;
-  u8 palette;
-  vec2_u8_t panning;
-};
-
-typedef struct sector_s sector_t;
-struct sector_s
-{
-  i16 wall_ptr;
-  i16 wall_count;
-  ceilling_floor_t ceilling;
-  ceilling_floor_t floor;
-  u8 visibility;
-  u8 filler;
-  u16 lotag;
-  i16 hitag;
-  i16 extra;
-};
-
-typedef struct wall_s wall_t;
-struct wall_s
-{
-  vec2_i32_t position;
-  i16 wall_next_right;
-  i16 wall_next_left;
-  i16 sector_next;
-  i16 stat;
-  i16 pic;
-  i16 pic_over;
-  signed char shade;
-  u8 pal;
-  vec2_u8_t repeat;
-  vec2_u8_t panning;
-  i16 lotag;
-  i16 hitag;
-  i16 extra;
-};
-
-typedef struct sprite_s sprite_t;
-struct sprite_s
-{
-  vec3_i32_t position;
-  i16 stat;
-  i16 pic;
-  signed char shade;
-  u8 pal;
-  u8 clipping_distance;
-  u8 filler;
-  vec2_u8_t repeat;
-  vec2_i8_t offset;
-  i16 sector;
-  i16 status;
-  i16 angle;
-  i16 owner;
-  vec3_i16_t vel;
-  u16 lotag;
-  u16 hitag;
-  i16 extra;
-};
-
-typedef struct map_s map_t;
-struct map_s
-{
-  i32 version;
-  player_t player;
-  i16 sector_start;
-  u16 sector_count;
-  sector_t* sector;
-  u16 wall_count;
-  wall_t* wall;
-  u16 sprite_count;
-  sprite_t* sprite;
-};
+#define MAPINFO_VERSION "1.1"
 
 static void
 usage(char* prgname, char* prgver)
@@ -114,373 +38,699 @@ usage(char* prgname, char* prgver)
   fprintf(stderr, "\n");
   fprintf(stderr, "%s is a tool for displaying informations about Build games maps (.map).\n", prgname);
   fprintf(stderr, "\n");
-  fprintf(stderr, "Usage: %s [files]\n", prgname);
+  fprintf(stderr, "Usage: %s [options] [files]\n", prgname);
   fprintf(stderr, "\n");
   fprintf(stderr, "Options:\n");
   fprintf(stderr, "  -h, --help             Show this help message and exit\n");
+  fprintf(stderr, "  -j, --jobs N           Parse N files in parallel (0: one per CPU)\n");
+  fprintf(stderr, "  -l, --list LIST.TXT    Add files as listed in LIST.TXT (- for stdin)\n");
+  fprintf(stderr, "  -c, --cache FILE       Reuse the summaries of unchanged maps kept in FILE\n");
+  fprintf(stderr, "  --format=FORMAT        Print text (default), jsonl or tsv records\n");
+  fprintf(stderr, "  --counts               Only print the header and the record counts, fast\n");
+  fprintf(stderr, "  --check                Also count the sprites lying outside their sector\n");
+  fprintf(stderr, "  --stats                Print timings and I/O counters to stderr as JSON\n");
   /*
     fprintf(stderr, "  -v, --verbose          Enable verbose output\n");
-    fprintf(stderr, "  -l, --list LIST.TXT    Add files as listed in LIST.TXT\n");
   */
   fprintf(stderr, "\n");
   fprintf(stderr, "Examples:\n");
   fprintf(stderr, "  %s e1l1.map myhouse.map\n", prgname);
+  fprintf(stderr, "  %s -j 0 maps/*.map\n", prgname);
+  fprintf(stderr, "  find maps -name '*.map' -print0 | %s -j 0 -l -\n", prgname);
+  fprintf(stderr, "  %s --format=jsonl maps/*.map > maps.jsonl\n", prgname);
+  fprintf(stderr, "  %s -c maps.cache -j 0 maps/*.map\n", prgname);
+  fprintf(stderr, "  %s --check --format=tsv maps/*.map\n", prgname);
   exit(EXIT_FAILURE);
 }
 
+/*
 static void
-sector_parse(MemoryStream* ms, sector_t* sector)
+sector_print(sector_t s)
 {
-  memorystream_read(ms, &sector->wall_ptr, sizeof(sector->wall_ptr));
-  memorystream_read(ms, &sector->wall_count, sizeof(sector->wall_count));
+  printf("[sector] wall_ptr: %d, wall_count: %d, ceilling (shade: %d, height: %d, pic: %d, slope: %d, stat: %d, palette: %d, panning: (%d, %d)), floor (shade: %d, height: %d, pic: %d, slope: %d, stat: %d, palette: %d, panning: (%d, %d)), visibility: %d, filler: %d, lotag: %d, hitag: %d, extra: %d\n", s.wall_ptr, s.wall_count, s.ceilling.shade, s.ceilling.height, s.ceilling.pic, s.ceilling.slope, s.ceilling.stat, s.ceilling.palette, s.ceilling.panning.x, s.ceilling.panning.y, s.floor.shade, s.floor.height, s.floor.pic, s.floor.slope, s.floor.stat, s.floor.palette, s.floor.panning.x, s.floor.panning.y, s.visibility, s.filler, s.lotag, s.hitag, s.extra);
+}
 
-  memorystream_read(ms, &sector->ceilling.height, sizeof(sector->ceilling.height));
-  memorystream_read(ms, &sector->floor.height, sizeof(sector->floor.height));
+static void
+sprite_print(sprite_t s)
+{
+  printf("pic: %d, (%d, %d, %d), %d, stat:%d, shade: %d, pal: %d, clipping_distance: %d, filler: %d, repeat: (%d, %d), offset: (%d, %d), sector: %d, status: %d, owner: %d, vel: (%d, %d, %d), lotag: %d, hitag: %d, extra: %d\n", s.pic, s.position.x, s.position.y, s.position.z, s.angle, s.stat, s.shade, s.pal, s.clipping_distance, s.filler, s.repeat.x, s.repeat.y, s.offset.x, s.offset.y, s.sector, s.status, s.owner, s.vel.x, s.vel.y, s.vel.z, s.lotag, s.hitag, s.extra);
+}
 
-  memorystream_read(ms, &sector->ceilling.stat, sizeof(sector->ceilling.stat));
-  memorystream_read(ms, &sector->floor.stat, sizeof(sector->floor.stat));
+static void
+wall_print(wall_t w)
+{
+  printf("[wall] position: (%d, %d), wall_next_right: %d, wall_next_left: %d, sector_next: %d, stat: %d, pic: %d, pic_over: %d, shade: %d, pal: %d, repeat: (%d, %d), panning: (%d, %d), lotag: %d, hitag: %d, extra: %d\n", w.position.x, w.position.y, w.wall_next_right, w.wall_next_left, w.sector_next, w.stat, w.pic, w.pic_over, w.shade, w.pal, w.repeat.x, w.repeat.y, w.panning.x, w.panning.y, w.lotag, w.hitag, w.extra);
+}
+*/
 
-  memorystream_read(ms, &sector->ceilling.pic, sizeof(sector->ceilling.pic));
-  memorystream_read(ms, &sector->ceilling.slope, sizeof(sector->ceilling.slope));
-  memorystream_read(ms, &sector->ceilling.shade, sizeof(sector->ceilling.shade));
-  memorystream_read(ms, &sector->ceilling.palette, sizeof(sector->ceilling.palette));
-  memorystream_read(ms, &sector->ceilling.panning.x, sizeof(sector->ceilling.panning.x));
-  memorystream_read(ms, &sector->ceilling.panning.y, sizeof(sector->ceilling.panning.y));
+static char*
+is_single_player(map_summary_t* summary)
+{
+  switch (summary->nuke)
+  {
+    case e_nuke_unknown:
+      return "Yes (\?\?)";
+      break;
+    case e_nuke_fry:
+      return "Yes (\"We're gonna fry your ass, Nukem!\")";
+      break;
+    case e_nuke_normal:
+      return "Yes (Normal nuke button)";
+      break;
+    case e_nuke_secret:
+      return "Yes (Secret level exit)";
+      break;
+    default:
+      return "No";
+      break;
+  }
+}
 
-  memorystream_read(ms, &sector->floor.pic, sizeof(sector->floor.pic));
-  memorystream_read(ms, &sector->floor.slope, sizeof(sector->floor.slope));
-  memorystream_read(ms, &sector->floor.shade, sizeof(sector->floor.shade));
-  memorystream_read(ms, &sector->floor.palette, sizeof(sector->floor.palette));
-  memorystream_read(ms, &sector->floor.panning.x, sizeof(sector->floor.panning.x));
-  memorystream_read(ms, &sector->floor.panning.y, sizeof(sector->floor.panning.y));
+static char*
+is_dukematch(map_summary_t* summary, char* buffer)
+{
+  if (summary->dukematch_starts)
+  {
+    snprintf(buffer, 256, "Yes (%d players)", summary->dukematch_starts + 1);
+    return buffer;
+  }
+  else
+  {
+    return "No";
+  }
+}
 
-  memorystream_read(ms, &sector->visibility, sizeof(sector->visibility));
+static char*
+is_coop(map_summary_t* summary, char* buffer)
+{
+  if (summary->coop_starts)
+  {
+    snprintf(buffer, 256, "Yes (%d players)", summary->coop_starts + 1);
+    return buffer;
+  }
+  else
+  {
+    return "No";
+  }
+}
 
-  memorystream_read(ms, &sector->filler, sizeof(sector->filler));
+static char*
+is_vanilla_compatible(map_t* map)
+{
+  if ((map->sector_count <= 1024) && (map->wall_count <= 8192) && (map->sprite_count <= 4096))
+  {
+    return "Yes";
+  }
+  else
+  {
+    return "No";
+  }
+}
 
-  memorystream_read(ms, &sector->lotag, sizeof(sector->lotag));
-  memorystream_read(ms, &sector->hitag, sizeof(sector->hitag));
-  memorystream_read(ms, &sector->extra, sizeof(sector->extra));
+static const char*
+nuke_name(i32 nuke)
+{
+  switch (nuke)
+  {
+    case e_nuke_unknown:
+      return "unknown";
+      break;
+    case e_nuke_fry:
+      return "fry";
+      break;
+    case e_nuke_normal:
+      return "normal";
+      break;
+    case e_nuke_secret:
+      return "secret";
+      break;
+    default:
+      return "none";
+      break;
+  }
 }
 
 static void
-wall_parse(MemoryStream* ms, wall_t* wall)
+map_print(map_t* map, map_summary_t* summary, char* path, OutputBuffer* out)
 {
-  memorystream_read(ms, &wall->position.x, sizeof(wall->position.x));
-  memorystream_read(ms, &wall->position.y, sizeof(wall->position.y));
+  char buffer[256] = {'\0'};
+  outputbuffer_printf(out, "Filename: %s\n", path);
+  outputbuffer_printf(out, "MAP version: %d\n", map->version);
+  outputbuffer_printf(out, "Single Player: %s\n", is_single_player(summary)); /* Yes/No */
+  outputbuffer_printf(out, "Cooperative 2-8 Player: %s\n", is_coop(summary, buffer)); /* Yes (x players) */
+  outputbuffer_printf(out, "DukeMatch 2-8 Player: %s\n", is_dukematch(summary, buffer)); /* Yes (x players) */
+  outputbuffer_printf(out, "Atomic Edition Required: \n"); /* Yes/No */
+  outputbuffer_printf(out, "New Art: \n"); /* Yes/No */
+  outputbuffer_printf(out, "Vanilla DUKE3D.EXE compatible: %s (%d sectors, %d walls, %d sprites)\n", is_vanilla_compatible(map), map->sector_count, map->wall_count, map->sprite_count); /* Yes (x sectors, x walls, x sprites)*/
+  if (summary->misplaced_sprites >= 0)
+  {
+    outputbuffer_printf(out, "Sprites outside their sector: %d\n", summary->misplaced_sprites);
+  }
+  outputbuffer_printf(out, "\n");
+}
 
-  memorystream_read(ms, &wall->wall_next_right, sizeof(wall->wall_next_right));
-  memorystream_read(ms, &wall->wall_next_left, sizeof(wall->wall_next_left));
+/* Player counts are 0 when the mode isn't supported, like "No" above. */
+static void
+map_print_jsonl(map_t* map, map_summary_t* summary, char* path, OutputBuffer* out)
+{
+  outputbuffer_printf(out, "{\"path\": ");
+  outputbuffer_json_string(out, path, strlen(path));
+  outputbuffer_printf(out, ", \"version\": %d, \"nuke\": \"%s\", \"coop_players\": %d, \"dukematch_players\": %d, \"vanilla\": %s, \"sectors\": %d, \"walls\": %d, \"sprites\": %d",
+                      map->version,
+                      nuke_name(summary->nuke),
+                      summary->coop_starts ? summary->coop_starts + 1 : 0,
+                      summary->dukematch_starts ? summary->dukematch_starts + 1 : 0,
+                      is_vanilla_compatible(map)[0] == 'Y' ? "true" : "false",
+                      map->sector_count,
+                      map->wall_count,
+                      map->sprite_count);
+  if (summary->misplaced_sprites >= 0)
+  {
+    outputbuffer_printf(out, ", \"misplaced_sprites\": %d", summary->misplaced_sprites);
+  }
+  outputbuffer_printf(out, "}\n");
+}
 
-  memorystream_read(ms, &wall->sector_next, sizeof(wall->sector_next));
+static const char map_tsv_header[] = "path\tversion\tnuke\tcoop_players\tdukematch_players\tvanilla\tsectors\twalls\tsprites\n";
+static const char map_check_tsv_header[] = "path\tversion\tnuke\tcoop_players\tdukematch_players\tvanilla\tsectors\twalls\tsprites\tmisplaced_sprites\n";
 
-  memorystream_read(ms, &wall->stat, sizeof(wall->stat));
+static void
+map_print_tsv(map_t* map, map_summary_t* summary, char* path, OutputBuffer* out)
+{
+  outputbuffer_tsv_field(out, path, strlen(path));
+  outputbuffer_printf(out, "\t%d\t%s\t%d\t%d\t%d\t%d\t%d\t%d",
+                      map->version,
+                      nuke_name(summary->nuke),
+                      summary->coop_starts ? summary->coop_starts + 1 : 0,
+                      summary->dukematch_starts ? summary->dukematch_starts + 1 : 0,
+                      is_vanilla_compatible(map)[0] == 'Y',
+                      map->sector_count,
+                      map->wall_count,
+                      map->sprite_count);
+  if (summary->misplaced_sprites >= 0)
+  {
+    outputbuffer_printf(out, "\t%d", summary->misplaced_sprites);
+  }
+  outputbuffer_printf(out, "\n");
+}
 
-  memorystream_read(ms, &wall->pic, sizeof(wall->pic));
-  memorystream_read(ms, &wall->pic_over, sizeof(wall->pic_over));
+/* The --counts report: what the header and the lump counts tell. */
+static void
+map_print_counts(map_t* map, char* path, OutputBuffer* out)
+{
+  outputbuffer_printf(out, "Filename: %s\n", path);
+  outputbuffer_printf(out, "MAP version: %d\n", map->version);
+  outputbuffer_printf(out, "Player start: (%d, %d, %d), angle %d, sector %d\n", map->player.position.x, map->player.position.y, map->player.position.z, map->player.angle, map->sector_start);
+  outputbuffer_printf(out, "Vanilla DUKE3D.EXE compatible: %s (%d sectors, %d walls, %d sprites)\n\n", is_vanilla_compatible(map), map->sector_count, map->wall_count, map->sprite_count);
+}
 
-  memorystream_read(ms, &wall->shade, sizeof(wall->shade));
-  memorystream_read(ms, &wall->pal, sizeof(wall->pal));
+static void
+map_print_counts_jsonl(map_t* map, char* path, OutputBuffer* out)
+{
+  outputbuffer_printf(out, "{\"path\": ");
+  outputbuffer_json_string(out, path, strlen(path));
+  outputbuffer_printf(out, ", \"version\": %d, \"player\": {\"x\": %d, \"y\": %d, \"z\": %d, \"angle\": %d, \"sector\": %d}, \"vanilla\": %s, \"sectors\": %d, \"walls\": %d, \"sprites\": %d}\n",
+                      map->version,
+                      map->player.position.x,
+                      map->player.position.y,
+                      map->player.position.z,
+                      map->player.angle,
+                      map->sector_start,
+                      is_vanilla_compatible(map)[0] == 'Y' ? "true" : "false",
+                      map->sector_count,
+                      map->wall_count,
+                      map->sprite_count);
+}
 
-  memorystream_read(ms, &wall->repeat.x, sizeof(wall->repeat.x));
-  memorystream_read(ms, &wall->repeat.y, sizeof(wall->repeat.y));
+static const char map_counts_tsv_header[] = "path\tversion\tplayer_x\tplayer_y\tplayer_z\tplayer_angle\tplayer_sector\tvanilla\tsectors\twalls\tsprites\n";
 
-  memorystream_read(ms, &wall->panning.x, sizeof(wall->panning.x));
-  memorystream_read(ms, &wall->panning.y, sizeof(wall->panning.y));
+static void
+map_print_counts_tsv(map_t* map, char* path, OutputBuffer* out)
+{
+  outputbuffer_tsv_field(out, path, strlen(path));
+  outputbuffer_printf(out, "\t%d\t%d\t%d\t%d\t%d\t%d\t%d\t%d\t%d\t%d\n",
+                      map->version,
+                      map->player.position.x,
+                      map->player.position.y,
+                      map->player.position.z,
+                      map->player.angle,
+                      map->sector_start,
+                      is_vanilla_compatible(map)[0] == 'Y',
+                      map->sector_count,
+                      map->wall_count,
+                      map->sprite_count);
+}
+
+/* Sprites naming a sector that doesn't exist or doesn't contain their
+ * (x, y), as the engine's inside() sees it. Sectors may overlap, so only
+ * the named one is tested, which takes its box but not the grid. */
+static i32
+map_sprites_misplaced(const map_t* map)
+{
+  MapSpatial spatial;
+  i32 misplaced = 0;
+  usize i = 0;
+
+  mapspatial_boxes(&spatial, map);
 
-  memorystream_read(ms, &wall->lotag, sizeof(wall->lotag));
-  memorystream_read(ms, &wall->hitag, sizeof(wall->hitag));
-  memorystream_read(ms, &wall->extra, sizeof(wall->extra));
+  for (; i < map->sprite_count; ++i)
+  {
+    const sprite_t* sprite = &map->sprite[i];
+
+    if (sprite->sector < 0 || sprite->sector >= map->sector_count ||
+        !mapspatial_sector_contains(&spatial, (u32)sprite->sector, sprite->position.x, sprite->position.y))
+    {
+      ++misplaced;
+    }
+  }
+
+  mapspatial_free(&spatial);
+  return misplaced;
 }
 
 static void
-sprite_parse(MemoryStream* ms, sprite_t* sprite)
+map_report(map_t* map, map_summary_t* summary, char* path, OutputBuffer* out, int format, int counts)
 {
-  memorystream_read(ms, &sprite->position.x, sizeof(sprite->position.x));
-  memorystream_read(ms, &sprite->position.y, sizeof(sprite->position.y));
-  memorystream_read(ms, &sprite->position.z, sizeof(sprite->position.z));
-
-  memorystream_read(ms, &sprite->stat, sizeof(sprite->stat));
+  if (counts)
+  {
+    switch (format)
+    {
+      case e_format_jsonl:
+        map_print_counts_jsonl(map, path, out);
+        break;
+      case e_format_tsv:
+        map_print_counts_tsv(map, path, out);
+        break;
+      default:
+        map_print_counts(map, path, out);
+        break;
+    }
+    return;
+  }
 
-  memorystream_read(ms, &sprite->pic, sizeof(sprite->pic));
-  memorystream_read(ms, &sprite->shade, sizeof(sprite->shade));
-  memorystream_read(ms, &sprite->pal, sizeof(sprite->pal));
+  switch (format)
+  {
+    case e_format_jsonl:
+      map_print_jsonl(map, summary, path, out);
+      break;
+    case e_format_tsv:
+      map_print_tsv(map, summary, path, out);
+      break;
+    default:
+      map_print(map, summary, path, out);
+      break;
+  }
+}
 
-  memorystream_read(ms, &sprite->clipping_distance, sizeof(sprite->clipping_distance));
+/* With a cache, record gets the summary of path. Returns 1 when it was
+ * computed rather than found, and should go into the cache.
+ *
+ * Only the lumps the report reads are decoded: none for --counts, the
+ * sectors and sprites otherwise. The walls are stepped over unless
+ * --check needs them too. */
+static int
+map_info(char* path, MemoryStream* ms, Arena* arena, OutputBuffer* out, int format, int counts, int check, const MapCache* cache, MapCacheRecord* record, Stats* stats)
+{
+  map_t map = {0};
+  map_summary_t summary = {0};
+  usize arena_capacity = arena->capacity;
+  usize out_capacity = out->capacity;
+  u64 begin = stats_begin(stats);
+  u64 size = 0;
+  int heap = 0;
+  int cached = 0;
+  int fresh = 0;
+
+  ms->syscalls = 0;
+
+  if (cache && mapcache_key(path, record))
+  {
+    ++ms->syscalls; /* stat */
+    cached = mapcache_find(cache, record);
+    fresh = !cached;
+  }
 
-  memorystream_read(ms, &sprite->filler, sizeof(sprite->filler));
+  if (cached)
+  {
+    mapcache_record_get(record, &map, &summary);
+    summary.misplaced_sprites = -1;
+    stats_end(stats, e_stats_open, begin);
+  }
+  else
+  {
+    u32 syscalls = ms->syscalls;
 
-  memorystream_read(ms, &sprite->repeat.x, sizeof(sprite->repeat.x));
-  memorystream_read(ms, &sprite->repeat.y, sizeof(sprite->repeat.y));
+    memorystream_init(ms, path);
+    ms->syscalls += syscalls;
+    size = (u64)ms->size;
+    heap = !ms->mapped && ms->size;
+    stats_end(stats, e_stats_open, begin);
 
-  memorystream_read(ms, &sprite->offset.x, sizeof(sprite->offset.x));
-  memorystream_read(ms, &sprite->offset.y, sizeof(sprite->offset.y));
+    begin = stats_begin(stats);
+    map_parse_lumps(ms, &map, arena, counts ? 0 : check ? e_map_lump_all : e_map_lump_sector | e_map_lump_sprite);
+    memorystream_free(ms);
+    stats_end(stats, e_stats_parse, begin);
 
-  memorystream_read(ms, &sprite->sector, sizeof(sprite->sector));
-  memorystream_read(ms, &sprite->status, sizeof(sprite->status));
+    if (!counts)
+    {
+      begin = stats_begin(stats);
+      map_analyze(&map, &summary);
+      summary.misplaced_sprites = check ? map_sprites_misplaced(&map) : -1;
+      stats_end(stats, e_stats_analyze, begin);
+    }
 
-  memorystream_read(ms, &sprite->angle, sizeof(sprite->angle));
+    if (fresh)
+    {
+      mapcache_record_set(record, &map, &summary);
+    }
+  }
 
-  memorystream_read(ms, &sprite->owner, sizeof(sprite->owner));
+  begin = stats_begin(stats);
+  map_report(&map, &summary, path, out, format, counts);
+  stats_end(stats, e_stats_print, begin);
 
-  memorystream_read(ms, &sprite->vel.x, sizeof(sprite->vel.x));
-  memorystream_read(ms, &sprite->vel.y, sizeof(sprite->vel.y));
-  memorystream_read(ms, &sprite->vel.z, sizeof(sprite->vel.z));
+  stats_io(stats, size, 0, ms->syscalls);
+  stats_alloc(stats, (u64)heap + (arena->capacity != arena_capacity) + (out->capacity != out_capacity));
+  arena_reset(arena);
 
-  memorystream_read(ms, &sprite->lotag, sizeof(sprite->lotag));
-  memorystream_read(ms, &sprite->hitag, sizeof(sprite->hitag));
-  memorystream_read(ms, &sprite->extra, sizeof(sprite->extra));
+  return fresh;
 }
 
+/* Flushing is part of printing; stdio turns it into about one write. */
 static void
-map_parse(MemoryStream* ms, map_t* map)
+map_flush(OutputBuffer* out, Stats* stats)
 {
-  memorystream_read(ms, &map->version, sizeof(map->version));
+  u64 begin = stats_begin(stats);
+  u64 size = out->size;
 
-  memorystream_read(ms, &map->player.position.x, sizeof(map->player.position.x));
-  memorystream_read(ms, &map->player.position.y, sizeof(map->player.position.y));
-  memorystream_read(ms, &map->player.position.z, sizeof(map->player.position.z));
-  memorystream_read(ms, &map->player.angle, sizeof(map->player.angle));
+  if (!size)
+  {
+    return;
+  }
+
+  outputbuffer_flush(out, stdout);
+  stats_end(stats, e_stats_print, begin);
+  stats_io(stats, 0, size, 1);
+}
 
-  memorystream_read(ms, &map->sector_start, sizeof(map->sector_start));
+/* One output slot per input file. Workers fill slots in any order; the
+ * main thread prints them in argument order as soon as they are done. */
+typedef struct job_s job_t;
+struct job_s
+{
+  char* path;
+  OutputBuffer out;
+  MapCacheRecord record;
+  int fresh; /* record goes into the cache */
+  int done;
+};
+
+typedef struct batch_s batch_t;
+struct batch_s
+{
+  job_t* job;
+  usize count;
+  usize next; /* first job not yet claimed by a worker */
+  usize printed; /* first job not yet printed */
+  usize window; /* how far workers may run ahead of the printer */
+  int format;
+  int counts;
+  int check;
+  const MapCache* cache; /* NULL without --cache */
+  Stats* stats; /* totals the workers merge into, NULL without --stats */
+  Mutex lock;
+  Condition progress;
+};
 
-  memorystream_read(ms, &map->sector_count, sizeof(map->sector_count));
+static void
+map_worker(void* arg)
+{
+  batch_t* batch = arg;
+  MemoryStream ms = {0};
+  Arena arena = {0};
+  Stats stats = {0};
 
-  map->sector = malloc(sizeof(*map->sector) * map->sector_count);
-  if (map->sector)
+  for (;;)
   {
-    size_t i = 0;
-    for (; i < map->sector_count; ++i)
+    job_t* job = NULL;
+
+    mutex_lock(&batch->lock);
+    while (batch->next < batch->count && batch->next - batch->printed >= batch->window)
+    {
+      condition_wait(&batch->progress, &batch->lock);
+    }
+    if (batch->next < batch->count)
+    {
+      job = &batch->job[batch->next++];
+    }
+    mutex_unlock(&batch->lock);
+
+    if (!job)
     {
-      sector_parse(ms, &map->sector[i]);
+      break;
     }
+
+    job->fresh = map_info(job->path, &ms, &arena, &job->out, batch->format, batch->counts, batch->check, batch->cache, &job->record, batch->stats ? &stats : NULL);
+
+    mutex_lock(&batch->lock);
+    job->done = 1;
+    condition_broadcast(&batch->progress);
+    mutex_unlock(&batch->lock);
   }
-  else
+
+  if (batch->stats)
   {
-    perror("malloc");
+    mutex_lock(&batch->lock);
+    stats_merge(batch->stats, &stats);
+    mutex_unlock(&batch->lock);
+  }
+
+  arena_free(&arena);
+}
+
+/* The cache is only searched by the workers; the main thread adds the
+ * fresh summaries as it prints them. */
+static void
+map_info_parallel(char* path[], usize n, u32 jobs, int format, int counts, int check, MapCache* cache, Stats* stats)
+{
+  batch_t batch = {0};
+  Thread* thread = NULL;
+  u32 i = 0;
+
+  batch.job = calloc(n, sizeof(*batch.job));
+  thread = calloc(jobs, sizeof(*thread));
+  if (!batch.job || !thread)
+  {
+    perror("calloc");
     exit(e_error_malloc);
   }
 
-  memorystream_read(ms, &map->wall_count, sizeof(map->wall_count));
-  map->wall = malloc(sizeof(*map->wall) * map->wall_count);
-  if (map->wall)
+  for (; i < n; ++i)
   {
-    size_t i = 0;
-    for (; i < map->wall_count; ++i)
-    {
-      wall_parse(ms, &map->wall[i]);
-    }
+    batch.job[i].path = path[i];
   }
-  else
+  batch.count = n;
+  batch.window = (usize)jobs * 16;
+  batch.format = format;
+  batch.counts = counts;
+  batch.check = check;
+  batch.cache = cache;
+  batch.stats = stats;
+  mutex_init(&batch.lock);
+  condition_init(&batch.progress);
+
+  for (i = 0; i < jobs; ++i)
   {
-    perror("malloc");
-    exit(e_error_malloc);
+    thread_create(&thread[i], map_worker, &batch);
   }
 
-  memorystream_read(ms, &map->sprite_count, sizeof(map->sprite_count));
-  map->sprite = malloc(sizeof(*map->sprite) * map->sprite_count);
-  if (map->sprite)
+  mutex_lock(&batch.lock);
+  while (batch.printed < batch.count)
   {
-    size_t i = 0;
-    for (; i < map->sprite_count; ++i)
+    job_t* job = &batch.job[batch.printed];
+
+    while (!job->done)
     {
-      sprite_parse(ms, &map->sprite[i]);
+      condition_wait(&batch.progress, &batch.lock);
     }
+    mutex_unlock(&batch.lock);
+
+    map_flush(&job->out, stats);
+    outputbuffer_free(&job->out);
+    if (job->fresh)
+    {
+      mapcache_add(cache, &job->record);
+    }
+
+    mutex_lock(&batch.lock);
+    ++batch.printed;
+    condition_broadcast(&batch.progress);
   }
-  else
+  mutex_unlock(&batch.lock);
+
+  for (i = 0; i < jobs; ++i)
   {
-    perror("malloc");
-    exit(e_error_malloc);
+    thread_join(thread[i]);
   }
-}
-
-/*
-static void
-sector_print(sector_t s)
-{
-  printf("[sector] wall_ptr: %d, wall_count: %d, ceilling (shade: %d, height: %d, pic: %d, slope: %d, stat: %d, palette: %d, panning: (%d, %d)), floor (shade: %d, height: %d, pic: %d, slope: %d, stat: %d, palette: %d, panning: (%d, %d)), visibility: %d, filler: %d, lotag: %d, hitag: %d, extra: %d\n", s.wall_ptr, s.wall_count, s.ceilling.shade, s.ceilling.height, s.ceilling.pic, s.ceilling.slope, s.ceilling.stat, s.ceilling.palette, s.ceilling.panning.x, s.ceilling.panning.y, s.floor.shade, s.floor.height, s.floor.pic, s.floor.slope, s.floor.stat, s.floor.palette, s.floor.panning.x, s.floor.panning.y, s.visibility, s.filler, s.lotag, s.hitag, s.extra);
-}
 
-static void
-sprite_print(sprite_t s)
-{
-  printf("pic: %d, (%d, %d, %d), %d, stat:%d, shade: %d, pal: %d, clipping_distance: %d, filler: %d, repeat: (%d, %d), offset: (%d, %d), sector: %d, status: %d, owner: %d, vel: (%d, %d, %d), lotag: %d, hitag: %d, extra: %d\n", s.pic, s.position.x, s.position.y, s.position.z, s.angle, s.stat, s.shade, s.pal, s.clipping_distance, s.filler, s.repeat.x, s.repeat.y, s.offset.x, s.offset.y, s.sector, s.status, s.owner, s.vel.x, s.vel.y, s.vel.z, s.lotag, s.hitag, s.extra);
+  condition_destroy(&batch.progress);
+  mutex_destroy(&batch.lock);
+  free(thread);
+  free(batch.job);
 }
 
-static void
-wall_print(wall_t w)
+int
+main(int argc, char* argv[])
 {
-  printf("[wall] position: (%d, %d), wall_next_right: %d, wall_next_left: %d, sector_next: %d, stat: %d, pic: %d, pic_over: %d, shade: %d, pal: %d, repeat: (%d, %d), panning: (%d, %d), lotag: %d, hitag: %d, extra: %d\n", w.position.x, w.position.y, w.wall_next_right, w.wall_next_left, w.sector_next, w.stat, w.pic, w.pic_over, w.shade, w.pal, w.repeat.x, w.repeat.y, w.panning.x, w.panning.y, w.lotag, w.hitag, w.extra);
-}
-*/
+  FileList files = {0};
+  MapCache cache = {0};
+  char* cache_path = NULL;
+  Stats stats = {0};
+  int stats_enabled = 0;
+  int format = e_format_text;
+  int counts = 0;
+  int check = 0;
+  u32 jobs = 1;
+  i32 i;
 
-static char*
-is_single_player(map_t* map)
-{
-  size_t i = 0;
+  if (argc < 2)
+  {
+    usage(argv[0], MAPINFO_VERSION);
+  }
 
-  for (; i < map->sprite_count; ++i)
+  for (i = 1; i < argc; ++i)
   {
-    if (map->sprite[i].pic == 142)
+    if (!strcmp(argv[i], "-h") || !strcmp(argv[i], "--help"))
     {
-      /*sprite_print(&map->sprite[i]);*/
-
-      if (map->sprite[i].lotag == 32767)
+      usage(argv[0], MAPINFO_VERSION);
+    }
+    else if (!strcmp(argv[i], "-j") || !strcmp(argv[i], "--jobs"))
+    {
+      if (++i == argc)
       {
-        return "Yes (\?\?)";
+        usage(argv[0], MAPINFO_VERSION);
       }
-      if (map->sprite[i].lotag == 65534)
+      jobs = (u32)strtoul(argv[i], NULL, 10);
+      if (!jobs)
       {
-        return "Yes (\"We're gonna fry your ass, Nukem!\")";
+        jobs = thread_cpu_count();
       }
-      if (map->sprite[i].lotag == 65535)
+    }
+    else if (!strcmp(argv[i], "-l") || !strcmp(argv[i], "--list"))
+    {
+      if (++i == argc)
       {
-        return "Yes (Normal nuke button)";
+        usage(argv[0], MAPINFO_VERSION);
       }
-      if (map->sprite[i].pal == 14) /* NUKEBUTTON */
+      filelist_load(&files, argv[i]);
+    }
+    else if (!strcmp(argv[i], "-c") || !strcmp(argv[i], "--cache"))
+    {
+      if (++i == argc)
       {
-        return "Yes (Secret level exit)";
+        usage(argv[0], MAPINFO_VERSION);
       }
+      cache_path = argv[i];
     }
-  }
-
-  for (i = 0; i < map->sector_count; ++i)
-  {
-    if (map->sector[i].lotag == 32767)
+    else if (!strcmp(argv[i], "--counts"))
     {
-      return "Yes (\?\?)";
+      counts = 1;
     }
-    if (map->sector[i].lotag == 65534)
+    else if (!strcmp(argv[i], "--check"))
     {
-      return "Yes (\"We're gonna fry your ass, Nukem!\")";
+      check = 1;
     }
-    if (map->sector[i].lotag == 65535)
+    else if (!strcmp(argv[i], "--stats"))
     {
-      return "Yes (Normal nuke button)";
+      stats_enabled = 1;
     }
-  }
-
-  /*
-  i = 0;
-  for (; i < map->sector_count; ++i)
-  {
-    sector_print(map->sector[i]);
-  }
-  */
-  return "No";
-}
-
-static char*
-is_dukematch(map_t* map, char* buffer)
-{
-  i32 result = 0;
-
-  {
-    size_t i = 0;
-    for (; i < map->sprite_count; ++i)
+    else if (!strncmp(argv[i], "--format=", 9) || !strcmp(argv[i], "--format"))
     {
-      if ((map->sprite[i].pic == 1405) /* APLAYER */ && (map->sprite[i].lotag == 0))
+      format = outputbuffer_format_option(argc, argv, &i);
+      if (format < 0)
       {
-        ++result;
+        usage(argv[0], MAPINFO_VERSION);
       }
     }
+    else
+    {
+      filelist_add(&files, argv[i]);
+    }
   }
 
-  if (result)
+  if (jobs > files.count)
   {
-    snprintf(buffer, 256, "Yes (%d players)", result + 1);
-    return buffer;
+    jobs = (u32)files.count;
   }
-  else
-  {
-    return "No";
-  }
-}
 
-static char*
-is_coop(map_t* map, char* buffer)
-{
-  i32 result = 0;
+  stats_init(&stats);
 
+  /* Reading the counts costs about what a cache lookup would, and the
+   * cache doesn't keep the check results. */
+  if (counts || check)
   {
-    size_t i = 0;
-    for (; i < map->sprite_count; ++i)
-    {
-      if ((map->sprite[i].pic == 1405) /* APLAYER */ && (map->sprite[i].lotag == 1))
-      {
-        ++result;
-      }
-    }
+    cache_path = NULL;
   }
 
-  if (result)
-  {
-    snprintf(buffer, 256, "Yes (%d players)", result + 1);
-    return buffer;
-  }
-  else
+  if (cache_path)
   {
-    return "No";
+    mapcache_open(&cache, cache_path);
   }
-}
 
-static char*
-is_vanilla_compatible(map_t* map)
-{
-  if ((map->sector_count <= 1024) && (map->wall_count <= 8192) && (map->sprite_count <= 4096))
+  if (format != e_format_text)
   {
-    return "Yes";
+    /* Records are small and many: hand stdout large chunks instead. */
+    setvbuf(stdout, NULL, _IOFBF, e_outputbuffer_chunk);
   }
-  else
+  if (format == e_format_tsv)
   {
-    return "No";
+    fputs(counts ? map_counts_tsv_header : check ? map_check_tsv_header : map_tsv_header, stdout);
   }
-}
 
-static void
-map_print(map_t* map, char* path)
-{
-  char buffer[256] = {'\0'};
-  printf("Filename: %s\n", path);
-  printf("MAP version: %d\n", map->version);
-  printf("Single Player: %s\n", is_single_player(map)); /* Yes/No */
-  printf("Cooperative 2-8 Player: %s\n", is_coop(map, buffer)); /* Yes (x players) */
-  printf("DukeMatch 2-8 Player: %s\n", is_dukematch(map, buffer)); /* Yes (x players) */
-  printf("Atomic Edition Required: \n"); /* Yes/No */
-  printf("New Art: \n"); /* Yes/No */
-  printf("Vanilla DUKE3D.EXE compatible: %s (%d sectors, %d walls, %d sprites)\n\n", is_vanilla_compatible(map), map->sector_count, map->wall_count, map->sprite_count); /* Yes (x sectors, x walls, x sprites)*/
-}
-
-static void
-map_free(map_t* map)
-{
-  free(map->sprite);
-  free(map->wall);
-  free(map->sector);
-}
-
-int
-main(int argc, char* argv[])
-{
-  if (argc < 2)
+  if (jobs > 1)
   {
-    usage(argv[0], MAPINFO_VERSION);
+    map_info_parallel(files.path, files.count, jobs, format, counts, check, cache_path ? &cache : NULL, stats_enabled ? &stats : NULL);
   }
   else
   {
-    i32 i;
     MemoryStream map_file = {0};
+    Arena arena = {0};
+    OutputBuffer out = {0};
+    MapCacheRecord record;
+    usize j = 0;
 
-    for (i = 1; i < argc; ++i)
+    for (; j < files.count; ++j)
     {
-      map_t map = {0};
-      memorystream_init(&map_file, argv[i]);
-      map_parse(&map_file, &map);
-      memorystream_free(&map_file);
-      map_print(&map, argv[i]);
-      map_free(&map);
+      if (map_info(files.path[j], &map_file, &arena, &out, format, counts, check, cache_path ? &cache : NULL, &record, stats_enabled ? &stats : NULL))
+      {
+        mapcache_add(&cache, &record);
+      }
+
+      /* Prose is flushed per file to stay next to its warnings. */
+      if (format == e_format_text || outputbuffer_full(&out))
+      {
+        map_flush(&out, stats_enabled ? &stats : NULL);
+      }
     }
+    map_flush(&out, stats_enabled ? &stats : NULL);
+    outputbuffer_free(&out);
+    arena_free(&arena);
   }
 
+  if (cache_path)
+  {
+    u64 begin = stats_begin(stats_enabled ? &stats : NULL);
+
+    mapcache_close(&cache);
+    stats_end(stats_enabled ? &stats : NULL, e_stats_commit, begin);
+  }
+
+  if (stats_enabled)
+  {
+    stats_print(&stats, "mapinfo", stderr);
+  }
+
+  filelist_free(&files);
+
   return EXIT_SUCCESS;
 }
@@ -0,0 +1,346 @@
+/* SPDX-License-Identifier: MIT */
+/**
+ * @file   mapspatial.h
+ * @author Marc-Alexandre Espiaut <ma.dev@espiaut.fr>
+ * @date   2026-03-27
+ * @brief  Spatial index over the sectors of a parsed map.
+ *
+ * Each sector gets the bounding box of its walls, and a uniform grid over
+ * the whole map lists, for every cell, the sectors whose boxes overlap
+ * it. The cells are sized so that there are about twice as many as
+ * sectors, which keeps the lists short. Finding what a viewport shows
+ * then only visits the cells under it. Testing a point against a known
+ * sector only needs the boxes, which can be built alone.
+ *
+ * The grid is stored compressed: one offset per cell into a single array
+ * of sector numbers, filled in two passes over the boxes.
+ *
+ * @copyright Copyright (c) 2026 Marc-Alexandre Espiaut
+ */
+
+#ifndef MAPSPATIAL_H
+#define MAPSPATIAL_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "errorcodes.h"
+#include "map.h"
+#include "types.h"
+
+enum
+{
+  e_mapspatial_min_shift = 4, /* cells of at least 16 units */
+  e_mapspatial_max_side = 1024 /* cells along either axis */
+};
+
+typedef struct MapSpatial MapSpatial;
+struct MapSpatial
+{
+  const map_t* map;
+  vec2_i32_t* min; /* per sector, inclusive */
+  vec2_i32_t* max;
+  u8* valid; /* the walls of the sector are all in the wall array */
+  vec2_i32_t origin; /* lowest corner of the grid */
+  u32 shift; /* cells are 1 << shift units wide */
+  u32 columns;
+  u32 rows;
+  u32* cell_start; /* columns * rows + 1 offsets into cell_sector */
+  u16* cell_sector;
+  u32* mark; /* per sector, last query that returned it */
+  u32 query;
+};
+
+static INLINE void*
+mapspatial_alloc(usize n)
+{
+  void* p = calloc(n ? n : 1, 1);
+
+  if (!p)
+  {
+    perror("calloc");
+    exit(e_error_malloc);
+  }
+
+  return p;
+}
+
+/* Whether every wall of sector s, and the wall each one connects to, is
+ * in the wall array. Broken maps exist; their sectors are left out. */
+static INLINE int
+mapspatial_sector_valid(const map_t* map, u32 s)
+{
+  const sector_t* sector = &map->sector[s];
+  i32 i = 0;
+
+  if (sector->wall_ptr < 0 || sector->wall_count <= 0 || (i32)sector->wall_ptr + sector->wall_count > map->wall_count)
+  {
+    return 0;
+  }
+
+  for (; i < sector->wall_count; ++i)
+  {
+    i16 next = map->wall[sector->wall_ptr + i].wall_next_right;
+
+    if (next < 0 || next >= map->wall_count)
+    {
+      return 0;
+    }
+  }
+
+  return 1;
+}
+
+/* Cells of box min-max, clamped to the grid. */
+static INLINE void
+mapspatial_cells(const MapSpatial* spatial, vec2_i32_t min, vec2_i32_t max, u32* x0, u32* y0, u32* x1, u32* y1)
+{
+  i64 ax = ((i64)min.x - spatial->origin.x) >> spatial->shift;
+  i64 ay = ((i64)min.y - spatial->origin.y) >> spatial->shift;
+  i64 bx = ((i64)max.x - spatial->origin.x) >> spatial->shift;
+  i64 by = ((i64)max.y - spatial->origin.y) >> spatial->shift;
+
+  *x0 = ax < 0 ? 0 : ax >= spatial->columns ? spatial->columns - 1 : (u32)ax;
+  *y0 = ay < 0 ? 0 : ay >= spatial->rows ? spatial->rows - 1 : (u32)ay;
+  *x1 = bx < 0 ? 0 : bx >= spatial->columns ? spatial->columns - 1 : (u32)bx;
+  *y1 = by < 0 ? 0 : by >= spatial->rows ? spatial->rows - 1 : (u32)by;
+}
+
+/* Only the per-sector boxes, enough for mapspatial_sector_contains(). The
+ * index points into map and is only good as long as it is. */
+static INLINE void
+mapspatial_boxes(MapSpatial* spatial, const map_t* map)
+{
+  u32 s = 0;
+
+  memset(spatial, 0, sizeof(*spatial));
+  spatial->map = map;
+  spatial->min = mapspatial_alloc(sizeof(*spatial->min) * map->sector_count);
+  spatial->max = mapspatial_alloc(sizeof(*spatial->max) * map->sector_count);
+  spatial->valid = mapspatial_alloc(map->sector_count);
+  spatial->mark = mapspatial_alloc(sizeof(*spatial->mark) * map->sector_count);
+
+  for (; s < map->sector_count; ++s)
+  {
+    const sector_t* sector = &map->sector[s];
+    i32 i = 0;
+
+    if (!mapspatial_sector_valid(map, s))
+    {
+      continue;
+    }
+
+    spatial->valid[s] = 1;
+    spatial->min[s] = spatial->max[s] = map->wall[sector->wall_ptr].position;
+    for (; i < sector->wall_count; ++i)
+    {
+      vec2_i32_t p = map->wall[sector->wall_ptr + i].position;
+
+      spatial->min[s].x = p.x < spatial->min[s].x ? p.x : spatial->min[s].x;
+      spatial->min[s].y = p.y < spatial->min[s].y ? p.y : spatial->min[s].y;
+      spatial->max[s].x = p.x > spatial->max[s].x ? p.x : spatial->max[s].x;
+      spatial->max[s].y = p.y > spatial->max[s].y ? p.y : spatial->max[s].y;
+    }
+  }
+}
+
+/* The boxes and the grid over them, which needs the sectors and walls of
+ * map parsed. The index points into map and is only good as long as it
+ * is. */
+static INLINE void
+mapspatial_build(MapSpatial* spatial, const map_t* map)
+{
+  vec2_i32_t lo;
+  vec2_i32_t hi;
+  u64 target = 0;
+  u32 s = 0;
+  u32 cells = 0;
+  u32 c = 0;
+
+  mapspatial_boxes(spatial, map);
+
+  lo.x = lo.y = 0x7FFFFFFF;
+  hi.x = hi.y = -0x7FFFFFFF - 1;
+
+  for (; s < map->sector_count; ++s)
+  {
+    if (!spatial->valid[s])
+    {
+      continue;
+    }
+
+    lo.x = spatial->min[s].x < lo.x ? spatial->min[s].x : lo.x;
+    lo.y = spatial->min[s].y < lo.y ? spatial->min[s].y : lo.y;
+    hi.x = spatial->max[s].x > hi.x ? spatial->max[s].x : hi.x;
+    hi.y = spatial->max[s].y > hi.y ? spatial->max[s].y : hi.y;
+  }
+
+  if (lo.x > hi.x)
+  {
+    lo.x = lo.y = hi.x = hi.y = 0;
+  }
+
+  /* The smallest cells that keep the grid within twice the sector count
+   * and within the side limit. */
+  target = (u64)map->sector_count * 2 > 64 ? (u64)map->sector_count * 2 : 64;
+  spatial->origin = lo;
+  spatial->shift = e_mapspatial_min_shift;
+  for (;;)
+  {
+    u64 columns = (((u64)((i64)hi.x - lo.x)) >> spatial->shift) + 1;
+    u64 rows = (((u64)((i64)hi.y - lo.y)) >> spatial->shift) + 1;
+
+    if ((columns * rows <= target && columns <= e_mapspatial_max_side && rows <= e_mapspatial_max_side) || spatial->shift == 32)
+    {
+      spatial->columns = (u32)columns;
+      spatial->rows = (u32)rows;
+      break;
+    }
+    ++spatial->shift;
+  }
+
+  /* Counts per cell, then offsets, then the lists themselves; the counts
+   * are carried in the cell after theirs so the offsets come out in
+   * place. */
+  cells = spatial->columns * spatial->rows;
+  spatial->cell_start = mapspatial_alloc(sizeof(*spatial->cell_start) * (cells + 2));
+  for (s = 0; s < map->sector_count; ++s)
+  {
+    u32 x0, y0, x1, y1, x, y;
+
+    if (!spatial->valid[s])
+    {
+      continue;
+    }
+
+    mapspatial_cells(spatial, spatial->min[s], spatial->max[s], &x0, &y0, &x1, &y1);
+    for (y = y0; y <= y1; ++y)
+    {
+      for (x = x0; x <= x1; ++x)
+      {
+        ++spatial->cell_start[y * spatial->columns + x + 2];
+      }
+    }
+  }
+  for (c = 2; c < cells + 2; ++c)
+  {
+    spatial->cell_start[c] += spatial->cell_start[c - 1];
+  }
+
+  spatial->cell_sector = mapspatial_alloc(sizeof(*spatial->cell_sector) * spatial->cell_start[cells + 1]);
+  for (s = 0; s < map->sector_count; ++s)
+  {
+    u32 x0, y0, x1, y1, x, y;
+
+    if (!spatial->valid[s])
+    {
+      continue;
+    }
+
+    mapspatial_cells(spatial, spatial->min[s], spatial->max[s], &x0, &y0, &x1, &y1);
+    for (y = y0; y <= y1; ++y)
+    {
+      for (x = x0; x <= x1; ++x)
+      {
+        spatial->cell_sector[spatial->cell_start[y * spatial->columns + x + 1]++] = (u16)s;
+      }
+    }
+  }
+}
+
+static INLINE void
+mapspatial_free(MapSpatial* spatial)
+{
+  free(spatial->min);
+  free(spatial->max);
+  free(spatial->valid);
+  free(spatial->mark);
+  free(spatial->cell_start);
+  free(spatial->cell_sector);
+  memset(spatial, 0, sizeof(*spatial));
+}
+
+/* The engine's inside(): a ray cast to +x, counting the walls it crosses.
+ * Inner loops of the sector count too, so holes work. The cross product
+ * is done in 64 bits, where the engine's 32 bits could overflow. */
+static INLINE int
+mapspatial_sector_contains(const MapSpatial* spatial, u32 s, i32 x, i32 y)
+{
+  const map_t* map = spatial->map;
+  const sector_t* sector = &map->sector[s];
+  int odd = 0;
+  i32 i = 0;
+
+  if (!spatial->valid[s] || x < spatial->min[s].x || x > spatial->max[s].x || y < spatial->min[s].y || y > spatial->max[s].y)
+  {
+    return 0;
+  }
+
+  for (; i < sector->wall_count; ++i)
+  {
+    const wall_t* a = &map->wall[sector->wall_ptr + i];
+    const wall_t* b = &map->wall[a->wall_next_right];
+    i64 y1 = (i64)a->position.y - y;
+    i64 y2 = (i64)b->position.y - y;
+
+    if ((y1 < 0) != (y2 < 0))
+    {
+      i64 x1 = (i64)a->position.x - x;
+      i64 x2 = (i64)b->position.x - x;
+
+      if ((x1 < 0) == (x2 < 0))
+      {
+        odd ^= x1 < 0;
+      }
+      else
+      {
+        odd ^= (x1 * y2 - x2 * y1 < 0) != (y2 < 0);
+      }
+    }
+  }
+
+  return odd;
+}
+
+/* Writes to out the sectors whose boxes overlap min-max, each once, and
+ * returns how many there are. out needs room for every sector. */
+static INLINE u32
+mapspatial_sectors_in(MapSpatial* spatial, vec2_i32_t min, vec2_i32_t max, u16* out)
+{
+  u32 x0, y0, x1, y1, x, y;
+  u32 n = 0;
+
+  if (!++spatial->query)
+  {
+    memset(spatial->mark, 0, sizeof(*spatial->mark) * spatial->map->sector_count);
+    spatial->query = 1;
+  }
+
+  mapspatial_cells(spatial, min, max, &x0, &y0, &x1, &y1);
+  for (y = y0; y <= y1; ++y)
+  {
+    for (x = x0; x <= x1; ++x)
+    {
+      u32 c = y * spatial->columns + x;
+      u32 i = spatial->cell_start[c];
+
+      for (; i < spatial->cell_start[c + 1]; ++i)
+      {
+        u32 s = spatial->cell_sector[i];
+
+        if (spatial->mark[s] != spatial->query &&
+            spatial->min[s].x <= max.x && spatial->max[s].x >= min.x &&
+            spatial->min[s].y <= max.y && spatial->max[s].y >= min.y)
+        {
+          spatial->mark[s] = spatial->query;
+          out[n++] = (u16)s;
+        }
+      }
+    }
+  }
+
+  return n;
+}
+
+#endif /* MAPSPATIAL_H */
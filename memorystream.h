@@ -11,8 +11,22 @@
 #ifndef MEMORYSTREAM_H
 #define MEMORYSTREAM_H
 
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#define MEMORYSTREAM_MMAP
+#elif defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define MEMORYSTREAM_MMAP
+#endif
+
 #include "errorcodes.h"
 #include "types.h"
 
@@ -29,12 +43,118 @@ struct MemoryStream
   u8* data;
   i64 size;
   i64 position;
+  int mapped; /* data is a read-only file mapping, not a heap copy */
+  u32 syscalls; /* expected since memorystream_init(), an estimate for --stats */
 };
 
-static void
+#if defined(MEMORYSTREAM_MMAP)
+/* Maps the whole file read-only so pages are only faulted in when the
+ * parser touches them. Returns 0 when the file can't be mapped (pipes,
+ * devices, address space exhaustion); the caller then reads it instead. */
+static INLINE int
+memorystream_map(MemoryStream* ms, char* path)
+{
+#if defined(_WIN32)
+  HANDLE file = INVALID_HANDLE_VALUE;
+  HANDLE mapping = NULL;
+  LARGE_INTEGER size;
+
+  file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+  ms->syscalls += 2; /* CreateFileA, GetFileSizeEx */
+  if (file == INVALID_HANDLE_VALUE)
+  {
+    return 0;
+  }
+
+  if (!GetFileSizeEx(file, &size) || (u64)size.QuadPart > (u64)(usize)-1)
+  {
+    CloseHandle(file);
+    return 0;
+  }
+
+  ms->data = NULL;
+  ms->size = (i64)size.QuadPart;
+  ms->position = 0;
+  ms->mapped = 0;
+
+  if (ms->size)
+  {
+    mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    ++ms->syscalls;
+    if (mapping)
+    {
+      ms->data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+      CloseHandle(mapping);
+      ms->syscalls += 2;
+    }
+    ms->mapped = ms->data != NULL;
+  }
+
+  CloseHandle(file);
+  ++ms->syscalls;
+  return !ms->size || ms->mapped;
+#else
+  struct stat st;
+  int fd = open(path, O_RDONLY);
+  void* view = NULL;
+
+  ms->syscalls += 2; /* open, fstat */
+  if (fd == -1)
+  {
+    perror("open");
+    exit(e_error_fopen);
+  }
+
+  if (fstat(fd, &st) == -1)
+  {
+    perror("fstat");
+    exit(e_error_ftell);
+  }
+
+  if (!S_ISREG(st.st_mode) || (u64)st.st_size > (u64)(usize)-1)
+  {
+    close(fd);
+    return 0;
+  }
+
+  ms->data = NULL;
+  ms->size = (i64)st.st_size;
+  ms->position = 0;
+  ms->mapped = 0;
+
+  if (ms->size)
+  {
+    ++ms->syscalls;
+    view = mmap(NULL, (size_t)ms->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (view != MAP_FAILED)
+    {
+      ms->data = view;
+      ms->mapped = 1;
+    }
+  }
+
+  close(fd);
+  ++ms->syscalls;
+  return !ms->size || ms->mapped;
+#endif
+}
+#endif
+
+static INLINE void
 memorystream_init(MemoryStream* ms, char* path)
 {
-  FILE* fp = fopen(path, "rb");
+  FILE* fp = NULL;
+
+  ms->syscalls = 0;
+
+#if defined(MEMORYSTREAM_MMAP)
+  if (memorystream_map(ms, path))
+  {
+    return;
+  }
+#endif
+
+  fp = fopen(path, "rb");
 
   if (!fp)
   {
@@ -75,10 +195,12 @@ memorystream_init(MemoryStream* ms, char* path)
     exit(e_error_fclose);
   }
 
+  ms->syscalls += 6; /* open, seek, tell, seek, read, close */
   ms->position = 0;
+  ms->mapped = 0;
 }
 
-static i64
+static INLINE i64
 memorystream_read(MemoryStream* ms, void* dst, i64 n)
 {
   i64 remaining = ms->size - ms->position;
@@ -88,6 +210,11 @@ memorystream_read(MemoryStream* ms, void* dst, i64 n)
     n = remaining;
   }
 
+  if (n <= 0)
+  {
+    return 0;
+  }
+
   memcpy(dst, ms->data + ms->position, (size_t)n);
 
   ms->position += n;
@@ -95,12 +222,88 @@ memorystream_read(MemoryStream* ms, void* dst, i64 n)
   return n;
 }
 
-static void
+/* Returns a pointer to the next n bytes and moves past them, or NULL if
+ * fewer than n bytes are left (the position is then left untouched). */
+static INLINE u8*
+memorystream_view(MemoryStream* ms, i64 n)
+{
+  u8* view = NULL;
+
+  if (n < 0 || n > ms->size - ms->position)
+  {
+    return NULL;
+  }
+
+  view = ms->data + ms->position;
+  ms->position += n;
+
+  return view;
+}
+
+/* Little-endian decoding, independent of the host byte order. */
+static INLINE u16
+u16_le_get(const u8* src)
+{
+  return (u16)(src[0] | (src[1] << 8));
+}
+
+static INLINE i16
+i16_le_get(const u8* src)
+{
+  return (i16)u16_le_get(src);
+}
+
+static INLINE u32
+u32_le_get(const u8* src)
+{
+  return (u32)src[0] | ((u32)src[1] << 8) | ((u32)src[2] << 16) | ((u32)src[3] << 24);
+}
+
+static INLINE i32
+i32_le_get(const u8* src)
+{
+  return (i32)u32_le_get(src);
+}
+
+/* And the encoding, for the writers. */
+static INLINE void
+u16_le_put(u8* dst, u16 value)
+{
+  dst[0] = (u8)(value & 0xFF);
+  dst[1] = (u8)((value >> 8) & 0xFF);
+}
+
+static INLINE void
+u32_le_put(u8* dst, u32 value)
+{
+  dst[0] = (u8)(value & 0xFF);
+  dst[1] = (u8)((value >> 8) & 0xFF);
+  dst[2] = (u8)((value >> 16) & 0xFF);
+  dst[3] = (u8)((value >> 24) & 0xFF);
+}
+
+static INLINE void
 memorystream_free(MemoryStream* ms)
 {
-  free(ms->data);
+#if defined(MEMORYSTREAM_MMAP)
+  if (ms->mapped)
+  {
+#if defined(_WIN32)
+    UnmapViewOfFile(ms->data);
+#else
+    munmap(ms->data, (size_t)ms->size);
+#endif
+    ++ms->syscalls;
+  }
+  else
+#endif
+  {
+    free(ms->data);
+  }
+  ms->data = NULL;
   ms->size = 0;
   ms->position = 0;
+  ms->mapped = 0;
 }
 
 #endif /* MEMORYSTREAM_H */
@@ -0,0 +1,250 @@
+/* SPDX-License-Identifier: MIT */
+/**
+ * @file   outputbuffer.h
+ * @author Marc-Alexandre Espiaut <ma.dev@espiaut.fr>
+ * @date   2026-03-09
+ * @brief  Growable in-memory text output, flushed to a stream in one write.
+ *
+ * @copyright Copyright (c) 2026 Marc-Alexandre Espiaut
+ */
+
+#ifndef OUTPUTBUFFER_H
+#define OUTPUTBUFFER_H
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "errorcodes.h"
+#include "types.h"
+
+enum
+{
+  e_outputbuffer_min_capacity = 4096,
+  e_outputbuffer_chunk = 65536 /* flush threshold for record output */
+};
+
+/* Output formats of the info tools: prose for people, one record per
+ * line for everything else. */
+enum
+{
+  e_format_text,
+  e_format_jsonl,
+  e_format_tsv
+};
+
+typedef struct OutputBuffer OutputBuffer;
+struct OutputBuffer
+{
+  char* data;
+  usize size;
+  usize capacity;
+};
+
+/* Makes room for at least n more bytes. */
+static INLINE void
+outputbuffer_reserve(OutputBuffer* ob, usize n)
+{
+  usize capacity = ob->capacity ? ob->capacity : e_outputbuffer_min_capacity;
+  char* data = NULL;
+
+  if (ob->capacity - ob->size >= n && ob->data)
+  {
+    return;
+  }
+
+  while (capacity - ob->size < n)
+  {
+    capacity *= 2;
+  }
+
+  data = realloc(ob->data, capacity);
+  if (!data)
+  {
+    perror("realloc");
+    exit(e_error_malloc);
+  }
+
+  ob->data = data;
+  ob->capacity = capacity;
+}
+
+static INLINE void
+outputbuffer_write(OutputBuffer* ob, const void* src, usize n)
+{
+  outputbuffer_reserve(ob, n);
+  memcpy(ob->data + ob->size, src, n);
+  ob->size += n;
+}
+
+static INLINE void
+outputbuffer_printf(OutputBuffer* ob, const char* format, ...)
+{
+  va_list args;
+  int n = 0;
+
+  outputbuffer_reserve(ob, 1);
+
+  va_start(args, format);
+  n = vsnprintf(ob->data + ob->size, ob->capacity - ob->size, format, args);
+  va_end(args);
+
+  if (n < 0)
+  {
+    perror("vsnprintf");
+    exit(e_error_fwrite);
+  }
+
+  if ((usize)n >= ob->capacity - ob->size)
+  {
+    outputbuffer_reserve(ob, (usize)n + 1);
+
+    va_start(args, format);
+    vsnprintf(ob->data + ob->size, ob->capacity - ob->size, format, args);
+    va_end(args);
+  }
+
+  ob->size += (usize)n;
+}
+
+/* Writes everything out and empties the buffer, keeping its memory. */
+static INLINE void
+outputbuffer_flush(OutputBuffer* ob, FILE* fp)
+{
+  if (ob->size && fwrite(ob->data, 1, ob->size, fp) != ob->size)
+  {
+    perror("fwrite");
+    exit(e_error_fwrite);
+  }
+
+  ob->size = 0;
+}
+
+/* Whether a chunk has piled up: flushing only then makes record output
+ * reach the stream in a few large writes. */
+static INLINE int
+outputbuffer_full(const OutputBuffer* ob)
+{
+  return ob->size >= e_outputbuffer_chunk;
+}
+
+/* Returns the e_format_* value of a --format argument, -1 if unknown. */
+static INLINE int
+outputbuffer_format_parse(const char* name)
+{
+  if (!strcmp(name, "text"))
+  {
+    return e_format_text;
+  }
+  if (!strcmp(name, "jsonl"))
+  {
+    return e_format_jsonl;
+  }
+  if (!strcmp(name, "tsv"))
+  {
+    return e_format_tsv;
+  }
+  return -1;
+}
+
+/* Parses "--format=NAME" or "--format NAME" at argv[*i], leaving *i on
+ * the last argument used. Returns the e_format_* value, -1 if the name is
+ * missing or unknown. */
+static INLINE int
+outputbuffer_format_option(int argc, char* argv[], int* i)
+{
+  if (!strncmp(argv[*i], "--format=", 9))
+  {
+    return outputbuffer_format_parse(argv[*i] + 9);
+  }
+
+  if (++*i == argc)
+  {
+    return -1;
+  }
+  return outputbuffer_format_parse(argv[*i]);
+}
+
+/* Writes n bytes of src as a quoted JSON string. Bytes above 0x7F are
+ * copied as is: paths and VOC texts are taken to be UTF-8 already. */
+static INLINE void
+outputbuffer_json_string(OutputBuffer* ob, const char* src, usize n)
+{
+  static const char hex[] = "0123456789abcdef";
+  usize i = 0;
+
+  /* Worst case, every byte becomes \u00XX. */
+  outputbuffer_reserve(ob, n * 6 + 2);
+  ob->data[ob->size++] = '"';
+
+  for (; i < n; ++i)
+  {
+    u8 c = (u8)src[i];
+
+    if (c == '"' || c == '\\')
+    {
+      ob->data[ob->size++] = '\\';
+      ob->data[ob->size++] = (char)c;
+    }
+    else if (c == '\n')
+    {
+      ob->data[ob->size++] = '\\';
+      ob->data[ob->size++] = 'n';
+    }
+    else if (c == '\t')
+    {
+      ob->data[ob->size++] = '\\';
+      ob->data[ob->size++] = 't';
+    }
+    else if (c < 0x20)
+    {
+      memcpy(ob->data + ob->size, "\\u00", 4);
+      ob->data[ob->size + 4] = hex[c >> 4];
+      ob->data[ob->size + 5] = hex[c & 0xF];
+      ob->size += 6;
+    }
+    else
+    {
+      ob->data[ob->size++] = (char)c;
+    }
+  }
+
+  ob->data[ob->size++] = '"';
+}
+
+/* Writes n bytes of src as a TSV field: tabs, newlines and backslashes are
+ * escaped the way most TSV readers expect. */
+static INLINE void
+outputbuffer_tsv_field(OutputBuffer* ob, const char* src, usize n)
+{
+  usize i = 0;
+
+  outputbuffer_reserve(ob, n * 2);
+
+  for (; i < n; ++i)
+  {
+    char c = src[i];
+
+    if (c == '\t' || c == '\n' || c == '\r' || c == '\\')
+    {
+      ob->data[ob->size++] = '\\';
+      ob->data[ob->size++] = c == '\t' ? 't' : c == '\n' ? 'n' : c == '\r' ? 'r' : '\\';
+    }
+    else
+    {
+      ob->data[ob->size++] = c;
+    }
+  }
+}
+
+static INLINE void
+outputbuffer_free(OutputBuffer* ob)
+{
+  free(ob->data);
+  ob->data = NULL;
+  ob->size = 0;
+  ob->capacity = 0;
+}
+
+#endif /* OUTPUTBUFFER_H */
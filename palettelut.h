@@ -0,0 +1,258 @@
+/* SPDX-License-Identifier: MIT */
+/**
+ * @file   palettelut.h
+ * @author Marc-Alexandre Espiaut <ma.dev@espiaut.fr>
+ * @date   2026-03-26
+ * @brief  Nearest palette color of any RGB color, by table lookup.
+ *
+ * A color of the palette itself is found first in a small hash table, so
+ * tiles exported by art2img come back with the very same indices.
+ *
+ * Any other color goes through a table of the RGB cube cut into 64x64x64
+ * cells, 6 bits per component as in PALETTE.DAT, each holding the palette
+ * index nearest to the color the cell's 6 bits widen to. Quantizing a
+ * pixel is then one load instead of a search through 255 colors. Building
+ * the table is that search for all 262144 cells, so it can be kept in a
+ * cache file, a header then the table as is, tagged with the XXH64 of the
+ * palette it was built for. A cache built for another palette is rebuilt.
+ *
+ * @copyright Copyright (c) 2026 Marc-Alexandre Espiaut
+ */
+
+#ifndef PALETTELUT_H
+#define PALETTELUT_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "art.h"
+#include "errorcodes.h"
+#include "fileio.h"
+#include "hash.h"
+#include "memorystream.h"
+#include "types.h"
+
+enum
+{
+  e_palettelut_version = 2,
+  e_palettelut_size = 64 * 64 * 64,
+  e_palettelut_exact_size = 512 /* at most half full */
+};
+
+typedef struct PaletteLutHeader PaletteLutHeader;
+struct PaletteLutHeader
+{
+  char magic[8]; /* "PALETLUT" */
+  u32 version;
+  u32 size; /* e_palettelut_size */
+  u64 palette_hash;
+};
+
+typedef struct PaletteLut PaletteLut;
+struct PaletteLut
+{
+  u8 index[e_palettelut_size];
+  u32 exact_color[e_palettelut_exact_size]; /* 0xRRGGBB + 1, 0 when empty */
+  u8 exact_index[e_palettelut_exact_size];
+};
+
+static const char palettelut_magic[8] = {'P', 'A', 'L', 'E', 'T', 'L', 'U', 'T'};
+
+static INLINE u64
+palettelut_key(const rgba_u8_t* palette)
+{
+  return hash_xxh64(palette, sizeof(*palette) * 256, 0);
+}
+
+static INLINE u32
+palettelut_exact_slot(u32 color)
+{
+  return (u32)(((u64)color * HASH_PRIME64_1) >> 55);
+}
+
+/* Every index but the transparent one is a candidate; as for the
+ * duplicated colors of the game palettes, the lowest index wins. */
+static INLINE void
+palettelut_exact_build(PaletteLut* lut, const rgba_u8_t* palette)
+{
+  u32 i = 0;
+
+  memset(lut->exact_color, 0, sizeof(lut->exact_color));
+
+  for (; i < 256; ++i)
+  {
+    u32 color = (u32)palette[i].r << 16 | (u32)palette[i].g << 8 | palette[i].b;
+    u32 slot = palettelut_exact_slot(color);
+
+    if (i == e_art_transparent)
+    {
+      continue;
+    }
+
+    while (lut->exact_color[slot] && lut->exact_color[slot] != color + 1)
+    {
+      slot = (slot + 1) & (e_palettelut_exact_size - 1);
+    }
+    if (!lut->exact_color[slot])
+    {
+      lut->exact_color[slot] = color + 1;
+      lut->exact_index[slot] = (u8)i;
+    }
+  }
+}
+
+/* Same candidates and ties as above. A cell stands for the color its 6
+ * bits widen to, so a color of the palette is at distance 0 of its own
+ * entry. */
+static INLINE void
+palettelut_build(PaletteLut* lut, const rgba_u8_t* palette)
+{
+  u32 cell = 0;
+
+  for (; cell < e_palettelut_size; ++cell)
+  {
+    i32 r = art_palette_component((u8)(cell >> 12));
+    i32 g = art_palette_component((u8)(cell >> 6));
+    i32 b = art_palette_component((u8)cell);
+    i32 best_distance = 0x7FFFFFFF;
+    u32 i = 0;
+
+    for (; i < 256; ++i)
+    {
+      i32 dr = r - palette[i].r;
+      i32 dg = g - palette[i].g;
+      i32 db = b - palette[i].b;
+      i32 distance = dr * dr + dg * dg + db * db;
+
+      if (i != e_art_transparent && distance < best_distance)
+      {
+        best_distance = distance;
+        lut->index[cell] = (u8)i;
+      }
+    }
+  }
+}
+
+/* Returns 1 if path holds a table for the palette hashed to key. */
+static INLINE int
+palettelut_load(PaletteLut* lut, const char* path, u64 key)
+{
+  struct stat st;
+  MemoryStream ms = {0};
+  const PaletteLutHeader* header = NULL;
+  int found = 0;
+
+  if (stat(path, &st) == -1)
+  {
+    return 0;
+  }
+
+  memorystream_init(&ms, (char*)path);
+  header = (const PaletteLutHeader*)ms.data;
+
+  if ((u64)ms.size == sizeof(*header) + e_palettelut_size &&
+      !memcmp(header->magic, palettelut_magic, sizeof(palettelut_magic)) &&
+      header->version == e_palettelut_version &&
+      header->size == e_palettelut_size &&
+      header->palette_hash == key)
+  {
+    memcpy(lut->index, ms.data + sizeof(*header), e_palettelut_size);
+    found = 1;
+  }
+
+  memorystream_free(&ms);
+  return found;
+}
+
+/* Written through a temporary file, so a reader never sees half a table. */
+static INLINE void
+palettelut_save(const PaletteLut* lut, const char* path, u64 key)
+{
+  PaletteLutHeader header;
+  char* tmp_path = malloc(strlen(path) + sizeof(".tmp"));
+  FILE* fp = NULL;
+
+  if (!tmp_path)
+  {
+    perror("malloc");
+    exit(e_error_malloc);
+  }
+  sprintf(tmp_path, "%s.tmp", path);
+
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, palettelut_magic, sizeof(palettelut_magic));
+  header.version = e_palettelut_version;
+  header.size = e_palettelut_size;
+  header.palette_hash = key;
+
+  fp = fopen(tmp_path, "wb");
+  if (!fp)
+  {
+    perror("fopen");
+    exit(e_error_fopen);
+  }
+  if (fwrite(&header, sizeof(header), 1, fp) != 1 || fwrite(lut->index, e_palettelut_size, 1, fp) != 1)
+  {
+    perror("fwrite");
+    exit(e_error_fwrite);
+  }
+  if (fclose(fp) == EOF)
+  {
+    perror("fclose");
+    exit(e_error_fclose);
+  }
+
+  fileio_replace(tmp_path, path);
+
+  free(tmp_path);
+}
+
+/* The table of palette, from cache_path when it has it. Without a cache,
+ * cache_path is NULL. */
+static INLINE void
+palettelut_open(PaletteLut* lut, const rgba_u8_t* palette, const char* cache_path)
+{
+  u64 key = palettelut_key(palette);
+
+  palettelut_exact_build(lut, palette);
+
+  if (cache_path && palettelut_load(lut, cache_path, key))
+  {
+    return;
+  }
+
+  palettelut_build(lut, palette);
+
+  if (cache_path)
+  {
+    palettelut_save(lut, cache_path, key);
+  }
+}
+
+/* Mostly see-through pixels become the transparent index. */
+static INLINE u8
+palettelut_find(const PaletteLut* lut, rgba_u8_t color)
+{
+  u32 rgb = (u32)color.r << 16 | (u32)color.g << 8 | color.b;
+  u32 slot = palettelut_exact_slot(rgb);
+
+  if (color.a < 128)
+  {
+    return e_art_transparent;
+  }
+
+  while (lut->exact_color[slot])
+  {
+    if (lut->exact_color[slot] == rgb + 1)
+    {
+      return lut->exact_index[slot];
+    }
+    slot = (slot + 1) & (e_palettelut_exact_size - 1);
+  }
+
+  return lut->index[(color.r >> 2) << 12 | (color.g >> 2) << 6 | color.b >> 2];
+}
+
+#endif /* PALETTELUT_H */
@@ -0,0 +1,285 @@
+/* SPDX-License-Identifier: MIT */
+/**
+ * @file   pipeline.h
+ * @author Marc-Alexandre Espiaut <ma.dev@espiaut.fr>
+ * @date   2026-03-23
+ * @brief  Read, transcode and write stages for batch conversions.
+ *
+ * The main thread loads the inputs, a pool of workers transcodes them in
+ * memory, and a writer thread stores the results, so that disk I/O and
+ * decoding overlap. The stages are joined by bounded queues, which keep
+ * at most a few files per worker in flight however long the batch is.
+ * Those files can be of any size, so the read stage also waits while the
+ * inputs and outputs in flight add up to more than e_pipeline_budget.
+ * A file larger than that on its own still goes through, alone.
+ *
+ * @copyright Copyright (c) 2026 Marc-Alexandre Espiaut
+ */
+
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "errorcodes.h"
+#include "fileio.h"
+#include "memorystream.h"
+#include "outputbuffer.h"
+#include "thread.h"
+#include "types.h"
+
+enum
+{
+  e_pipeline_budget = 1 << 26 /* bytes of inputs and outputs in flight */
+};
+
+/* A FIFO of pointers that blocks the producer when full and the consumer
+ * when empty. Once closed and drained, queue_pop() returns NULL. */
+typedef struct Queue Queue;
+struct Queue
+{
+  void** item;
+  usize capacity;
+  usize head;
+  usize count;
+  int closed;
+  Mutex lock;
+  Condition not_empty;
+  Condition not_full;
+};
+
+static INLINE void
+queue_init(Queue* queue, usize capacity)
+{
+  memset(queue, 0, sizeof(*queue));
+  queue->item = malloc(sizeof(*queue->item) * capacity);
+  if (!queue->item)
+  {
+    perror("malloc");
+    exit(e_error_malloc);
+  }
+  queue->capacity = capacity;
+  mutex_init(&queue->lock);
+  condition_init(&queue->not_empty);
+  condition_init(&queue->not_full);
+}
+
+static INLINE void
+queue_push(Queue* queue, void* item)
+{
+  mutex_lock(&queue->lock);
+  while (queue->count == queue->capacity)
+  {
+    condition_wait(&queue->not_full, &queue->lock);
+  }
+  queue->item[(queue->head + queue->count++) % queue->capacity] = item;
+  condition_signal(&queue->not_empty);
+  mutex_unlock(&queue->lock);
+}
+
+static INLINE void*
+queue_pop(Queue* queue)
+{
+  void* item = NULL;
+
+  mutex_lock(&queue->lock);
+  while (!queue->count && !queue->closed)
+  {
+    condition_wait(&queue->not_empty, &queue->lock);
+  }
+  if (queue->count)
+  {
+    item = queue->item[queue->head];
+    queue->head = (queue->head + 1) % queue->capacity;
+    --queue->count;
+    condition_signal(&queue->not_full);
+  }
+  mutex_unlock(&queue->lock);
+
+  return item;
+}
+
+/* No more pushes: wakes every consumer up. */
+static INLINE void
+queue_close(Queue* queue)
+{
+  mutex_lock(&queue->lock);
+  queue->closed = 1;
+  condition_broadcast(&queue->not_empty);
+  mutex_unlock(&queue->lock);
+}
+
+static INLINE void
+queue_destroy(Queue* queue)
+{
+  condition_destroy(&queue->not_full);
+  condition_destroy(&queue->not_empty);
+  mutex_destroy(&queue->lock);
+  free(queue->item);
+}
+
+/* One file on its way through the stages. */
+typedef struct PipelineJob PipelineJob;
+struct PipelineJob
+{
+  char* in;
+  const char* out;
+  MemoryStream input; /* loaded by the read stage */
+  OutputBuffer output; /* filled by the transcoder */
+  u64 charge; /* bytes counted against the budget */
+  int ok; /* 0 when there is nothing to write */
+};
+
+/* Transcodes job->input into job->output, printing its own warnings.
+ * Runs on several threads at once. */
+typedef void (*PipelineTranscode)(PipelineJob* job, void* context);
+
+typedef struct Pipeline Pipeline;
+struct Pipeline
+{
+  Queue loaded;
+  Queue transcoded;
+  PipelineTranscode transcode;
+  void* context;
+  u64 inflight; /* sum of the charges of the jobs in flight */
+  Mutex budget_lock;
+  Condition budget_free;
+};
+
+/* Counts bytes against the budget, waiting for room first unless nothing
+ * else is in flight. */
+static INLINE void
+pipeline_reserve(Pipeline* pipeline, PipelineJob* job, u64 bytes)
+{
+  mutex_lock(&pipeline->budget_lock);
+  while (pipeline->inflight && pipeline->inflight + bytes > e_pipeline_budget)
+  {
+    condition_wait(&pipeline->budget_free, &pipeline->budget_lock);
+  }
+  pipeline->inflight += bytes;
+  job->charge = bytes;
+  mutex_unlock(&pipeline->budget_lock);
+}
+
+/* Replaces the charge of a job by bytes, without waiting: a transcoded
+ * job has to reach the writer to free anything. */
+static INLINE void
+pipeline_recharge(Pipeline* pipeline, PipelineJob* job, u64 bytes)
+{
+  mutex_lock(&pipeline->budget_lock);
+  pipeline->inflight = pipeline->inflight - job->charge + bytes;
+  job->charge = bytes;
+  condition_broadcast(&pipeline->budget_free);
+  mutex_unlock(&pipeline->budget_lock);
+}
+
+static INLINE void
+pipeline_write(Pipeline* pipeline, PipelineJob* job)
+{
+  if (job->ok)
+  {
+    fprintf(stdout, "Converting %s to %s.\n", job->in, job->out);
+    fileio_file_write(job->out, (const u8*)job->output.data, job->output.size, 0);
+  }
+
+  outputbuffer_free(&job->output);
+  pipeline_recharge(pipeline, job, 0);
+  free(job);
+}
+
+static INLINE void
+pipeline_worker(void* arg)
+{
+  Pipeline* pipeline = arg;
+  PipelineJob* job = NULL;
+
+  while ((job = queue_pop(&pipeline->loaded)))
+  {
+    pipeline->transcode(job, pipeline->context);
+    memorystream_free(&job->input);
+    pipeline_recharge(pipeline, job, job->output.capacity);
+    queue_push(&pipeline->transcoded, job);
+  }
+}
+
+static INLINE void
+pipeline_writer(void* arg)
+{
+  Pipeline* pipeline = arg;
+  PipelineJob* job = NULL;
+
+  while ((job = queue_pop(&pipeline->transcoded)))
+  {
+    pipeline_write(pipeline, job);
+  }
+}
+
+/* Converts in[i] to out[i] for every i, with jobs transcoding threads. */
+static INLINE void
+pipeline_run(char* in[], char* out[], usize n, u32 jobs, PipelineTranscode transcode, void* context)
+{
+  Pipeline pipeline;
+  Thread* thread = NULL;
+  Thread writer;
+  usize i = 0;
+  u32 j = 0;
+
+  pipeline.transcode = transcode;
+  pipeline.context = context;
+  pipeline.inflight = 0;
+  mutex_init(&pipeline.budget_lock);
+  condition_init(&pipeline.budget_free);
+  queue_init(&pipeline.loaded, (usize)jobs * 2);
+  queue_init(&pipeline.transcoded, (usize)jobs * 2);
+
+  thread = calloc(jobs, sizeof(*thread));
+  if (!thread)
+  {
+    perror("calloc");
+    exit(e_error_malloc);
+  }
+
+  for (; j < jobs; ++j)
+  {
+    thread_create(&thread[j], pipeline_worker, &pipeline);
+  }
+  thread_create(&writer, pipeline_writer, &pipeline);
+
+  for (; i < n; ++i)
+  {
+    PipelineJob* job = calloc(1, sizeof(*job));
+
+    if (!job)
+    {
+      perror("calloc");
+      exit(e_error_malloc);
+    }
+
+    job->in = in[i];
+    job->out = out[i];
+    memorystream_init(&job->input, in[i]);
+    pipeline_reserve(&pipeline, job, (u64)job->input.size);
+    /* A mapping reads nothing by itself: have the pages faulted in while
+     * the job waits for a transcoder. */
+    fileio_map_advise(&job->input, 0, job->input.size, e_fileio_willneed);
+    queue_push(&pipeline.loaded, job);
+  }
+
+  queue_close(&pipeline.loaded);
+  for (j = 0; j < jobs; ++j)
+  {
+    thread_join(thread[j]);
+  }
+  queue_close(&pipeline.transcoded);
+  thread_join(writer);
+
+  condition_destroy(&pipeline.budget_free);
+  mutex_destroy(&pipeline.budget_lock);
+  queue_destroy(&pipeline.transcoded);
+  queue_destroy(&pipeline.loaded);
+  free(thread);
+}
+
+#endif /* PIPELINE_H */
@@ -0,0 +1,317 @@
+/* SPDX-License-Identifier: MIT */
+/**
+ * @file   rts.c
+ * @author Marc-Alexandre Espiaut <ma.dev@espiaut.fr>
+ * @date   2026-03-29
+ * @version 1.0
+ * @brief  Creates an RTS file from a list of VOC files.
+ *
+ * @copyright Copyright (c) 2026 Marc-Alexandre Espiaut
+ */
+
+#if defined(__linux__)
+#define _GNU_SOURCE /* copy_file_range(), splice() for fileio.h */
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "errorcodes.h"
+#include "fileio.h"
+#include "filelist.h"
+#include "memorystream.h"
+#include "rtsreader.h"
+#include "types.h"
+
+#define RTS_VERSION "1.0"
+
+typedef struct lump_s lump_t;
+struct lump_s
+{
+  char name[e_rts_name_len + 1];
+  const char* path;
+  u32 size;
+  u32 offset;
+};
+
+/* An input is either a path, stored under its file name without the
+ * extension, or NAME=PATH. */
+static void
+lump_parse(lump_t* lump, const char* arg)
+{
+  const char* eq = filelist_name_split(arg, e_rts_name_len);
+  const char* base = arg;
+  const char* c = arg;
+  char raw[e_rts_name_len + 1] = {0};
+  usize len = 0;
+
+  if (eq)
+  {
+    len = (usize)(eq - arg);
+    lump->path = eq + 1;
+  }
+  else
+  {
+    const char* dot = NULL;
+
+    for (; *c; ++c)
+    {
+      if (*c == '/' || *c == '\\')
+      {
+        base = c + 1;
+      }
+    }
+    dot = strrchr(base, '.');
+    len = dot && dot != base ? (usize)(dot - base) : strlen(base);
+    lump->path = arg;
+  }
+
+  memcpy(raw, base, len < e_rts_name_len ? len : e_rts_name_len);
+  rtsreader_name_fold(lump->name, raw);
+}
+
+/* The one stat pass: every size, hence every offset and the directory,
+ * is known before the first byte is written. Returns the directory
+ * offset. */
+static u32
+lumps_layout(lump_t* lump, usize n)
+{
+  u64 offset = e_rts_header_len;
+  usize i = 0;
+
+  for (; i < n; ++i)
+  {
+    struct stat st;
+
+    if (stat(lump[i].path, &st) == -1)
+    {
+      perror("stat");
+      exit(e_error_fopen);
+    }
+    if (!S_ISREG(st.st_mode))
+    {
+      fprintf(stderr, "ERROR: %s is not a regular file! Quitting!\n", lump[i].path);
+      exit(EXIT_FAILURE);
+    }
+
+    lump[i].size = (u32)st.st_size;
+    lump[i].offset = (u32)offset;
+    offset += (u64)st.st_size;
+
+    /* Offsets are signed 32 bits in the file. */
+    if ((u64)st.st_size > 0x7FFFFFFFUL || offset + (u64)n * e_rts_entry_len > 0x7FFFFFFFUL)
+    {
+      fprintf(stderr, "ERROR: RTS files can't be larger than 2 GiB! Quitting!\n");
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  return (u32)offset;
+}
+
+static int
+lump_compare(const void* a, const void* b)
+{
+  const lump_t* x = *(const lump_t* const*)a;
+  const lump_t* y = *(const lump_t* const*)b;
+  int order = strcmp(x->name, y->name);
+
+  if (order)
+  {
+    return order;
+  }
+  return x < y ? -1 : x > y;
+}
+
+/* Lumps are looked up by name, so a second lump of the same name can't
+ * be reached, and unrts stops at it. Sorting finds every repeat at once. */
+static void
+lumps_duplicates_report(lump_t* lump, usize n)
+{
+  const lump_t** sorted = malloc(sizeof(*sorted) * (n ? n : 1));
+  usize i = 0;
+
+  if (!sorted)
+  {
+    perror("malloc");
+    exit(e_error_malloc);
+  }
+
+  for (; i < n; ++i)
+  {
+    sorted[i] = &lump[i];
+  }
+  qsort(sorted, n, sizeof(*sorted), lump_compare);
+
+  for (i = 1; i < n; ++i)
+  {
+    if (!strcmp(sorted[i]->name, sorted[i - 1]->name))
+    {
+      fprintf(stderr, "WARN: %s and %s are both stored as %s.\n", sorted[i - 1]->path, sorted[i]->path, sorted[i]->name);
+    }
+  }
+
+  free(sorted);
+}
+
+/* Header, lumps and directory go out in file order in one pass; the
+ * lumps are moved by the kernel where it can. The file is written under
+ * a temporary name and renamed once complete, so a failure never leaves
+ * a truncated RTS behind. */
+static void
+rts_write(const char* out, lump_t* lump, usize n)
+{
+  u8 header[e_rts_header_len] = {0};
+  u8* directory = calloc(n ? n : 1, e_rts_entry_len);
+  char* tmp = malloc(strlen(out) + sizeof(".tmp"));
+  FILE* out_fp = NULL;
+  u32 directory_offset = 0;
+  usize i = 0;
+
+  if (!directory || !tmp)
+  {
+    perror("malloc");
+    exit(e_error_malloc);
+  }
+
+  fileio_abort_if_exists(out);
+  /* A leftover temporary file may be someone else's: never clobber it. */
+  sprintf(tmp, "%s.tmp", out);
+  fileio_abort_if_exists(tmp);
+  directory_offset = lumps_layout(lump, n);
+  lumps_duplicates_report(lump, n);
+
+  for (; i < n; ++i)
+  {
+    u8* entry = directory + i * e_rts_entry_len;
+
+    u32_le_put(entry, lump[i].offset);
+    u32_le_put(entry + 4, lump[i].size);
+    memcpy(entry + 8, lump[i].name, strlen(lump[i].name));
+  }
+
+  memcpy(header, "IWAD", 4);
+  u32_le_put(header + 4, (u32)n);
+  u32_le_put(header + 8, directory_offset);
+
+  fprintf(stdout, "Creating %s.\n", out);
+  out_fp = fileio_fopen(tmp, "wb");
+  fileio_fwrite(header, 1, e_rts_header_len, out_fp);
+
+  for (i = 0; i < n; ++i)
+  {
+    FILE* in_fp = fileio_fopen(lump[i].path, "rb");
+    u64 size = 0;
+
+    fprintf(stdout, "Adding %s as %s (%lu bytes).\n", lump[i].path, lump[i].name, (unsigned long)lump[i].size);
+    size = fileio_copy(in_fp, out_fp, NULL);
+    fileio_fclose(in_fp);
+
+    /* The directory is already decided: a file that grew or shrank since
+     * the stat pass would shift every lump after it. */
+    if (size != lump[i].size)
+    {
+      fprintf(stderr, "ERROR: %s changed while being added! Quitting!\n", lump[i].path);
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  if (n)
+  {
+    fileio_fwrite(directory, e_rts_entry_len, n, out_fp);
+  }
+  fileio_fclose(out_fp);
+  fileio_replace(tmp, out);
+
+  free(tmp);
+  free(directory);
+}
+
+static void
+usage(const char* prgname, const char* prgver)
+{
+  fprintf(stderr, "%s %s : Copyright (c) 2026 Marc-Alexandre Espiaut\n", prgname, prgver);
+  fprintf(stderr, "\n");
+  fprintf(stderr, "%s is a tool for making RemoteRidicule (.rts) files for Duke Nukem 3D.\n", prgname);
+  fprintf(stderr, "\n");
+  fprintf(stderr, "Usage: %s [options] output.rts [files]\n", prgname);
+  fprintf(stderr, "\n");
+  fprintf(stderr, "Stores the files as lumps, in order, named after the files without their\n");
+  fprintf(stderr, "extension. A file given as NAME=PATH is stored as NAME, NAME being 1 to 8\n");
+  fprintf(stderr, "characters; an existing file whose name has a = is added as is.\n");
+  fprintf(stderr, "\n");
+  fprintf(stderr, "Options:\n");
+  fprintf(stderr, "  -h, --help             Show this help message and exit\n");
+  fprintf(stderr, "  -l, --list LIST.TXT    Add files as listed in LIST.TXT (- for stdin)\n");
+  fprintf(stderr, "\n");
+  fprintf(stderr, "Examples:\n");
+  fprintf(stderr, "  %s DUKE.RTS hello.voc bye.voc\n", prgname);
+  fprintf(stderr, "  %s DUKE.RTS -l list.txt\n", prgname);
+  fprintf(stderr, "  %s DUKE.RTS RTS01=sounds/taunt.voc\n", prgname);
+  exit(EXIT_FAILURE);
+}
+
+int
+main(int argc, char* argv[])
+{
+  FileList files = {0};
+  const char* out = NULL;
+  lump_t* lump = NULL;
+  usize j = 0;
+  int i;
+
+  if (argc < 3)
+  {
+    usage(argv[0], RTS_VERSION);
+  }
+
+  for (i = 1; i < argc; ++i)
+  {
+    if (!strcmp(argv[i], "-h") || !strcmp(argv[i], "--help"))
+    {
+      usage(argv[0], RTS_VERSION);
+    }
+    else if (!strcmp(argv[i], "-l") || !strcmp(argv[i], "--list"))
+    {
+      if (++i == argc)
+      {
+        usage(argv[0], RTS_VERSION);
+      }
+      filelist_load(&files, argv[i]);
+    }
+    else if (!out)
+    {
+      out = argv[i];
+    }
+    else
+    {
+      filelist_add(&files, argv[i]);
+    }
+  }
+
+  if (!out || !files.count)
+  {
+    usage(argv[0], RTS_VERSION);
+  }
+
+  lump = calloc(files.count, sizeof(*lump));
+  if (!lump)
+  {
+    perror("calloc");
+    exit(e_error_malloc);
+  }
+
+  for (; j < files.count; ++j)
+  {
+    lump_parse(&lump[j], files.path[j]);
+  }
+
+  rts_write(out, lump, files.count);
+
+  free(lump);
+  filelist_free(&files);
+
+  return EXIT_SUCCESS;
+}
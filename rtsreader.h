@@ -0,0 +1,162 @@
+/* SPDX-License-Identifier: MIT */
+/**
+ * @file   rtsreader.h
+ * @author Marc-Alexandre Espiaut <ma.dev@espiaut.fr>
+ * @date   2026-03-29
+ * @brief  Random access to the lumps of an RTS file.
+ *
+ * An RTS file is a WAD: a 12 bytes header ("IWAD", the lump count and the
+ * offset of the directory), the lumps, then the directory, 16 bytes per
+ * lump giving its offset, size and 8 characters name. Duke Nukem 3D keeps
+ * its RemoteRidicule VOCs in it, played by lump number.
+ *
+ * @copyright Copyright (c) 2026 Marc-Alexandre Espiaut
+ */
+
+#ifndef RTSREADER_H
+#define RTSREADER_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "errorcodes.h"
+#include "memorystream.h"
+#include "types.h"
+
+enum
+{
+  e_rts_header_len = 12,
+  e_rts_name_len = 8,
+  e_rts_entry_len = 16
+};
+
+typedef struct RtsEntry RtsEntry;
+struct RtsEntry
+{
+  char name[e_rts_name_len + 1]; /* upper-cased, NUL-terminated */
+  u32 size;
+  i64 offset; /* from the start of the file */
+};
+
+typedef struct RtsReader RtsReader;
+struct RtsReader
+{
+  MemoryStream ms;
+  RtsEntry* entry;
+  u32 count;
+};
+
+/* Only a-z change, and names are cut at 8 characters like the writer
+ * does. */
+static INLINE void
+rtsreader_name_fold(char* dst, const char* src)
+{
+  usize i = 0;
+
+  for (; i < e_rts_name_len && src[i] != '\0'; ++i)
+  {
+    dst[i] = (src[i] >= 'a' && src[i] <= 'z') ? (char)(src[i] - ('a' - 'A')) : src[i];
+  }
+  dst[i] = '\0';
+}
+
+static INLINE void
+rtsreader_fail(RtsReader* rts, const char* path, const char* reason)
+{
+  fprintf(stderr, "ERROR: %s: %s!\n", path, reason);
+  memorystream_free(&rts->ms);
+  exit(e_error_format);
+}
+
+/* Maps the file and loads its directory; no lump byte is read. */
+static INLINE void
+rtsreader_open(RtsReader* rts, char* path)
+{
+  const u8* header = NULL;
+  const u8* directory = NULL;
+  i32 count = 0;
+  i32 directory_offset = 0;
+  u32 i = 0;
+
+  memset(rts, 0, sizeof(*rts));
+  memorystream_init(&rts->ms, path);
+
+  header = memorystream_view(&rts->ms, e_rts_header_len);
+  if (!header || memcmp(header, "IWAD", 4))
+  {
+    rtsreader_fail(rts, path, "not an RTS file");
+  }
+
+  count = i32_le_get(header + 4);
+  directory_offset = i32_le_get(header + 8);
+  if (count < 0 || directory_offset < e_rts_header_len || (i64)directory_offset + (i64)count * e_rts_entry_len > rts->ms.size)
+  {
+    rtsreader_fail(rts, path, "truncated directory");
+  }
+  rts->count = (u32)count;
+  directory = rts->ms.data + directory_offset;
+
+  rts->entry = malloc(sizeof(*rts->entry) * (rts->count ? rts->count : 1));
+  if (!rts->entry)
+  {
+    perror("malloc");
+    exit(e_error_malloc);
+  }
+
+  for (; i < rts->count; ++i)
+  {
+    const u8* src = directory + (usize)i * e_rts_entry_len;
+    RtsEntry* entry = &rts->entry[i];
+    char raw[e_rts_name_len + 1] = {0};
+    i32 offset = i32_le_get(src);
+    i32 size = i32_le_get(src + 4);
+
+    if (offset < 0 || size < 0 || (i64)offset + size > rts->ms.size)
+    {
+      rtsreader_fail(rts, path, "lump out of the file");
+    }
+
+    memcpy(raw, src + 8, e_rts_name_len);
+    rtsreader_name_fold(entry->name, raw);
+    entry->size = (u32)size;
+    entry->offset = offset;
+  }
+}
+
+/* Index of the first lump called name (any case), or -1. There are only
+ * a handful of lumps, so a scan will do. */
+static INLINE i64
+rtsreader_find(const RtsReader* rts, const char* name)
+{
+  char folded[e_rts_name_len + 1] = {0};
+  u32 i = 0;
+
+  rtsreader_name_fold(folded, name);
+  for (; i < rts->count; ++i)
+  {
+    if (!strcmp(rts->entry[i].name, folded))
+    {
+      return i;
+    }
+  }
+
+  return -1;
+}
+
+/* Zero-copy view of a lump's bytes, valid until rtsreader_close(). */
+static INLINE const u8*
+rtsreader_data(const RtsReader* rts, u32 i)
+{
+  return rts->ms.data + rts->entry[i].offset;
+}
+
+static INLINE void
+rtsreader_close(RtsReader* rts)
+{
+  memorystream_free(&rts->ms);
+  free(rts->entry);
+  memset(rts, 0, sizeof(*rts));
+}
+
+#endif /* RTSREADER_H */
@@ -0,0 +1,136 @@
+/* SPDX-License-Identifier: MIT */
+/**
+ * @file   stats.h
+ * @author Marc-Alexandre Espiaut <ma.dev@espiaut.fr>
+ * @date   2026-03-19
+ * @brief  Phase timings and I/O counters behind --stats.
+ *
+ * Every function takes a Stats pointer that is NULL when --stats is off,
+ * so a disabled probe costs one test of a pointer and no clock read.
+ * Threads fill their own Stats and merge them once at the end.
+ *
+ * The byte counts and timings are measured. The system call count is
+ * not: each probe adds the calls its code path is expected to make, and
+ * the C library may make more or fewer. It is printed as
+ * "syscalls_estimated" so it is not taken for a trace.
+ *
+ * @copyright Copyright (c) 2026 Marc-Alexandre Espiaut
+ */
+
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdio.h>
+#include <string.h>
+
+#include "timing.h"
+#include "types.h"
+
+enum
+{
+  e_stats_open, /* memorystream_init(), fopen() of the inputs */
+  e_stats_parse,
+  e_stats_analyze,
+  e_stats_print,
+  e_stats_directory, /* building and backpatching a GRP directory */
+  e_stats_copy, /* moving payloads */
+  e_stats_hash,
+  e_stats_commit, /* fsync and rename */
+  e_stats_phase_count
+};
+
+typedef struct Stats Stats;
+struct Stats
+{
+  u64 phase_ns[e_stats_phase_count];
+  u64 phase_calls[e_stats_phase_count];
+  u64 bytes_read;
+  u64 bytes_written;
+  u64 syscalls; /* estimated, see above */
+  u64 allocations;
+  u64 start; /* timing_now() at stats_init(), for the wall time */
+};
+
+static INLINE void
+stats_init(Stats* stats)
+{
+  memset(stats, 0, sizeof(*stats));
+  stats->start = timing_now();
+}
+
+/* Returns the time a phase started, to hand back to stats_end(). */
+static INLINE u64
+stats_begin(Stats* stats)
+{
+  return stats ? timing_now() : 0;
+}
+
+static INLINE void
+stats_end(Stats* stats, int phase, u64 begin)
+{
+  if (stats)
+  {
+    stats->phase_ns[phase] += timing_now() - begin;
+    ++stats->phase_calls[phase];
+  }
+}
+
+static INLINE void
+stats_io(Stats* stats, u64 bytes_read, u64 bytes_written, u64 syscalls)
+{
+  if (stats)
+  {
+    stats->bytes_read += bytes_read;
+    stats->bytes_written += bytes_written;
+    stats->syscalls += syscalls;
+  }
+}
+
+static INLINE void
+stats_alloc(Stats* stats, u64 allocations)
+{
+  if (stats)
+  {
+    stats->allocations += allocations;
+  }
+}
+
+/* Adds the counters of a worker into the totals. */
+static INLINE void
+stats_merge(Stats* dst, const Stats* src)
+{
+  int i = 0;
+
+  for (; i < e_stats_phase_count; ++i)
+  {
+    dst->phase_ns[i] += src->phase_ns[i];
+    dst->phase_calls[i] += src->phase_calls[i];
+  }
+  dst->bytes_read += src->bytes_read;
+  dst->bytes_written += src->bytes_written;
+  dst->syscalls += src->syscalls;
+  dst->allocations += src->allocations;
+}
+
+/* One JSON object on a single line. Phases that never ran are left out;
+ * with several threads, phase times add up to more than the wall time. */
+static INLINE void
+stats_print(const Stats* stats, const char* tool, FILE* fp)
+{
+  static const char* const name[e_stats_phase_count] = {"open", "parse", "analyze", "print", "directory", "copy", "hash", "commit"};
+  int first = 1;
+  int i = 0;
+
+  fprintf(fp, "{\"tool\": \"%s\", \"wall_us\": %.3f, \"phases\": {", tool, (f64)(timing_now() - stats->start) / 1000.0);
+  for (; i < e_stats_phase_count; ++i)
+  {
+    if (stats->phase_calls[i])
+    {
+      fprintf(fp, "%s\"%s\": {\"us\": %.3f, \"calls\": %lu}", first ? "" : ", ", name[i], (f64)stats->phase_ns[i] / 1000.0, (unsigned long)stats->phase_calls[i]);
+      first = 0;
+    }
+  }
+  fprintf(fp, "}, \"bytes_read\": %.0f, \"bytes_written\": %.0f, \"syscalls_estimated\": %lu, \"allocations\": %lu}\n", (f64)stats->bytes_read, (f64)stats->bytes_written, (unsigned long)stats->syscalls, (unsigned long)stats->allocations);
+}
+
+#endif /* STATS_H */
@@ -0,0 +1,216 @@
+/* SPDX-License-Identifier: MIT */
+/**
+ * @file   thread.h
+ * @author Marc-Alexandre Espiaut <ma.dev@espiaut.fr>
+ * @date   2026-03-09
+ * @brief  Minimal threads, mutexes and condition variables.
+ *
+ * @copyright Copyright (c) 2026 Marc-Alexandre Espiaut
+ */
+
+#ifndef THREAD_H
+#define THREAD_H
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+#include "errorcodes.h"
+#include "types.h"
+
+#if defined(_WIN32)
+typedef HANDLE Thread;
+typedef CRITICAL_SECTION Mutex;
+typedef CONDITION_VARIABLE Condition;
+#else
+typedef pthread_t Thread;
+typedef pthread_mutex_t Mutex;
+typedef pthread_cond_t Condition;
+#endif
+
+typedef struct ThreadStart ThreadStart;
+struct ThreadStart
+{
+  void (*func)(void*);
+  void* arg;
+};
+
+/* Both thread APIs want a different entry point signature, so the user
+ * function and its argument travel through a heap-allocated ThreadStart. */
+#if defined(_WIN32)
+static INLINE DWORD WINAPI
+thread_trampoline(LPVOID param)
+#else
+static INLINE void*
+thread_trampoline(void* param)
+#endif
+{
+  ThreadStart start = *(ThreadStart*)param;
+
+  free(param);
+  start.func(start.arg);
+
+  return 0;
+}
+
+static INLINE void
+thread_create(Thread* thread, void (*func)(void*), void* arg)
+{
+  ThreadStart* start = malloc(sizeof(*start));
+
+  if (!start)
+  {
+    perror("malloc");
+    exit(e_error_malloc);
+  }
+
+  start->func = func;
+  start->arg = arg;
+
+#if defined(_WIN32)
+  *thread = CreateThread(NULL, 0, thread_trampoline, start, 0, NULL);
+  if (!*thread)
+  {
+    fprintf(stderr, "CreateThread: error %lu\n", (unsigned long)GetLastError());
+    exit(e_error_thread);
+  }
+#else
+  if (pthread_create(thread, NULL, thread_trampoline, start))
+  {
+    perror("pthread_create");
+    exit(e_error_thread);
+  }
+#endif
+}
+
+static INLINE void
+thread_join(Thread thread)
+{
+#if defined(_WIN32)
+  WaitForSingleObject(thread, INFINITE);
+  CloseHandle(thread);
+#else
+  if (pthread_join(thread, NULL))
+  {
+    perror("pthread_join");
+    exit(e_error_thread);
+  }
+#endif
+}
+
+/* Number of online CPUs, at least 1. */
+static INLINE u32
+thread_cpu_count(void)
+{
+#if defined(_WIN32)
+  SYSTEM_INFO info;
+
+  GetSystemInfo(&info);
+  return info.dwNumberOfProcessors ? (u32)info.dwNumberOfProcessors : 1;
+#else
+  long count = sysconf(_SC_NPROCESSORS_ONLN);
+
+  return count > 0 ? (u32)count : 1;
+#endif
+}
+
+static INLINE void
+mutex_init(Mutex* mutex)
+{
+#if defined(_WIN32)
+  InitializeCriticalSection(mutex);
+#else
+  pthread_mutex_init(mutex, NULL);
+#endif
+}
+
+static INLINE void
+mutex_lock(Mutex* mutex)
+{
+#if defined(_WIN32)
+  EnterCriticalSection(mutex);
+#else
+  pthread_mutex_lock(mutex);
+#endif
+}
+
+static INLINE void
+mutex_unlock(Mutex* mutex)
+{
+#if defined(_WIN32)
+  LeaveCriticalSection(mutex);
+#else
+  pthread_mutex_unlock(mutex);
+#endif
+}
+
+static INLINE void
+mutex_destroy(Mutex* mutex)
+{
+#if defined(_WIN32)
+  DeleteCriticalSection(mutex);
+#else
+  pthread_mutex_destroy(mutex);
+#endif
+}
+
+static INLINE void
+condition_init(Condition* condition)
+{
+#if defined(_WIN32)
+  InitializeConditionVariable(condition);
+#else
+  pthread_cond_init(condition, NULL);
+#endif
+}
+
+/* mutex must be held; it is released while waiting. */
+static INLINE void
+condition_wait(Condition* condition, Mutex* mutex)
+{
+#if defined(_WIN32)
+  SleepConditionVariableCS(condition, mutex, INFINITE);
+#else
+  pthread_cond_wait(condition, mutex);
+#endif
+}
+
+/* Wakes one waiter up. */
+static INLINE void
+condition_signal(Condition* condition)
+{
+#if defined(_WIN32)
+  WakeConditionVariable(condition);
+#else
+  pthread_cond_signal(condition);
+#endif
+}
+
+static INLINE void
+condition_broadcast(Condition* condition)
+{
+#if defined(_WIN32)
+  WakeAllConditionVariable(condition);
+#else
+  pthread_cond_broadcast(condition);
+#endif
+}
+
+static INLINE void
+condition_destroy(Condition* condition)
+{
+#if defined(_WIN32)
+  (void)condition;
+#else
+  pthread_cond_destroy(condition);
+#endif
+}
+
+#endif /* THREAD_H */
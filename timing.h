@@ -0,0 +1,48 @@
+/* SPDX-License-Identifier: MIT */
+/**
+ * @file   timing.h
+ * @author Marc-Alexandre Espiaut <ma.dev@espiaut.fr>
+ * @date   2026-03-18
+ * @brief  Monotonic clock.
+ *
+ * @copyright Copyright (c) 2026 Marc-Alexandre Espiaut
+ */
+
+#ifndef TIMING_H
+#define TIMING_H
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#include "types.h"
+
+/* Nanoseconds from an arbitrary origin, never going backwards. Only the
+ * difference between two readings means anything. */
+static INLINE u64
+timing_now(void)
+{
+#if defined(_WIN32)
+  static LARGE_INTEGER frequency;
+  LARGE_INTEGER counter;
+
+  if (!frequency.QuadPart)
+  {
+    QueryPerformanceFrequency(&frequency);
+  }
+  QueryPerformanceCounter(&counter);
+
+  /* Split to keep counter * 1e9 from overflowing. */
+  return (u64)(counter.QuadPart / frequency.QuadPart) * 1000000000 + (u64)(counter.QuadPart % frequency.QuadPart) * 1000000000 / (u64)frequency.QuadPart;
+#else
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (u64)ts.tv_sec * 1000000000 + (u64)ts.tv_nsec;
+#endif
+}
+
+#endif /* TIMING_H */
@@ -28,6 +28,19 @@ typedef signed long long i64;
 typedef unsigned long long u64;
 #endif
 
+/* For the helpers defined in headers: unused ones don't warn. */
+#if !defined(INLINE)
+#if defined(__STDC_VERSION__) && __STDC_VERSION__ >= 199901L
+#define INLINE inline
+#elif defined(_MSC_VER)
+#define INLINE __inline
+#elif defined(__GNUC__)
+#define INLINE __inline__
+#else
+#define INLINE
+#endif
+#endif
+
 typedef float f32;
 typedef double f64;
 
@@ -64,6 +77,15 @@ struct vec2_u8_s
   u8 y;
 };
 
+typedef struct rgba_u8_s rgba_u8_t;
+struct rgba_u8_s
+{
+  u8 r;
+  u8 g;
+  u8 b;
+  u8 a;
+};
+
 typedef struct vec3_i16_s vec3_i16_t;
 struct vec3_i16_s
 {
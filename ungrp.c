@@ -0,0 +1,196 @@
+/* SPDX-License-Identifier: MIT */
+/**
+ * @file   ungrp.c
+ * @author Marc-Alexandre Espiaut <ma.dev@espiaut.fr>
+ * @date   2026-03-12
+ * @version 1.1
+ * @brief  Extracts files from a GRP file.
+ *
+ * @copyright Copyright (c) 2026 Marc-Alexandre Espiaut
+ */
+
+#if defined(__linux__)
+#define _GNU_SOURCE /* O_DIRECT for fileio.h */
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "errorcodes.h"
+#include "fileio.h"
+#include "filelist.h"
+#include "grpextract.h"
+#include "grpreader.h"
+#include "thread.h"
+#include "types.h"
+
+#define UNGRP_VERSION "1.1"
+
+static void
+grp_member_set(GrpExtractEntry* member, const GrpEntry* entry)
+{
+  member->name = entry->name;
+  member->size = entry->size;
+  member->offset = entry->offset;
+}
+
+static void
+grp_list(GrpReader* grp)
+{
+  u32 i = 0;
+
+  for (; i < grp->count; ++i)
+  {
+    fprintf(stdout, "%-12s %10lu bytes at 0x%lx\n", grp->entry[i].name, (unsigned long)grp->entry[i].size, (unsigned long)grp->entry[i].offset);
+  }
+  fprintf(stdout, "%lu files.\n", (unsigned long)grp->count);
+}
+
+static void
+usage(const char* prgname, const char* prgver)
+{
+  fprintf(stderr, "%s %s : Copyright (c) 2026 Marc-Alexandre Espiaut\n", prgname, prgver);
+  fprintf(stderr, "\n");
+  fprintf(stderr, "%s is a tool for extracting group (.grp) files for Build engine games.\n", prgname);
+  fprintf(stderr, "\n");
+  fprintf(stderr, "Usage: %s [options] input.grp [members]\n", prgname);
+  fprintf(stderr, "\n");
+  fprintf(stderr, "Extracts the given members, or all of them, into the current directory.\n");
+  fprintf(stderr, "\n");
+  fprintf(stderr, "Options:\n");
+  fprintf(stderr, "  -h, --help             Show this help message and exit\n");
+  fprintf(stderr, "  -t, --table            List the members instead of extracting them\n");
+  fprintf(stderr, "  -j, --jobs N           Extract with N threads (0: one per CPU)\n");
+  fprintf(stderr, "  -d, --direct           Write large members around the page cache (O_DIRECT)\n");
+  fprintf(stderr, "  -l, --list LIST.TXT    Extract members as listed in LIST.TXT (- for stdin)\n");
+  fprintf(stderr, "\n");
+  fprintf(stderr, "Examples:\n");
+  fprintf(stderr, "  %s DUKE3D.GRP\n", prgname);
+  fprintf(stderr, "  %s DUKE3D.GRP E1L1.MAP E1L2.MAP\n", prgname);
+  fprintf(stderr, "  %s -t DUKE3D.GRP\n", prgname);
+  fprintf(stderr, "  %s -j 0 DUKE3D.GRP\n", prgname);
+  exit(EXIT_FAILURE);
+}
+
+int
+main(int argc, char* argv[])
+{
+  FileList members = {0};
+  GrpReader grp = {0};
+  char* in = NULL;
+  GrpExtractEntry* member = NULL;
+  usize member_count = 0;
+  u32 jobs = 1;
+  int flags = e_fileio_exclusive;
+  int table = 0;
+  int status = EXIT_SUCCESS;
+  int i;
+
+  if (argc < 2)
+  {
+    usage(argv[0], UNGRP_VERSION);
+  }
+
+  for (i = 1; i < argc; ++i)
+  {
+    if (!strcmp(argv[i], "-h") || !strcmp(argv[i], "--help"))
+    {
+      usage(argv[0], UNGRP_VERSION);
+    }
+    else if (!strcmp(argv[i], "-t") || !strcmp(argv[i], "--table"))
+    {
+      table = 1;
+    }
+    else if (!strcmp(argv[i], "-j") || !strcmp(argv[i], "--jobs"))
+    {
+      if (++i == argc)
+      {
+        usage(argv[0], UNGRP_VERSION);
+      }
+      jobs = (u32)strtoul(argv[i], NULL, 10);
+      if (!jobs)
+      {
+        jobs = thread_cpu_count();
+      }
+    }
+    else if (!strcmp(argv[i], "-d") || !strcmp(argv[i], "--direct"))
+    {
+      flags |= e_fileio_direct;
+    }
+    else if (!strcmp(argv[i], "-l") || !strcmp(argv[i], "--list"))
+    {
+      if (++i == argc)
+      {
+        usage(argv[0], UNGRP_VERSION);
+      }
+      filelist_load(&members, argv[i]);
+    }
+    else if (!in)
+    {
+      in = argv[i];
+    }
+    else
+    {
+      filelist_add(&members, argv[i]);
+    }
+  }
+
+  if (!in)
+  {
+    usage(argv[0], UNGRP_VERSION);
+  }
+
+  grpreader_open(&grp, in);
+
+  if (table)
+  {
+    grp_list(&grp);
+  }
+  else
+  {
+    member = malloc(sizeof(*member) * (members.count ? members.count : grp.count ? grp.count : 1));
+    if (!member)
+    {
+      perror("malloc");
+      exit(e_error_malloc);
+    }
+
+    if (!members.count)
+    {
+      for (; member_count < grp.count; ++member_count)
+      {
+        grp_member_set(&member[member_count], &grp.entry[member_count]);
+      }
+      /* Front to back through the whole file. */
+      fileio_map_advise(&grp.ms, 0, grp.ms.size, e_fileio_sequential);
+    }
+    else
+    {
+      usize j = 0;
+      for (; j < members.count; ++j)
+      {
+        i64 found = grpreader_find(&grp, members.path[j]);
+
+        if (found < 0)
+        {
+          fprintf(stderr, "ERROR: %s not found in %s!\n", members.path[j], in);
+          status = EXIT_FAILURE;
+        }
+        else
+        {
+          grp_member_set(&member[member_count++], &grp.entry[found]);
+          fileio_map_advise(&grp.ms, grp.entry[found].offset, grp.entry[found].size, e_fileio_willneed);
+        }
+      }
+    }
+
+    grpextract_members(grp.ms.data, member, member_count, jobs, flags, NULL, NULL, stdout, NULL);
+    free(member);
+  }
+
+  grpreader_close(&grp);
+  filelist_free(&members);
+
+  return status;
+}
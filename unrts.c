@@ -0,0 +1,197 @@
+/* SPDX-License-Identifier: MIT */
+/**
+ * @file   unrts.c
+ * @author Marc-Alexandre Espiaut <ma.dev@espiaut.fr>
+ * @date   2026-03-29
+ * @version 1.1
+ * @brief  Extracts the sounds of an RTS file.
+ *
+ * @copyright Copyright (c) 2026 Marc-Alexandre Espiaut
+ */
+
+#if defined(__linux__)
+#define _GNU_SOURCE /* O_DIRECT for fileio.h */
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "errorcodes.h"
+#include "fileio.h"
+#include "filelist.h"
+#include "grpextract.h"
+#include "rtsreader.h"
+#include "thread.h"
+#include "types.h"
+
+#define UNRTS_VERSION "1.1"
+
+static void
+lump_set(GrpExtractEntry* lump, const RtsEntry* entry)
+{
+  lump->name = entry->name;
+  lump->size = entry->size;
+  lump->offset = entry->offset;
+}
+
+static void
+rts_list(RtsReader* rts)
+{
+  u32 i = 0;
+
+  for (; i < rts->count; ++i)
+  {
+    fprintf(stdout, "%3lu %-8s %10lu bytes at 0x%lx\n", (unsigned long)i, rts->entry[i].name, (unsigned long)rts->entry[i].size, (unsigned long)rts->entry[i].offset);
+  }
+  fprintf(stdout, "%lu lumps.\n", (unsigned long)rts->count);
+}
+
+static void
+usage(const char* prgname, const char* prgver)
+{
+  fprintf(stderr, "%s %s : Copyright (c) 2026 Marc-Alexandre Espiaut\n", prgname, prgver);
+  fprintf(stderr, "\n");
+  fprintf(stderr, "%s is a tool for extracting RemoteRidicule (.rts) files for Duke Nukem 3D.\n", prgname);
+  fprintf(stderr, "\n");
+  fprintf(stderr, "Usage: %s [options] input.rts [lumps]\n", prgname);
+  fprintf(stderr, "\n");
+  fprintf(stderr, "Extracts the given lumps, or all of them, as NAME.VOC into the current\n");
+  fprintf(stderr, "directory.\n");
+  fprintf(stderr, "\n");
+  fprintf(stderr, "Options:\n");
+  fprintf(stderr, "  -h, --help             Show this help message and exit\n");
+  fprintf(stderr, "  -t, --table            List the lumps instead of extracting them\n");
+  fprintf(stderr, "  -j, --jobs N           Extract with N threads (0: one per CPU)\n");
+  fprintf(stderr, "  -d, --direct           Write large lumps around the page cache (O_DIRECT)\n");
+  fprintf(stderr, "  -l, --list LIST.TXT    Extract lumps as listed in LIST.TXT (- for stdin)\n");
+  fprintf(stderr, "\n");
+  fprintf(stderr, "Examples:\n");
+  fprintf(stderr, "  %s DUKE.RTS\n", prgname);
+  fprintf(stderr, "  %s -t DUKE.RTS\n", prgname);
+  fprintf(stderr, "  %s -j 0 DUKE.RTS\n", prgname);
+  exit(EXIT_FAILURE);
+}
+
+int
+main(int argc, char* argv[])
+{
+  FileList lumps = {0};
+  RtsReader rts = {0};
+  char* in = NULL;
+  GrpExtractEntry* lump = NULL;
+  usize lump_count = 0;
+  u32 jobs = 1;
+  int flags = e_fileio_exclusive;
+  int table = 0;
+  int status = EXIT_SUCCESS;
+  int i;
+
+  if (argc < 2)
+  {
+    usage(argv[0], UNRTS_VERSION);
+  }
+
+  for (i = 1; i < argc; ++i)
+  {
+    if (!strcmp(argv[i], "-h") || !strcmp(argv[i], "--help"))
+    {
+      usage(argv[0], UNRTS_VERSION);
+    }
+    else if (!strcmp(argv[i], "-t") || !strcmp(argv[i], "--table"))
+    {
+      table = 1;
+    }
+    else if (!strcmp(argv[i], "-j") || !strcmp(argv[i], "--jobs"))
+    {
+      if (++i == argc)
+      {
+        usage(argv[0], UNRTS_VERSION);
+      }
+      jobs = (u32)strtoul(argv[i], NULL, 10);
+      if (!jobs)
+      {
+        jobs = thread_cpu_count();
+      }
+    }
+    else if (!strcmp(argv[i], "-d") || !strcmp(argv[i], "--direct"))
+    {
+      flags |= e_fileio_direct;
+    }
+    else if (!strcmp(argv[i], "-l") || !strcmp(argv[i], "--list"))
+    {
+      if (++i == argc)
+      {
+        usage(argv[0], UNRTS_VERSION);
+      }
+      filelist_load(&lumps, argv[i]);
+    }
+    else if (!in)
+    {
+      in = argv[i];
+    }
+    else
+    {
+      filelist_add(&lumps, argv[i]);
+    }
+  }
+
+  if (!in)
+  {
+    usage(argv[0], UNRTS_VERSION);
+  }
+
+  rtsreader_open(&rts, in);
+
+  if (table)
+  {
+    rts_list(&rts);
+  }
+  else
+  {
+    lump = malloc(sizeof(*lump) * (lumps.count ? lumps.count : rts.count ? rts.count : 1));
+    if (!lump)
+    {
+      perror("malloc");
+      exit(e_error_malloc);
+    }
+
+    if (!lumps.count)
+    {
+      for (; lump_count < rts.count; ++lump_count)
+      {
+        lump_set(&lump[lump_count], &rts.entry[lump_count]);
+      }
+      /* Front to back through the whole file. */
+      fileio_map_advise(&rts.ms, 0, rts.ms.size, e_fileio_sequential);
+    }
+    else
+    {
+      usize j = 0;
+      for (; j < lumps.count; ++j)
+      {
+        i64 found = rtsreader_find(&rts, lumps.path[j]);
+
+        if (found < 0)
+        {
+          fprintf(stderr, "ERROR: %s not found in %s!\n", lumps.path[j], in);
+          status = EXIT_FAILURE;
+        }
+        else
+        {
+          lump_set(&lump[lump_count++], &rts.entry[found]);
+          fileio_map_advise(&rts.ms, rts.entry[found].offset, rts.entry[found].size, e_fileio_willneed);
+        }
+      }
+    }
+
+    /* Every lump is a VOC, written as NAME.VOC. */
+    grpextract_members(rts.ms.data, lump, lump_count, jobs, flags, NULL, ".VOC", stdout, NULL);
+    free(lump);
+  }
+
+  rtsreader_close(&rts);
+  filelist_free(&lumps);
+
+  return status;
+}
@@ -0,0 +1,389 @@
+/* SPDX-License-Identifier: MIT */
+/**
+ * @file   voc.h
+ * @author Marc-Alexandre Espiaut <ma.dev@espiaut.fr>
+ * @date   2026-03-18
+ * @brief  Creative Voice File (.voc) headers and streaming block walk.
+ *
+ * @copyright Copyright (c) 2026 Marc-Alexandre Espiaut
+ */
+
+#ifndef VOC_H
+#define VOC_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_WIN32)
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+#include "errorcodes.h"
+#include "fileio.h"
+#include "memorystream.h"
+#include "types.h"
+
+typedef struct voc_header_s voc_header_t;
+struct voc_header_s
+{
+  unsigned short size;
+  unsigned short version;
+  unsigned short checksum;
+};
+
+typedef struct block_header_s block_header_t;
+struct block_header_s
+{
+  unsigned char type;
+  unsigned int length;
+};
+
+typedef struct data_type1_s data_type1_t;
+struct data_type1_s
+{
+  unsigned char frequency_divisor;
+  unsigned char codec;
+  unsigned char* data;
+};
+
+typedef struct data_type2_s data_type2_t;
+struct data_type2_s
+{
+  unsigned char* data;
+};
+
+typedef struct data_type3_s data_type3_t;
+struct data_type3_s
+{
+  unsigned short length;
+  unsigned char frequency_divisor;
+};
+
+typedef struct data_type4_s data_type4_t;
+struct data_type4_s
+{
+  unsigned short value;
+};
+
+typedef struct data_type5_s data_type5_t;
+struct data_type5_s
+{
+  char* text;
+};
+
+typedef struct data_type6_s data_type6_t;
+struct data_type6_s
+{
+  unsigned short count;
+};
+
+typedef struct data_type8_s data_type8_t;
+struct data_type8_s
+{
+  unsigned short frequency_divisor;
+  unsigned char codec;
+  unsigned char channels_num;
+};
+
+typedef struct data_type9_s data_type9_t;
+struct data_type9_s
+{
+  unsigned int rate;
+  unsigned char bits;
+  unsigned char channels_num;
+  unsigned short codec;
+  unsigned int reserved;
+  unsigned char* data;
+};
+
+typedef union block_data_u block_data_t;
+union block_data_u
+{
+  data_type1_t type1;
+  data_type2_t type2;
+  data_type3_t type3;
+  data_type4_t type4;
+  data_type5_t type5;
+  data_type6_t type6;
+  data_type8_t type8;
+  data_type9_t type9;
+};
+
+typedef struct block_s block_t;
+struct block_s
+{
+  block_header_t header;
+  block_data_t data;
+};
+
+typedef struct voc_s voc_t;
+struct voc_s
+{
+  voc_header_t header;
+  block_t* block;
+};
+
+enum
+{
+  e_vocstream_capacity = 65536
+};
+
+/* A VOC file read front to back through one fixed-size buffer: memory use
+ * doesn't depend on the file size, and a pipe works like a file, its
+ * blocks being handled as soon as they arrive. The buffer slides rather
+ * than wraps: when a view needs more than what is left of it, usually a
+ * few bytes, those are moved to the front before it is refilled, so that
+ * every view into it is contiguous. */
+typedef struct VocStream VocStream;
+struct VocStream
+{
+  FILE* fp;
+  u8* buffer;
+  usize head; /* first byte not consumed */
+  usize tail; /* end of the bytes read */
+  i64 position; /* file offset of buffer[head] */
+  u32 remaining; /* data of the current block not consumed yet */
+  int eof;
+  int seekable;
+};
+
+/* "-" reads stdin. */
+static INLINE void
+vocstream_open(VocStream* vs, const char* path)
+{
+  memset(vs, 0, sizeof(*vs));
+
+  if (!strcmp(path, "-"))
+  {
+#if defined(_WIN32)
+    _setmode(_fileno(stdin), _O_BINARY);
+#endif
+    vs->fp = stdin;
+  }
+  else
+  {
+    vs->fp = fopen(path, "rb");
+  }
+
+  vs->buffer = malloc(e_vocstream_capacity);
+  if (!vs->fp)
+  {
+    perror("fopen");
+    exit(e_error_fopen);
+  }
+  if (!vs->buffer)
+  {
+    perror("malloc");
+    exit(e_error_malloc);
+  }
+
+  vs->seekable = vs->fp != stdin && !fseek(vs->fp, 0, SEEK_CUR);
+  if (vs->seekable)
+  {
+    /* Blocks are read front to back; seeks only skip unwanted ones. */
+    fileio_advise_sequential(fileno(vs->fp));
+  }
+}
+
+/* Reads size bytes already in memory, such as a MemoryStream, in place.
+ * Nothing to close. */
+static INLINE void
+vocstream_open_memory(VocStream* vs, const u8* data, i64 size)
+{
+  memset(vs, 0, sizeof(*vs));
+  vs->buffer = (u8*)data;
+  vs->tail = (usize)size;
+  vs->eof = 1;
+}
+
+static INLINE void
+vocstream_close(VocStream* vs)
+{
+  if (vs->fp != stdin && fclose(vs->fp) == EOF)
+  {
+    perror("fclose");
+    exit(e_error_fclose);
+  }
+  free(vs->buffer);
+  memset(vs, 0, sizeof(*vs));
+}
+
+/* Makes up to n bytes at the current position, n being at most the
+ * capacity, contiguous from buffer + head. Returns how many there are:
+ * fewer than n only at the end of the file. */
+static INLINE usize
+vocstream_fill(VocStream* vs, usize n)
+{
+  if (vs->tail - vs->head < n && !vs->eof)
+  {
+    memmove(vs->buffer, vs->buffer + vs->head, vs->tail - vs->head);
+    vs->tail -= vs->head;
+    vs->head = 0;
+
+    while (vs->tail < n && !vs->eof)
+    {
+      usize got = fread(vs->buffer + vs->tail, 1, e_vocstream_capacity - vs->tail, vs->fp);
+
+      if (!got)
+      {
+        if (ferror(vs->fp))
+        {
+          perror("fread");
+          exit(e_error_fread);
+        }
+        vs->eof = 1;
+      }
+      vs->tail += got;
+    }
+  }
+
+  return vs->tail - vs->head < n ? vs->tail - vs->head : n;
+}
+
+/* Moves n bytes ahead, seeking over what isn't buffered when possible.
+ * Past the end of the file simply leaves nothing more to read. */
+static INLINE void
+vocstream_skip(VocStream* vs, u64 n)
+{
+  usize buffered = vs->tail - vs->head;
+
+  if (n <= buffered)
+  {
+    vs->head += (usize)n;
+    vs->position += (i64)n;
+    return;
+  }
+
+  n -= buffered;
+  vs->position += (i64)buffered;
+  vs->head = 0;
+  vs->tail = 0;
+
+  if (vs->seekable && !vs->eof && n <= 0x7FFFFFFF && !fseek(vs->fp, (long)n, SEEK_CUR))
+  {
+    vs->position += (i64)n;
+    return;
+  }
+
+  while (n)
+  {
+    usize have = vocstream_fill(vs, n < e_vocstream_capacity ? (usize)n : e_vocstream_capacity);
+
+    if (!have)
+    {
+      vs->position += (i64)n;
+      return;
+    }
+    vs->head += have;
+    vs->position += (i64)have;
+    n -= have;
+  }
+}
+
+/* Copies n bytes at the current position into dst, zero-filling whatever
+ * lies past the end of the file, without consuming them. Returns how many
+ * bytes were really there. */
+static INLINE usize
+voc_peek(VocStream* vs, u8* dst, usize n)
+{
+  usize have = vocstream_fill(vs, n);
+
+  memset(dst, 0, n);
+  memcpy(dst, vs->buffer + vs->head, have);
+
+  return have;
+}
+
+/* Hands out the next piece of the current block's data, consuming it:
+ * what is buffered, or a buffer's worth. Pieces are a multiple of align
+ * bytes but for the last one of a block. Returns 0 at the end of the
+ * block or of the file. */
+static INLINE usize
+vocstream_read(VocStream* vs, const u8** data, usize align)
+{
+  usize n = vs->remaining < e_vocstream_capacity ? vs->remaining : e_vocstream_capacity;
+  usize have = 0;
+
+  if (vs->tail - vs->head >= align || vs->tail - vs->head >= n)
+  {
+    have = vs->tail - vs->head < n ? vs->tail - vs->head : n;
+  }
+  else if (n)
+  {
+    have = vocstream_fill(vs, n);
+  }
+
+  if (have < n && have % align)
+  {
+    have -= have % align;
+  }
+
+  *data = vs->buffer + vs->head;
+  vs->head += have;
+  vs->position += (i64)have;
+  vs->remaining = have ? vs->remaining - (u32)have : 0;
+
+  return have;
+}
+
+/* Consumes the first n bytes of the current block's data. */
+static INLINE void
+vocstream_data_skip(VocStream* vs, u32 n)
+{
+  n = n < vs->remaining ? n : vs->remaining;
+  vocstream_skip(vs, n);
+  vs->remaining -= n;
+}
+
+/* Checks the signature and reads the header that follows it. Returns 0,
+ * and leaves the stream alone, when this isn't a VOC file. */
+static INLINE int
+voc_header_parse(VocStream* vs, voc_header_t* header)
+{
+  u8 data[26] = {0};
+  usize have = voc_peek(vs, data, sizeof(data));
+
+  if (have < 20 || memcmp("Creative Voice File\x1a", data, 20))
+  {
+    return 0;
+  }
+
+  header->size = u16_le_get(data + 20);
+  header->version = u16_le_get(data + 22);
+  header->checksum = u16_le_get(data + 24);
+  vocstream_skip(vs, have);
+
+  return 1;
+}
+
+/* Reads the next block header, skipping whatever is left of the current
+ * block. Returns 0 once the stream is exhausted; otherwise the block data
+ * starts at file offset *offset, where the stream now is, and
+ * vs->remaining is its length, which a truncated file may not hold. */
+static INLINE int
+voc_block_next(VocStream* vs, block_header_t* bh, i64* offset)
+{
+  u8 header[4] = {0};
+  usize have = 0;
+
+  vocstream_skip(vs, vs->remaining);
+  vs->remaining = 0;
+
+  have = voc_peek(vs, header, 4);
+  if (!have)
+  {
+    return 0;
+  }
+
+  bh->type = header[0];
+  bh->length = header[1] | (header[2] << 8) | ((u32)header[3] << 16);
+  vocstream_skip(vs, have);
+  *offset = vs->position;
+  vs->remaining = bh->length;
+
+  return 1;
+}
+
+#endif /* VOC_H */
@@ -0,0 +1,580 @@
+/* SPDX-License-Identifier: MIT */
+/**
+ * @file   voc2wav.c
+ * @author Marc-Alexandre Espiaut <ma.dev@espiaut.fr>
+ * @date   2026-03-22
+ * @version 1.1
+ * @brief  Converts VOC files to 16 bits PCM WAV files.
+ *
+ * @copyright Copyright (c) 2026 Marc-Alexandre Espiaut
+ */
+
+#if defined(__linux__)
+#define _XOPEN_SOURCE 700 /* pwrite(), posix_memalign() for fileio.h */
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "errorcodes.h"
+#include "fileio.h"
+#include "filelist.h"
+#include "memorystream.h"
+#include "outputbuffer.h"
+#include "pipeline.h"
+#include "thread.h"
+#include "types.h"
+#include "voc.h"
+#include "vocdecode.h"
+
+#define VOC2WAV_VERSION "1.1"
+
+enum
+{
+  e_wav_header_len = 44,
+  e_wav_chunk = 65536, /* samples buffered between two writes */
+  e_wav_default_rate = 11025 /* for files without any sound block */
+};
+
+/* Samples go through one large buffer, into a file or into memory; the
+ * header is written last, once the sizes are known. */
+typedef struct wav_writer_s wav_writer_t;
+struct wav_writer_s
+{
+  FileWriter file;
+  OutputBuffer* ob; /* instead of file */
+  const char* path;
+  i16* sample;
+  usize count; /* buffered samples */
+  u64 data_bytes; /* already written */
+  u32 rate; /* 0 until the first sound block */
+  u16 channels;
+};
+
+static void
+wav_flush(wav_writer_t* wav)
+{
+  u16 one = 1;
+
+  if (!wav->count)
+  {
+    return;
+  }
+
+  if (wav->data_bytes + wav->count * 2 > 0xFFFFFFFFu - (e_wav_header_len - 8))
+  {
+    fprintf(stderr, "ERROR: %s would be over 4 GiB!\n", wav->path);
+    exit(e_error_format);
+  }
+
+  /* Samples are kept in host order. */
+  if (!*(u8*)&one)
+  {
+    usize i = 0;
+    for (; i < wav->count; ++i)
+    {
+      u16 s = (u16)wav->sample[i];
+      wav->sample[i] = (i16)((s >> 8) | (s << 8));
+    }
+  }
+
+  if (wav->ob)
+  {
+    outputbuffer_write(wav->ob, wav->sample, wav->count * 2);
+  }
+  else
+  {
+    fileio_writer_write(&wav->file, wav->sample, wav->count * 2);
+  }
+
+  wav->data_bytes += wav->count * 2;
+  wav->count = 0;
+}
+
+/* Returns room for n samples, n being at most e_wav_chunk. The caller
+ * adds what it wrote to wav->count. */
+static i16*
+wav_reserve(wav_writer_t* wav, usize n)
+{
+  if (wav->count + n > e_wav_chunk)
+  {
+    wav_flush(wav);
+  }
+
+  return wav->sample + wav->count;
+}
+
+static void
+wav_header_write(wav_writer_t* wav)
+{
+  u8 header[e_wav_header_len] = {0};
+  u32 data_bytes = (u32)wav->data_bytes;
+
+  memcpy(header + 0, "RIFF", 4);
+  u32_le_put(header + 4, data_bytes + e_wav_header_len - 8);
+  memcpy(header + 8, "WAVE", 4);
+  memcpy(header + 12, "fmt ", 4);
+  u32_le_put(header + 16, 16);
+  u16_le_put(header + 20, 1); /* PCM */
+  u16_le_put(header + 22, wav->channels);
+  u32_le_put(header + 24, wav->rate);
+  u32_le_put(header + 28, wav->rate * wav->channels * 2);
+  u16_le_put(header + 32, (u16)(wav->channels * 2));
+  u16_le_put(header + 34, 16);
+  memcpy(header + 36, "data", 4);
+  u32_le_put(header + 40, data_bytes);
+
+  if (wav->ob)
+  {
+    memcpy(wav->ob->data, header, sizeof(header));
+    return;
+  }
+
+  fileio_writer_patch(&wav->file, 0, header, sizeof(header));
+}
+
+/* ob is NULL to write straight to path. */
+static void
+wav_open(wav_writer_t* wav, const char* path, OutputBuffer* ob)
+{
+  u8 header[e_wav_header_len] = {0};
+
+  memset(wav, 0, sizeof(*wav));
+
+  wav->path = path;
+  wav->ob = ob;
+  wav->sample = malloc(sizeof(*wav->sample) * e_wav_chunk);
+  if (!wav->sample)
+  {
+    perror("malloc");
+    exit(e_error_malloc);
+  }
+
+  /* Room for the header; it is filled in by wav_close(). */
+  if (ob)
+  {
+    outputbuffer_write(ob, header, sizeof(header));
+    return;
+  }
+
+  fileio_writer_open(&wav->file, path, 0);
+  fileio_writer_write(&wav->file, header, sizeof(header));
+}
+
+static void
+wav_close(wav_writer_t* wav)
+{
+  wav_flush(wav);
+
+  if (!wav->rate)
+  {
+    wav->rate = e_wav_default_rate;
+    wav->channels = 1;
+  }
+  wav_header_write(wav);
+
+  if (!wav->ob)
+  {
+    fileio_writer_close(&wav->file);
+  }
+
+  free(wav->sample);
+  wav->sample = NULL;
+}
+
+/* The sound format in effect, from the last sound block. */
+typedef struct decoder_s decoder_t;
+struct decoder_s
+{
+  const char* path;
+  int codec; /* -1 when continuation blocks are to be skipped */
+  VocAdpcm adpcm;
+  int extra; /* a type 8 block sets the format of the next type 1 */
+  u32 extra_rate;
+  u32 extra_channels;
+  int extra_codec;
+};
+
+static void
+sound_start(decoder_t* dec, wav_writer_t* wav, i64 offset, u32 rate, u32 channels, int codec)
+{
+  int adpcm = codec == e_voc_codec_adpcm4 || codec == e_voc_codec_adpcm3 || codec == e_voc_codec_adpcm2;
+
+  if ((codec != e_voc_codec_u8 && codec != e_voc_codec_s16 && !adpcm) || (adpcm && channels != 1) || !channels)
+  {
+    fprintf(stderr, "WARN: %s: skipping the block at 0x%lx, codec 0x%x with %u channels isn't supported.\n", dec->path, (long)offset, codec, channels);
+    dec->codec = -1;
+    return;
+  }
+
+  if (!wav->rate)
+  {
+    wav->rate = rate;
+    wav->channels = (u16)channels;
+  }
+  else if (wav->rate != rate || wav->channels != channels)
+  {
+    fprintf(stderr, "WARN: %s: the block at 0x%lx is %u Hz with %u channels, written as %u Hz with %u channels.\n", dec->path, (long)offset, rate, channels, wav->rate, wav->channels);
+  }
+
+  dec->codec = codec;
+  if (adpcm)
+  {
+    vocdecode_adpcm_start(&dec->adpcm);
+  }
+}
+
+/* Decodes n bytes in the current codec, a buffer's worth at a time. */
+static void
+sound_decode(decoder_t* dec, wav_writer_t* wav, const u8* src, usize n)
+{
+  if (dec->codec < 0)
+  {
+    return;
+  }
+
+  if (dec->codec == e_voc_codec_s16)
+  {
+    usize count = n / 2;
+
+    while (count)
+    {
+      usize take = count < e_wav_chunk ? count : e_wav_chunk;
+
+      vocdecode_s16(src, take, wav_reserve(wav, take));
+      wav->count += take;
+      src += take * 2;
+      count -= take;
+    }
+  }
+  else
+  {
+    usize per_byte = vocdecode_samples_per_byte(dec->codec);
+
+    while (n)
+    {
+      usize take = n < e_wav_chunk / per_byte ? n : e_wav_chunk / per_byte;
+      i16* dst = wav_reserve(wav, take * per_byte);
+
+      if (dec->codec == e_voc_codec_u8)
+      {
+        vocdecode_u8(src, take, dst);
+        wav->count += take;
+      }
+      else
+      {
+        wav->count += vocdecode_adpcm(&dec->adpcm, dec->codec, src, take, dst);
+      }
+      src += take;
+      n -= take;
+    }
+  }
+}
+
+/* Decodes what is left of the current block, a piece at a time. */
+static void
+sound_stream(decoder_t* dec, wav_writer_t* wav, VocStream* vs)
+{
+  const u8* data = NULL;
+  usize n = 0;
+
+  while (dec->codec >= 0 && (n = vocstream_read(vs, &data, dec->codec == e_voc_codec_s16 ? 2 : 1)))
+  {
+    sound_decode(dec, wav, data, n);
+  }
+}
+
+static void
+silence_write(wav_writer_t* wav, usize n)
+{
+  n *= wav->channels ? wav->channels : 1;
+
+  while (n)
+  {
+    usize take = n < e_wav_chunk ? n : e_wav_chunk;
+
+    memset(wav_reserve(wav, take), 0, take * sizeof(i16));
+    wav->count += take;
+    n -= take;
+  }
+}
+
+/* Markers, texts and repeats are left out: loops are played once. */
+static void
+voc_transcode(VocStream* vs, wav_writer_t* wav, const char* path)
+{
+  decoder_t dec = {0};
+  block_header_t bh = {0};
+  i64 offset = 0;
+
+  dec.path = path;
+  dec.codec = -1;
+
+  while (voc_block_next(vs, &bh, &offset) && bh.type)
+  {
+    u8 data[12];
+    usize n = voc_peek(vs, data, sizeof(data));
+
+    /* n is how much of the block's own head the file holds. */
+    n = bh.length < n ? bh.length : n;
+
+    switch (bh.type)
+    {
+      case 1:
+        if (n >= 2)
+        {
+          if (dec.extra)
+          {
+            sound_start(&dec, wav, offset, dec.extra_rate, dec.extra_channels, dec.extra_codec);
+            dec.extra = 0;
+          }
+          else
+          {
+            sound_start(&dec, wav, offset, 1000000 / (256 - data[0]), 1, data[1]);
+          }
+          vocstream_data_skip(vs, 2);
+          sound_stream(&dec, wav, vs);
+        }
+        break;
+      case 2:
+        sound_stream(&dec, wav, vs);
+        break;
+      case 3:
+        if (n >= 3)
+        {
+          if (!wav->rate)
+          {
+            wav->rate = 1000000 / (256 - data[2]);
+            wav->channels = 1;
+          }
+          silence_write(wav, (usize)u16_le_get(data) + 1);
+        }
+        break;
+      case 8:
+        if (n >= 4)
+        {
+          dec.extra = 1;
+          dec.extra_channels = (u32)data[3] + 1;
+          dec.extra_rate = 256000000 / (dec.extra_channels * (65536 - u16_le_get(data)));
+          dec.extra_codec = data[2];
+        }
+        break;
+      case 9:
+        if (n >= 12)
+        {
+          sound_start(&dec, wav, offset, u32_le_get(data), data[5], u16_le_get(data + 6));
+          vocstream_data_skip(vs, 12);
+          sound_stream(&dec, wav, vs);
+        }
+        break;
+      default:
+        break;
+    }
+  }
+}
+
+/* The input is streamed, so memory use doesn't depend on its size. */
+static void
+voc_convert(char* in, const char* out)
+{
+  VocStream vs;
+  voc_header_t header = {0};
+  wav_writer_t wav;
+
+  vocstream_open(&vs, in);
+
+  if (!voc_header_parse(&vs, &header))
+  {
+    fprintf(stderr, "%s isn't a Creative Voice FIle!\n", in);
+    vocstream_close(&vs);
+    return;
+  }
+
+  fprintf(stdout, "Converting %s to %s.\n", in, out);
+  wav_open(&wav, out, NULL);
+  voc_transcode(&vs, &wav, in);
+  wav_close(&wav);
+  vocstream_close(&vs);
+}
+
+/* The same, for the pipeline: from memory to memory. */
+static void
+voc_convert_job(PipelineJob* job, void* context)
+{
+  VocStream vs;
+  voc_header_t header = {0};
+  wav_writer_t wav;
+
+  (void)context;
+  vocstream_open_memory(&vs, job->input.data, job->input.size);
+
+  if (!voc_header_parse(&vs, &header))
+  {
+    fprintf(stderr, "%s isn't a Creative Voice FIle!\n", job->in);
+    return;
+  }
+
+  wav_open(&wav, job->out, &job->output);
+  voc_transcode(&vs, &wav, job->in);
+  wav_close(&wav);
+  job->ok = 1;
+}
+
+static void
+usage(const char* prgname, const char* prgver)
+{
+  fprintf(stderr, "%s %s : Copyright (c) 2026 Marc-Alexandre Espiaut\n", prgname, prgver);
+  fprintf(stderr, "\n");
+  fprintf(stderr, "%s is a tool for converting Creative Voice Files (.voc) to WAV files.\n", prgname);
+  fprintf(stderr, "\n");
+  fprintf(stderr, "Usage: %s [options] [files]\n", prgname);
+  fprintf(stderr, "\n");
+  fprintf(stderr, "Each FILE.VOC is written as FILE.wav, in 16 bits PCM. - reads stdin and\n");
+  fprintf(stderr, "needs --output.\n");
+  fprintf(stderr, "\n");
+  fprintf(stderr, "Options:\n");
+  fprintf(stderr, "  -h, --help             Show this help message and exit\n");
+  fprintf(stderr, "  -o, --output FILE.WAV  Write the only input to FILE.WAV instead\n");
+  fprintf(stderr, "  -f, --force            Overwrite existing WAV files\n");
+  fprintf(stderr, "  -l, --list LIST.TXT    Add files as listed in LIST.TXT (- for stdin)\n");
+  fprintf(stderr, "  -j, --jobs N           Convert N files in parallel (0: one per CPU)\n");
+  fprintf(stderr, "\n");
+  fprintf(stderr, "Examples:\n");
+  fprintf(stderr, "  %s GOTHOLE.VOC\n", prgname);
+  fprintf(stderr, "  %s -o hole.wav GOTHOLE.VOC\n", prgname);
+  fprintf(stderr, "  find sounds -name '*.voc' | %s -j 0 -l -\n", prgname);
+  exit(EXIT_FAILURE);
+}
+
+int
+main(int argc, char* argv[])
+{
+  FileList files = {0};
+  const char* output = NULL;
+  char** out = NULL;
+  int force = 0;
+  u32 jobs = 1;
+  usize j = 0;
+  int i;
+
+  if (argc < 2)
+  {
+    usage(argv[0], VOC2WAV_VERSION);
+  }
+
+  for (i = 1; i < argc; ++i)
+  {
+    if (!strcmp(argv[i], "-h") || !strcmp(argv[i], "--help"))
+    {
+      usage(argv[0], VOC2WAV_VERSION);
+    }
+    else if (!strcmp(argv[i], "-o") || !strcmp(argv[i], "--output"))
+    {
+      if (++i == argc)
+      {
+        usage(argv[0], VOC2WAV_VERSION);
+      }
+      output = argv[i];
+    }
+    else if (!strcmp(argv[i], "-f") || !strcmp(argv[i], "--force"))
+    {
+      force = 1;
+    }
+    else if (!strcmp(argv[i], "-l") || !strcmp(argv[i], "--list"))
+    {
+      if (++i == argc)
+      {
+        usage(argv[0], VOC2WAV_VERSION);
+      }
+      filelist_load(&files, argv[i]);
+    }
+    else if (!strcmp(argv[i], "-j") || !strcmp(argv[i], "--jobs"))
+    {
+      if (++i == argc)
+      {
+        usage(argv[0], VOC2WAV_VERSION);
+      }
+      jobs = (u32)strtoul(argv[i], NULL, 10);
+      if (!jobs)
+      {
+        jobs = thread_cpu_count();
+      }
+    }
+    else
+    {
+      filelist_add(&files, argv[i]);
+    }
+  }
+
+  if (output && files.count != 1)
+  {
+    fprintf(stderr, "ERROR: --output takes exactly one input file!\n");
+    exit(EXIT_FAILURE);
+  }
+
+  out = calloc(files.count ? files.count : 1, sizeof(*out));
+  if (!out)
+  {
+    perror("calloc");
+    exit(e_error_malloc);
+  }
+
+  for (; j < files.count; ++j)
+  {
+    if (output)
+    {
+      out[j] = malloc(strlen(output) + 1);
+      if (!out[j])
+      {
+        perror("malloc");
+        exit(e_error_malloc);
+      }
+      strcpy(out[j], output);
+    }
+    else if (!strcmp(files.path[j], "-"))
+    {
+      fprintf(stderr, "ERROR: Reading stdin needs --output!\n");
+      exit(EXIT_FAILURE);
+    }
+    else
+    {
+      out[j] = path_extension_replace(files.path[j], ".wav");
+    }
+
+    if (!force)
+    {
+      fileio_abort_if_exists(out[j]);
+    }
+  }
+
+  vocdecode_init();
+
+  if (jobs > files.count)
+  {
+    jobs = (u32)files.count;
+  }
+
+  /* One file at a time is streamed; a batch is loaded whole, file by file,
+   * while others are decoded. */
+  if (jobs > 1)
+  {
+    pipeline_run(files.path, out, files.count, jobs, voc_convert_job, NULL);
+  }
+  else
+  {
+    for (j = 0; j < files.count; ++j)
+    {
+      voc_convert(files.path[j], out[j]);
+    }
+  }
+
+  for (j = 0; j < files.count; ++j)
+  {
+    free(out[j]);
+  }
+  free(out);
+  filelist_free(&files);
+
+  return EXIT_SUCCESS;
+}
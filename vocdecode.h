@@ -0,0 +1,292 @@
+/* SPDX-License-Identifier: MIT */
+/**
+ * @file   vocdecode.h
+ * @author Marc-Alexandre Espiaut <ma.dev@espiaut.fr>
+ * @date   2026-03-22
+ * @brief  Decoding of VOC sound data to signed 16 bits samples.
+ *
+ * 8 bits samples are widened to the full 16 bits range, (x - 128) << 8,
+ * so every codec comes out at the same loudness.
+ *
+ * Creative ADPCM follows the Sound Blaster Pro hardware as documented by
+ * FFmpeg's adpcm_sbpro decoder: a 7 bits predictor scaled by 128, a step
+ * in [0, 3] that grows on large deltas and shrinks on zero ones. A sound
+ * block starts with a reference byte, a plain 8 bits sample the predictor
+ * starts from; continuation blocks carry on from where the last one was.
+ *
+ * @copyright Copyright (c) 2026 Marc-Alexandre Espiaut
+ */
+
+#ifndef VOCDECODE_H
+#define VOCDECODE_H
+
+#include <string.h>
+
+#include "memorystream.h"
+#include "types.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define VOCDECODE_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define VOCDECODE_NEON
+#endif
+
+/* Codecs of block types 1 and 9, as in vocinfo's codec_name_get(). */
+enum
+{
+  e_voc_codec_u8 = 0x00,
+  e_voc_codec_adpcm4 = 0x01,
+  e_voc_codec_adpcm3 = 0x02,
+  e_voc_codec_adpcm2 = 0x03,
+  e_voc_codec_s16 = 0x04
+};
+
+/* Samples decoded from one input byte, for every codec but s16: each
+ * Creative ADPCM byte packs this many codes. The reference byte yields a
+ * single sample, so it never needs more room. */
+static INLINE usize
+vocdecode_samples_per_byte(int codec)
+{
+  switch (codec)
+  {
+    case e_voc_codec_adpcm4:
+      return 2;
+      break;
+    case e_voc_codec_adpcm3:
+      return 3;
+      break;
+    case e_voc_codec_adpcm2:
+      return 4;
+      break;
+    default:
+      return 1;
+      break;
+  }
+}
+
+/* u8 PCM: n samples from n bytes. */
+static INLINE void
+vocdecode_u8(const u8* src, usize n, i16* dst)
+{
+  usize i = 0;
+
+#if defined(VOCDECODE_SSE2)
+  {
+    const __m128i bias = _mm_set1_epi8((char)0x80);
+    const __m128i zero = _mm_setzero_si128();
+
+    /* Flipping the top bit makes x - 128 a signed byte; unpacking it into
+     * the high half of each lane shifts it left by 8 for free. */
+    for (; i + 16 <= n; i += 16)
+    {
+      __m128i x = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(src + i)), bias);
+      _mm_storeu_si128((__m128i*)(dst + i), _mm_unpacklo_epi8(zero, x));
+      _mm_storeu_si128((__m128i*)(dst + i + 8), _mm_unpackhi_epi8(zero, x));
+    }
+  }
+#elif defined(VOCDECODE_NEON)
+  {
+    const uint8x16_t bias = vdupq_n_u8(0x80);
+
+    for (; i + 16 <= n; i += 16)
+    {
+      int8x16_t x = vreinterpretq_s8_u8(veorq_u8(vld1q_u8(src + i), bias));
+      vst1q_s16(dst + i, vshll_n_s8(vget_low_s8(x), 8));
+      vst1q_s16(dst + i + 8, vshll_n_s8(vget_high_s8(x), 8));
+    }
+  }
+#endif
+
+  for (; i < n; ++i)
+  {
+    dst[i] = (i16)((src[i] - 128) * 256);
+  }
+}
+
+/* s16 PCM: n samples from 2n little-endian bytes. */
+static INLINE void
+vocdecode_s16(const u8* src, usize n, i16* dst)
+{
+  usize i = 0;
+
+  for (; i < n; ++i)
+  {
+    dst[i] = i16_le_get(src + 2 * i);
+  }
+}
+
+/* What one ADPCM byte does, for a given step going in: the predictor
+ * deltas of its codes in order, and the step coming out. Laying the codes
+ * of a byte out ahead of time leaves only the adds and the clamps in the
+ * loop, with no branch on the codes. */
+typedef struct VocAdpcmEntry VocAdpcmEntry;
+struct VocAdpcmEntry
+{
+  i16 delta[4];
+  u8 step;
+};
+
+/* Indexed by codec - 1, then by step * 256 + byte. */
+static VocAdpcmEntry vocdecode_adpcm_table[3][4 * 256];
+
+typedef struct VocAdpcm VocAdpcm;
+struct VocAdpcm
+{
+  i32 predictor; /* in [-16384, 16256], 128 times an 8 bits sample */
+  u32 step;
+  int reference; /* the next byte is a reference byte */
+};
+
+/* One code of size bits, its top bit being the sign. */
+static INLINE i32
+vocdecode_adpcm_code(u32* step, u32 code, u32 size, u32 shift)
+{
+  u32 magnitude = code & ((1u << (size - 1)) - 1);
+  i32 delta = (i32)(magnitude << (7 + *step + shift));
+
+  if (magnitude >= 2 * size - 3 && *step < 3)
+  {
+    ++*step;
+  }
+  else if (!magnitude && *step > 0)
+  {
+    --*step;
+  }
+
+  return code & (1u << (size - 1)) ? -delta : delta;
+}
+
+/* Fills the three byte tables. Cheap, but must run before the first
+ * decode, and before any thread decodes. */
+static INLINE void
+vocdecode_init(void)
+{
+  u32 step = 0;
+
+  for (; step < 4; ++step)
+  {
+    u32 byte = 0;
+
+    for (; byte < 256; ++byte)
+    {
+      VocAdpcmEntry* e4 = &vocdecode_adpcm_table[0][step * 256 + byte];
+      VocAdpcmEntry* e3 = &vocdecode_adpcm_table[1][step * 256 + byte];
+      VocAdpcmEntry* e2 = &vocdecode_adpcm_table[2][step * 256 + byte];
+      u32 s = step;
+
+      e4->delta[0] = (i16)vocdecode_adpcm_code(&s, byte >> 4, 4, 0);
+      e4->delta[1] = (i16)vocdecode_adpcm_code(&s, byte & 0xF, 4, 0);
+      e4->step = (u8)s;
+
+      s = step;
+      e3->delta[0] = (i16)vocdecode_adpcm_code(&s, byte >> 5, 3, 0);
+      e3->delta[1] = (i16)vocdecode_adpcm_code(&s, (byte >> 2) & 0x7, 3, 0);
+      e3->delta[2] = (i16)vocdecode_adpcm_code(&s, byte & 0x3, 2, 0);
+      e3->step = (u8)s;
+
+      s = step;
+      e2->delta[0] = (i16)vocdecode_adpcm_code(&s, byte >> 6, 2, 2);
+      e2->delta[1] = (i16)vocdecode_adpcm_code(&s, (byte >> 4) & 0x3, 2, 2);
+      e2->delta[2] = (i16)vocdecode_adpcm_code(&s, (byte >> 2) & 0x3, 2, 2);
+      e2->delta[3] = (i16)vocdecode_adpcm_code(&s, byte & 0x3, 2, 2);
+      e2->step = (u8)s;
+    }
+  }
+}
+
+/* Called at each sound block: the next byte is its reference. */
+static INLINE void
+vocdecode_adpcm_start(VocAdpcm* state)
+{
+  state->predictor = 0;
+  state->step = 0;
+  state->reference = 1;
+}
+
+static INLINE i32
+vocdecode_adpcm_clamp(i32 predictor)
+{
+  return predictor < -16384 ? -16384 : predictor > 16256 ? 16256 : predictor;
+}
+
+/* Decodes n bytes of an ADPCM codec into dst, which must have room for
+ * n * vocdecode_samples_per_byte(codec) samples. Returns how many samples
+ * were written. */
+static INLINE usize
+vocdecode_adpcm(VocAdpcm* state, int codec, const u8* src, usize n, i16* dst)
+{
+  const VocAdpcmEntry* table = vocdecode_adpcm_table[codec - 1];
+  usize per_byte = vocdecode_samples_per_byte(codec);
+  i16* start = dst;
+  i32 p = state->predictor;
+  u32 step = state->step;
+  usize i = 0;
+
+  if (n && state->reference)
+  {
+    p = (src[0] - 128) * 128;
+    *dst++ = (i16)(p * 2);
+    state->reference = 0;
+    i = 1;
+  }
+
+  /* The codes of a byte depend on each other only through the predictor;
+   * the samples are gathered and stored together. */
+  switch (per_byte)
+  {
+    case 2:
+      for (; i < n; ++i, dst += 2)
+      {
+        const VocAdpcmEntry* e = &table[step * 256 + src[i]];
+        i32 a = vocdecode_adpcm_clamp(p + e->delta[0]);
+        i32 b = vocdecode_adpcm_clamp(a + e->delta[1]);
+
+        dst[0] = (i16)(a * 2);
+        dst[1] = (i16)(b * 2);
+        p = b;
+        step = e->step;
+      }
+      break;
+    case 3:
+      for (; i < n; ++i, dst += 3)
+      {
+        const VocAdpcmEntry* e = &table[step * 256 + src[i]];
+        i32 a = vocdecode_adpcm_clamp(p + e->delta[0]);
+        i32 b = vocdecode_adpcm_clamp(a + e->delta[1]);
+        i32 c = vocdecode_adpcm_clamp(b + e->delta[2]);
+
+        dst[0] = (i16)(a * 2);
+        dst[1] = (i16)(b * 2);
+        dst[2] = (i16)(c * 2);
+        p = c;
+        step = e->step;
+      }
+      break;
+    default:
+      for (; i < n; ++i, dst += 4)
+      {
+        const VocAdpcmEntry* e = &table[step * 256 + src[i]];
+        i32 a = vocdecode_adpcm_clamp(p + e->delta[0]);
+        i32 b = vocdecode_adpcm_clamp(a + e->delta[1]);
+        i32 c = vocdecode_adpcm_clamp(b + e->delta[2]);
+        i32 d = vocdecode_adpcm_clamp(c + e->delta[3]);
+
+        dst[0] = (i16)(a * 2);
+        dst[1] = (i16)(b * 2);
+        dst[2] = (i16)(c * 2);
+        dst[3] = (i16)(d * 2);
+        p = d;
+        step = e->step;
+      }
+      break;
+  }
+
+  state->predictor = p;
+  state->step = step;
+
+  return (usize)(dst - start);
+}
+
+#endif /* VOCDECODE_H */
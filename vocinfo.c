@@ -9,199 +9,22 @@
  * @copyright Copyright (c) 2026 Marc-Alexandre Espiaut
  */
 
+#if defined(__linux__)
+#define _XOPEN_SOURCE 700 /* pwrite(), posix_memalign() for fileio.h */
+#endif
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
-#define VOCINFO_VERSION "1.1"
-
-enum
-{
-  error_fclose = 2,
-  error_fopen,
-  error_fseek,
-  error_ftell,
-  error_fwrite,
-  error_name_upper
-};
-
-typedef struct voc_header_s voc_header_t;
-struct voc_header_s
-{
-  unsigned short size;
-  unsigned short version;
-  unsigned short checksum;
-};
-
-typedef struct block_header_s block_header_t;
-struct block_header_s
-{
-  unsigned char type;
-  unsigned int length;
-};
-
-typedef struct data_type1_s data_type1_t;
-struct data_type1_s
-{
-  unsigned char frequency_divisor;
-  unsigned char codec;
-  unsigned char* data;
-};
-
-typedef struct data_type2_s data_type2_t;
-struct data_type2_s
-{
-  unsigned char* data;
-};
-
-typedef struct data_type3_s data_type3_t;
-struct data_type3_s
-{
-  unsigned short length;
-  unsigned char frequency_divisor;
-};
-
-typedef struct data_type4_s data_type4_t;
-struct data_type4_s
-{
-  unsigned short value;
-};
-
-typedef struct data_type5_s data_type5_t;
-struct data_type5_s
-{
-  char* text;
-};
-
-typedef struct data_type6_s data_type6_t;
-struct data_type6_s
-{
-  unsigned short count;
-};
-
-typedef struct data_type8_s data_type8_t;
-struct data_type8_s
-{
-  unsigned short frequency_divisor;
-  unsigned char codec;
-  unsigned char channels_num;
-};
-
-typedef struct data_type9_s data_type9_t;
-struct data_type9_s
-{
-  unsigned int rate;
-  unsigned char bits;
-  unsigned char channels_num;
-  unsigned short codec;
-  unsigned int reserved;
-  unsigned char* data;
-};
-
-typedef union block_data_u block_data_t;
-union block_data_u
-{
-  data_type1_t type1;
-  data_type2_t type2;
-  data_type3_t type3;
-  data_type4_t type4;
-  data_type5_t type5;
-  data_type6_t type6;
-  data_type8_t type8;
-  data_type9_t type9;
-};
-
-typedef struct block_s block_t;
-struct block_s
-{
-  block_header_t header;
-  block_data_t data;
-};
-
-typedef struct voc_s voc_t;
-struct voc_s
-{
-  voc_header_t header;
-  block_t* block;
-};
-
-static long
-safe_ftell(FILE* stream)
-{
-  long result = 0;
-
-  if (!stream)
-  {
-    exit(error_ftell);
-  }
-
-  result = ftell(stream);
-  if (result == -1)
-  {
-    perror("ftell");
-    exit(error_ftell);
-  }
-  else
-  {
-    return result;
-  }
-}
-
-static int
-safe_fseek(FILE* stream, long offset, int whence)
-{
-  int result = 0;
-
-  if (!stream)
-  {
-    exit(error_fseek);
-  }
-
-  result = fseek(stream, offset, whence);
-  if (result == -1)
-  {
-    perror("fseek");
-    exit(error_fseek);
-  }
-  else
-  {
-    return result;
-  }
-}
-
-static void
-safe_fclose(FILE* stream)
-{
-  if (!stream)
-  {
-    exit(error_fclose);
-  }
+#include "errorcodes.h"
+#include "filelist.h"
+#include "memorystream.h"
+#include "outputbuffer.h"
+#include "types.h"
+#include "voc.h"
 
-  if (fclose(stream) == EOF)
-  {
-    perror("fclose");
-    exit(error_fclose);
-  }
-}
-
-static FILE*
-safe_fopen(const char* path, const char* mode)
-{
-  FILE* fp = NULL;
-
-  if (!path || !mode)
-  {
-    exit(error_fopen);
-  }
-
-  fp = fopen(path, mode);
-  if (!fp)
-  {
-    perror("fopen");
-    exit(error_fopen);
-  }
-  return fp;
-}
+#define VOCINFO_VERSION "1.1"
 
 static void
 usage(const char* prgname, const char* prgver)
@@ -210,17 +33,21 @@ usage(const char* prgname, const char* prgver)
   fprintf(stderr, "\n");
   fprintf(stderr, "%s is a tool for displaying informations about Creative Voice Files (.voc).\n", prgname);
   fprintf(stderr, "\n");
-  fprintf(stderr, "Usage: %s [files]\n", prgname);
+  fprintf(stderr, "Usage: %s [options] [files]\n", prgname);
   fprintf(stderr, "\n");
   fprintf(stderr, "Options:\n");
   fprintf(stderr, "  -h, --help             Show this help message and exit\n");
+  fprintf(stderr, "  -l, --list LIST.TXT    Add files as listed in LIST.TXT (- for stdin)\n");
+  fprintf(stderr, "  --format=FORMAT        Print text (default), or jsonl or tsv records per block\n");
   /*
     fprintf(stderr, "  -v, --verbose          Enable verbose output\n");
-    fprintf(stderr, "  -l, --list LIST.TXT    Add files as listed in LIST.TXT\n");
   */
   fprintf(stderr, "\n");
   fprintf(stderr, "Examples:\n");
   fprintf(stderr, "  %s sound1.voc sound2.voc sound3.voc\n", prgname);
+  fprintf(stderr, "  find sounds -name '*.voc' | %s -l -\n", prgname);
+  fprintf(stderr, "  %s - < AMBIENT.VOC\n", prgname);
+  fprintf(stderr, "  %s --format=tsv sounds/*.voc > blocks.tsv\n", prgname);
   exit(EXIT_FAILURE);
 }
 
@@ -276,93 +103,192 @@ codec_name_get(int codec)
   }
 }
 
-static size_t
-blocks_count(FILE* fp)
+/* What a block says about itself, gathered once for every format. Fields
+ * a block type doesn't have are left NULL or 0 and marked in has_*. */
+typedef struct block_info_s block_info_t;
+struct block_info_s
 {
-  size_t count = 0;
-  size_t i = 0;
-  block_header_t bh = {0};
+  long offset; /* of the block data */
+  block_header_t header;
+  const char* name; /* NULL for unknown types */
+  int has_sound; /* sample rate and codec */
+  int has_format; /* bits, channels and reserved */
+  u32 sample_rate;
+  int bits;
+  int channels;
+  const char* codec;
+  u32 reserved;
+  const char* text;
+  int text_len;
+};
 
-  if (!fp)
+/* Called with the stream at the start of the block data. Texts longer
+ * than the stream buffer are cut at its size. */
+static void
+block_info_get(VocStream* vs, i64 data, const block_header_t* bh, block_info_t* info)
+{
+  static const char* const name[] = {"Terminator", "Sound data", "Sound data without type", "Silence", "Marker", "Text", "Repeat start", "Repeat end", "Extra information", "Sound data"};
+
+  memset(info, 0, sizeof(*info));
+  info->offset = (long)data;
+  info->header = *bh;
+  info->name = bh->type < sizeof(name) / sizeof(*name) ? name[bh->type] : NULL;
+
+  switch (bh->type)
   {
-    fprintf(stderr, "blocks_count(): File pointer is NULL!\n");
-    exit(EXIT_FAILURE);
+    case 1:
+      {
+        u8 block[2] = {0};
+
+        voc_peek(vs, block, sizeof(block));
+        info->has_sound = 1;
+        info->sample_rate = (u32)(1000000 / (256 - block[0]));
+        info->codec = codec_name_get(block[1]);
+      }
+      break;
+    case 5:
+      {
+        /* The text is taken straight from the stream buffer, up to its
+         * terminator or the end of the block, whichever comes first. */
+        usize n = vocstream_fill(vs, bh->length < e_vocstream_capacity ? bh->length : e_vocstream_capacity);
+        const u8* text = vs->buffer + vs->head;
+        const u8* end = n ? memchr(text, '\0', n) : NULL;
+
+        if (end)
+        {
+          n = end - text;
+        }
+
+        info->text = (const char*)text;
+        info->text_len = (int)n;
+      }
+      break;
+    case 9:
+      {
+        u8 block[12] = {0};
+
+        voc_peek(vs, block, sizeof(block));
+        info->has_sound = 1;
+        info->has_format = 1;
+        info->sample_rate = u32_le_get(block + 0);
+        info->bits = block[4];
+        info->channels = block[5];
+        info->codec = codec_name_get(u16_le_get(block + 6));
+        info->reserved = u32_le_get(block + 8);
+      }
+      break;
+    default:
+      break;
   }
+}
 
-  while ((i = fread(&bh.type, 1, 1, fp) > 0))
+static void
+block_print(const block_info_t* info, OutputBuffer* out)
+{
+  outputbuffer_printf(out, "0x%lx: block type %d (%d bytes): %s", info->offset, info->header.type, info->header.length, info->name);
+
+  if (info->has_format)
   {
-    if (fread(&bh.length, 1, 3, fp) <= 0)
-    {
-      bh.length = 0;
-    }
+    outputbuffer_printf(out, " (sample rate:%d, bits:%d, channels:%d, codec:%s, reserved:%d)", (int)info->sample_rate, info->bits, info->channels, info->codec, (int)info->reserved);
+  }
+  else if (info->has_sound)
+  {
+    outputbuffer_printf(out, " (sample rate:%d, codec:%s)", (int)info->sample_rate, info->codec);
+  }
+  else if (info->header.type == 5)
+  {
+    outputbuffer_printf(out, ": %.*s", info->text_len, info->text);
+  }
 
-    switch (bh.type)
-    {
-      case 0:
-        fprintf(stdout, "0x%lx: block type 0 (%d bytes): Terminator\n", safe_ftell(fp), bh.length);
-        break;
-      case 1:
-        {
-          block_data_t data = {0};
-          long cursor_backup = safe_ftell(fp);
+  outputbuffer_printf(out, "\n");
+}
 
-          fread(&data, 1, 12, fp);
-          safe_fseek(fp, cursor_backup, SEEK_SET);
+static void
+block_print_jsonl(const block_info_t* info, const char* path, OutputBuffer* out)
+{
+  outputbuffer_printf(out, "{\"path\": ");
+  outputbuffer_json_string(out, path, strlen(path));
+  outputbuffer_printf(out, ", \"offset\": %ld, \"type\": %d, \"length\": %lu, \"name\": \"%s\"", info->offset, info->header.type, (unsigned long)info->header.length, info->name ? info->name : "Unknown");
 
-          fprintf(stdout, "0x%lx: block type 1 (%d bytes): Sound data (sample rate:%d, codec:%s)\n", safe_ftell(fp), bh.length, 1000000 / (256 - data.type1.frequency_divisor), codec_name_get(data.type1.codec));
-        }
-        break;
-      case 2:
-        fprintf(stdout, "0x%lx: block type 2 (%d bytes): Sound data without type\n", safe_ftell(fp), bh.length);
-        break;
-      case 3:
-        fprintf(stdout, "0x%lx: block type 3 (%d bytes): Silence\n", safe_ftell(fp), bh.length);
-        break;
-      case 4:
-        fprintf(stdout, "0x%lx: block type 4 (%d bytes): Marker\n", safe_ftell(fp), bh.length);
-        break;
-      case 5:
-        {
-          char* buf = NULL;
-          long cursor_backup = safe_ftell(fp);
+  if (info->has_sound)
+  {
+    outputbuffer_printf(out, ", \"sample_rate\": %lu, \"codec\": \"%s\"", (unsigned long)info->sample_rate, info->codec);
+  }
+  if (info->has_format)
+  {
+    outputbuffer_printf(out, ", \"bits\": %d, \"channels\": %d, \"reserved\": %lu", info->bits, info->channels, (unsigned long)info->reserved);
+  }
+  if (info->text)
+  {
+    outputbuffer_printf(out, ", \"text\": ");
+    outputbuffer_json_string(out, info->text, (usize)info->text_len);
+  }
 
-          buf = malloc(bh.length + 1);
-          memset(buf, 0, bh.length + 1);
+  outputbuffer_printf(out, "}\n");
+}
 
-          fread(buf, 1, bh.length, fp);
-          safe_fseek(fp, cursor_backup, SEEK_SET);
+static const char block_tsv_header[] = "path\toffset\ttype\tlength\tname\tsample_rate\tbits\tchannels\tcodec\treserved\ttext\n";
 
-          fprintf(stdout, "0x%lx: block type 5 (%d bytes): Text: %s\n", safe_ftell(fp), bh.length, buf);
+static void
+block_print_tsv(const block_info_t* info, const char* path, OutputBuffer* out)
+{
+  outputbuffer_tsv_field(out, path, strlen(path));
+  outputbuffer_printf(out, "\t%ld\t%d\t%lu\t%s\t", info->offset, info->header.type, (unsigned long)info->header.length, info->name ? info->name : "Unknown");
 
-          free(buf);
-        }
-        break;
-      case 6:
-        fprintf(stdout, "0x%lx: block type 6 (%d bytes): Repeat start\n", safe_ftell(fp), bh.length);
-        break;
-      case 7:
-        fprintf(stdout, "0x%lx: block type 7 (%d bytes): Repeat end\n", safe_ftell(fp), bh.length);
-        break;
-      case 8:
-        fprintf(stdout, "0x%lx: block type 8 (%d bytes): Extra information\n", safe_ftell(fp), bh.length);
-        break;
-      case 9:
-        {
-          block_data_t data = {0};
-          long cursor_backup = safe_ftell(fp);
+  if (info->has_sound)
+  {
+    outputbuffer_printf(out, "%lu", (unsigned long)info->sample_rate);
+  }
+  if (info->has_format)
+  {
+    outputbuffer_printf(out, "\t%d\t%d\t%s\t%lu\t", info->bits, info->channels, info->codec, (unsigned long)info->reserved);
+  }
+  else
+  {
+    outputbuffer_printf(out, "\t\t\t%s\t\t", info->has_sound ? info->codec : "");
+  }
+  if (info->text)
+  {
+    outputbuffer_tsv_field(out, info->text, (usize)info->text_len);
+  }
 
-          fread(&data, 1, 12, fp);
-          safe_fseek(fp, cursor_backup, SEEK_SET);
+  outputbuffer_printf(out, "\n");
+}
 
-          fprintf(stdout, "0x%lx: block type 9 (%d bytes): Sound data (sample rate:%d, bits:%d, channels:%d, codec:%s, reserved:%d)\n", safe_ftell(fp), bh.length, data.type9.rate, data.type9.bits, data.type9.channels_num, codec_name_get(data.type9.codec), data.type9.reserved);
-        }
+static size_t
+blocks_count(VocStream* vs, const char* path, int format, OutputBuffer* out)
+{
+  size_t count = 0;
+  block_header_t bh = {0};
+  i64 data = 0;
+
+  while (voc_block_next(vs, &bh, &data))
+  {
+    block_info_t info;
+
+    block_info_get(vs, data, &bh, &info);
+
+    if (!info.name)
+    {
+      fprintf(stderr, "WARN: Unknown block type %d\n", bh.type);
+    }
+
+    switch (format)
+    {
+      case e_format_jsonl:
+        block_print_jsonl(&info, path, out);
+        break;
+      case e_format_tsv:
+        block_print_tsv(&info, path, out);
         break;
       default:
-        fprintf(stderr, "WARN: Unknown block type %d\n", bh.type);
+        if (info.name)
+        {
+          block_print(&info, out);
+        }
         break;
     }
 
-    safe_fseek(fp, bh.length, SEEK_CUR);
     ++count;
   }
 
@@ -370,55 +296,101 @@ blocks_count(FILE* fp)
 }
 
 static void
-voc_info(const char* path)
+voc_info(char* path, int format, OutputBuffer* out)
 {
-  FILE* fp = NULL;
+  VocStream vs;
   voc_t voc = {0};
 
-  fp = safe_fopen(path, "rb");
+  vocstream_open(&vs, path);
 
+  if (!voc_header_parse(&vs, &voc.header))
   {
-    char signature[20] = {0};
-    fread(&signature, 1, sizeof(signature), fp);
-
-    if (strncmp("Creative Voice File\x1a", signature, sizeof(signature)))
-    {
-      fprintf(stderr, "%s isn't a Creative Voice FIle!\n", path);
-      return;
-    }
+    fprintf(stderr, "%s isn't a Creative Voice FIle!\n", path);
+    vocstream_close(&vs);
+    return;
   }
 
+  if (format == e_format_text)
   {
-    fread(&voc.header.size, 1, sizeof(voc.header.size), fp);
-    fread(&voc.header.version, 1, sizeof(voc.header.version), fp);
-    fread(&voc.header.checksum, 1, sizeof(voc.header.checksum), fp);
-
-    fprintf(stdout, "=== %s (header size:%d, version:%s, checksum:0x%x) ===\n", path, voc.header.size, version_name_get(voc.header.version), voc.header.checksum);
+    outputbuffer_printf(out, "=== %s (header size:%d, version:%s, checksum:0x%x) ===\n", path, voc.header.size, version_name_get(voc.header.version), voc.header.checksum);
   }
 
   {
-    size_t count = blocks_count(fp);
-    fprintf(stdout, "%ld blocks found!\n", count);
+    size_t count = blocks_count(&vs, path, format, out);
+
+    if (format == e_format_text)
+    {
+      outputbuffer_printf(out, "%ld blocks found!\n", (long)count);
+    }
   }
 
-  safe_fclose(fp);
+  vocstream_close(&vs);
 }
 
 int
 main(int argc, char* argv[])
 {
+  FileList files = {0};
+  OutputBuffer out = {0};
+  int format = e_format_text;
+  int i;
+
   if (argc < 2)
   {
     usage(argv[0], VOCINFO_VERSION);
   }
-  else
+
+  for (i = 1; i < argc; ++i)
+  {
+    if (!strcmp(argv[i], "-h") || !strcmp(argv[i], "--help"))
+    {
+      usage(argv[0], VOCINFO_VERSION);
+    }
+    else if (!strcmp(argv[i], "-l") || !strcmp(argv[i], "--list"))
+    {
+      if (++i == argc)
+      {
+        usage(argv[0], VOCINFO_VERSION);
+      }
+      filelist_load(&files, argv[i]);
+    }
+    else if (!strncmp(argv[i], "--format=", 9) || !strcmp(argv[i], "--format"))
+    {
+      format = outputbuffer_format_option(argc, argv, &i);
+      if (format < 0)
+      {
+        usage(argv[0], VOCINFO_VERSION);
+      }
+    }
+    else
+    {
+      filelist_add(&files, argv[i]);
+    }
+  }
+
+  if (format == e_format_tsv)
   {
-    int i;
-    for (i = 1; i < argc; ++i)
+    outputbuffer_printf(&out, "%s", block_tsv_header);
+  }
+
+  {
+    usize j = 0;
+    for (; j < files.count; ++j)
     {
-      voc_info(argv[i]);
+      voc_info(files.path[j], format, &out);
+
+      /* Prose is flushed per file to stay next to its warnings. */
+      if (format == e_format_text || outputbuffer_full(&out))
+      {
+        outputbuffer_flush(&out, stdout);
+      }
     }
   }
 
+  outputbuffer_flush(&out, stdout);
+  outputbuffer_free(&out);
+
+  filelist_free(&files);
+
   return EXIT_SUCCESS;
 }
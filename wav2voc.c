@@ -0,0 +1,378 @@
+/* SPDX-License-Identifier: MIT */
+/**
+ * @file   wav2voc.c
+ * @author Marc-Alexandre Espiaut <ma.dev@espiaut.fr>
+ * @date   2026-03-23
+ * @version 1.0
+ * @brief  Converts PCM WAV files to VOC files.
+ *
+ * @copyright Copyright (c) 2026 Marc-Alexandre Espiaut
+ */
+
+#if defined(__linux__)
+#define _XOPEN_SOURCE 700 /* pwrite(), posix_memalign() for fileio.h */
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "errorcodes.h"
+#include "fileio.h"
+#include "filelist.h"
+#include "memorystream.h"
+#include "outputbuffer.h"
+#include "pipeline.h"
+#include "thread.h"
+#include "types.h"
+#include "voc.h"
+
+#define WAV2VOC_VERSION "1.0"
+
+enum
+{
+  e_voc_header_len = 26,
+  e_voc_block_max = 0xFFFFFF, /* the block length is 24 bits */
+  e_voc_type1_len = 2,
+  e_voc_type9_len = 12,
+  e_wav_format_pcm = 0x0001,
+  e_wav_format_extensible = 0xFFFE
+};
+
+typedef struct wav_s wav_t;
+struct wav_s
+{
+  u16 channels;
+  u32 rate;
+  u16 bits;
+  const u8* data;
+  u32 size;
+};
+
+/* Finds the fmt and data chunks. Returns 0, after saying why, for anything
+ * but 8 or 16 bits PCM. */
+static int
+wav_parse(const u8* src, i64 size, wav_t* wav, const char* path)
+{
+  i64 offset = 12;
+  int fmt = 0;
+
+  memset(wav, 0, sizeof(*wav));
+
+  if (size < 12 || memcmp(src, "RIFF", 4) || memcmp(src + 8, "WAVE", 4))
+  {
+    fprintf(stderr, "%s isn't a WAV file!\n", path);
+    return 0;
+  }
+
+  while (offset + 8 <= size)
+  {
+    const u8* chunk = src + offset;
+    u32 length = u32_le_get(chunk + 4);
+    i64 left = size - offset - 8;
+
+    if (!memcmp(chunk, "fmt ", 4) && length >= 16 && left >= 16)
+    {
+      u16 format = u16_le_get(chunk + 8);
+
+      /* The extensible format names the real one in its sub-format GUID,
+       * whose first two bytes are enough here. */
+      if (format == e_wav_format_extensible && length >= 40 && left >= 40)
+      {
+        format = u16_le_get(chunk + 8 + 24);
+      }
+
+      wav->channels = u16_le_get(chunk + 10);
+      wav->rate = u32_le_get(chunk + 12);
+      wav->bits = u16_le_get(chunk + 22);
+      fmt = 1;
+
+      if (format != e_wav_format_pcm || (wav->bits != 8 && wav->bits != 16) ||
+          !wav->channels || wav->channels > 255 || !wav->rate)
+      {
+        fprintf(stderr, "WARN: %s: format 0x%x, %u bits, %u channels isn't supported, skipping.\n",
+                path, format, wav->bits, wav->channels);
+        return 0;
+      }
+    }
+    else if (!memcmp(chunk, "data", 4))
+    {
+      if (!fmt)
+      {
+        fprintf(stderr, "WARN: %s: the data chunk comes before fmt, skipping.\n", path);
+        return 0;
+      }
+
+      if (length > left)
+      {
+        fprintf(stderr, "WARN: %s: the data chunk is truncated.\n", path);
+        length = (u32)left;
+      }
+
+      wav->data = chunk + 8;
+      wav->size = length - length % (wav->channels * (wav->bits / 8));
+      return 1;
+    }
+
+    /* Chunks are padded to an even length. */
+    offset += 8 + (i64)length + (length & 1);
+  }
+
+  fprintf(stderr, "WARN: %s has no sound data, skipping.\n", path);
+  return 0;
+}
+
+/* The divisor of a type 1 block, or -1 if it can't say rate exactly. */
+static int
+voc_divisor_get(u32 rate)
+{
+  u32 d = 0;
+
+  if (rate < 3907 || rate > 1000000 || 1000000 % rate)
+  {
+    return -1;
+  }
+
+  d = 1000000 / rate;
+  return d <= 256 ? (int)(256 - d) : -1;
+}
+
+static void
+voc_block_header_put(OutputBuffer* ob, u8 type, u32 length)
+{
+  u8 dst[4];
+
+  dst[0] = type;
+  dst[1] = (u8)(length & 0xFF);
+  dst[2] = (u8)((length >> 8) & 0xFF);
+  dst[3] = (u8)((length >> 16) & 0xFF);
+  outputbuffer_write(ob, dst, sizeof(dst));
+}
+
+/* 8 bits mono at a rate a divisor gives exactly fits the original type 1
+ * blocks, which every player reads; the rest needs type 9 and VOC 1.20.
+ * Either way the samples are copied as is: WAV and VOC both store 8 bits
+ * samples unsigned and 16 bits ones signed little-endian. */
+static void
+voc_write(const wav_t* wav, OutputBuffer* ob)
+{
+  u8 header[e_voc_header_len];
+  u8 head[e_voc_type9_len];
+  int divisor = wav->bits == 8 && wav->channels == 1 ? voc_divisor_get(wav->rate) : -1;
+  u16 version = divisor >= 0 ? 0x010A : 0x0114;
+  u32 frame = (u32)wav->channels * (wav->bits / 8);
+  usize head_len = 0;
+  const u8* data = wav->data;
+  u32 left = wav->size;
+  u8 type = 0;
+
+  memcpy(header, "Creative Voice File\x1a", 20);
+  u16_le_put(header + 20, e_voc_header_len);
+  u16_le_put(header + 22, version);
+  u16_le_put(header + 24, (u16)(~version + 0x1234));
+  outputbuffer_write(ob, header, sizeof(header));
+
+  if (divisor >= 0)
+  {
+    data_type1_t block = {0};
+
+    block.frequency_divisor = (unsigned char)divisor;
+    block.codec = 0x00;
+    head[0] = block.frequency_divisor;
+    head[1] = block.codec;
+    head_len = e_voc_type1_len;
+    type = 1;
+  }
+  else
+  {
+    data_type9_t block = {0};
+
+    block.rate = wav->rate;
+    block.bits = (unsigned char)wav->bits;
+    block.channels_num = (unsigned char)wav->channels;
+    block.codec = wav->bits == 8 ? 0x00 : 0x04;
+    u32_le_put(head, block.rate);
+    head[4] = block.bits;
+    head[5] = block.channels_num;
+    u16_le_put(head + 6, block.codec);
+    u32_le_put(head + 8, block.reserved);
+    head_len = e_voc_type9_len;
+    type = 9;
+  }
+
+  /* What doesn't fit the first block goes on in type 2 ones, cut between
+   * two frames. */
+  do
+  {
+    u32 room = (u32)(e_voc_block_max - head_len);
+    u32 n = left < room - room % frame ? left : room - room % frame;
+
+    voc_block_header_put(ob, type, (u32)head_len + n);
+    outputbuffer_write(ob, head, head_len);
+    outputbuffer_write(ob, data, n);
+    data += n;
+    left -= n;
+    head_len = 0;
+    type = 2;
+  } while (left);
+
+  /* The terminator has no length bytes. */
+  type = 0;
+  outputbuffer_write(ob, &type, 1);
+}
+
+static void
+wav_convert_job(PipelineJob* job, void* context)
+{
+  wav_t wav;
+
+  (void)context;
+
+  if (!wav_parse(job->input.data, job->input.size, &wav, job->in))
+  {
+    return;
+  }
+
+  outputbuffer_reserve(&job->output, e_voc_header_len + e_voc_type9_len + 4 + wav.size + 1);
+  voc_write(&wav, &job->output);
+  job->ok = 1;
+}
+
+static void
+usage(const char* prgname, const char* prgver)
+{
+  fprintf(stderr, "%s %s : Copyright (c) 2026 Marc-Alexandre Espiaut\n", prgname, prgver);
+  fprintf(stderr, "\n");
+  fprintf(stderr, "%s is a tool for converting WAV files to Creative Voice Files (.voc).\n", prgname);
+  fprintf(stderr, "\n");
+  fprintf(stderr, "Usage: %s [options] [files]\n", prgname);
+  fprintf(stderr, "\n");
+  fprintf(stderr, "Each FILE.WAV, in 8 or 16 bits PCM, is written as FILE.voc.\n");
+  fprintf(stderr, "\n");
+  fprintf(stderr, "Options:\n");
+  fprintf(stderr, "  -h, --help             Show this help message and exit\n");
+  fprintf(stderr, "  -o, --output FILE.VOC  Write the only input to FILE.VOC instead\n");
+  fprintf(stderr, "  -f, --force            Overwrite existing VOC files\n");
+  fprintf(stderr, "  -l, --list LIST.TXT    Add files as listed in LIST.TXT (- for stdin)\n");
+  fprintf(stderr, "  -j, --jobs N           Convert N files in parallel (0: one per CPU)\n");
+  fprintf(stderr, "\n");
+  fprintf(stderr, "Examples:\n");
+  fprintf(stderr, "  %s GOTHOLE.WAV\n", prgname);
+  fprintf(stderr, "  %s -o GOTHOLE.VOC hole.wav\n", prgname);
+  fprintf(stderr, "  find sounds -name '*.wav' | %s -j 0 -l -\n", prgname);
+  exit(EXIT_FAILURE);
+}
+
+int
+main(int argc, char* argv[])
+{
+  FileList files = {0};
+  const char* output = NULL;
+  char** out = NULL;
+  int force = 0;
+  u32 jobs = 1;
+  usize j = 0;
+  int i;
+
+  if (argc < 2)
+  {
+    usage(argv[0], WAV2VOC_VERSION);
+  }
+
+  for (i = 1; i < argc; ++i)
+  {
+    if (!strcmp(argv[i], "-h") || !strcmp(argv[i], "--help"))
+    {
+      usage(argv[0], WAV2VOC_VERSION);
+    }
+    else if (!strcmp(argv[i], "-o") || !strcmp(argv[i], "--output"))
+    {
+      if (++i == argc)
+      {
+        usage(argv[0], WAV2VOC_VERSION);
+      }
+      output = argv[i];
+    }
+    else if (!strcmp(argv[i], "-f") || !strcmp(argv[i], "--force"))
+    {
+      force = 1;
+    }
+    else if (!strcmp(argv[i], "-l") || !strcmp(argv[i], "--list"))
+    {
+      if (++i == argc)
+      {
+        usage(argv[0], WAV2VOC_VERSION);
+      }
+      filelist_load(&files, argv[i]);
+    }
+    else if (!strcmp(argv[i], "-j") || !strcmp(argv[i], "--jobs"))
+    {
+      if (++i == argc)
+      {
+        usage(argv[0], WAV2VOC_VERSION);
+      }
+      jobs = (u32)strtoul(argv[i], NULL, 10);
+      if (!jobs)
+      {
+        jobs = thread_cpu_count();
+      }
+    }
+    else
+    {
+      filelist_add(&files, argv[i]);
+    }
+  }
+
+  if (output && files.count != 1)
+  {
+    fprintf(stderr, "ERROR: --output takes exactly one input file!\n");
+    exit(EXIT_FAILURE);
+  }
+
+  out = calloc(files.count ? files.count : 1, sizeof(*out));
+  if (!out)
+  {
+    perror("calloc");
+    exit(e_error_malloc);
+  }
+
+  for (; j < files.count; ++j)
+  {
+    if (output)
+    {
+      out[j] = malloc(strlen(output) + 1);
+      if (!out[j])
+      {
+        perror("malloc");
+        exit(e_error_malloc);
+      }
+      strcpy(out[j], output);
+    }
+    else
+    {
+      out[j] = path_extension_replace(files.path[j], ".voc");
+    }
+
+    if (!force)
+    {
+      fileio_abort_if_exists(out[j]);
+    }
+  }
+
+  if (jobs > files.count)
+  {
+    jobs = files.count ? (u32)files.count : 1;
+  }
+
+  /* Even with a single transcoder, reading and writing overlap it. */
+  pipeline_run(files.path, out, files.count, jobs, wav_convert_job, NULL);
+
+  for (j = 0; j < files.count; ++j)
+  {
+    free(out[j]);
+  }
+  free(out);
+  filelist_free(&files);
+
+  return EXIT_SUCCESS;
+}